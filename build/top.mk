@@ -197,6 +197,7 @@ AUTH_LIBS = @AUTH_LIBS@
 ARGON2_LIBS = @ARGON2_LIBS@
 SECURITY_LIBS = $(SASL_LIBS) $(TLS_LIBS) $(AUTH_LIBS)
 SYSTEMD_LIBS = @SYSTEMD_LIBS@
+ZLIB_LIBS = @ZLIB_LIBS@
 
 MODULES_CPPFLAGS = @SLAPD_MODULES_CPPFLAGS@
 MODULES_LDFLAGS = @SLAPD_MODULES_LDFLAGS@
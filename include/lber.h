@@ -91,6 +91,7 @@ LDAP_BEGIN_DECL
 
 /* LBER BerElement options */
 #define LBER_USE_DER		0x01
+#define LBER_USE_LONGLEN	0x02	/* with DER, don't shorten large SEQ/SET lengths */
 
 /* get/set options for BerElement */
 #define LBER_OPT_BER_OPTIONS			0x01
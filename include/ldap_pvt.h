@@ -380,6 +380,13 @@ LDAP_F (int) ldap_pvt_sasl_generic_install LDAP_P(( Sockbuf *sb,
 	struct sb_sasl_generic_install *install_arg ));
 LDAP_F (void) ldap_pvt_sasl_generic_remove LDAP_P(( Sockbuf *sb ));
 
+/* compress.c */
+#define LDAP_PVT_COMPRESS_READ	1
+#define LDAP_PVT_COMPRESS_WRITE	2
+LDAP_F (int) ldap_pvt_compress_install LDAP_P(( Sockbuf *sb, int how ));
+LDAP_F (int) ldap_pvt_compress_stats LDAP_P(( Sockbuf *sb,
+	ber_len_t *raw, ber_len_t *wire ));
+
 /* search.c */
 LDAP_F( int ) ldap_pvt_put_filter LDAP_P((
 	BerElement *ber,
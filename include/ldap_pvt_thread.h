@@ -218,6 +218,15 @@ ldap_pvt_thread_pool_submit2 LDAP_P((
 	void *arg,
 	void **cookie ));
 
+LDAP_F( int )
+ldap_pvt_thread_pool_submitq LDAP_P((
+	ldap_pvt_thread_pool_t *pool,
+	int group,
+	int ngroups,
+	ldap_pvt_thread_start_t *start,
+	void *arg,
+	void **cookie ));
+
 LDAP_F( int )
 ldap_pvt_thread_pool_retract LDAP_P((
 	void *cookie ));
@@ -239,6 +248,11 @@ ldap_pvt_thread_pool_queues LDAP_P((
 	ldap_pvt_thread_pool_t *pool,
 	int numqs ));
 
+LDAP_F( int )
+ldap_pvt_thread_pool_steal LDAP_P((
+	ldap_pvt_thread_pool_t *pool,
+	int steal ));
+
 #ifndef LDAP_PVT_THREAD_H_DONE
 typedef enum {
 	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN = -1,
@@ -340,6 +354,9 @@ ldap_pvt_thread_pool_context_reset LDAP_P(( void *key ));
 LDAP_F( ldap_pvt_thread_t )
 ldap_pvt_thread_pool_tid LDAP_P(( void *ctx ));
 
+LDAP_F( int )
+ldap_pvt_thread_pool_queueid LDAP_P(( void *ctx ));
+
 LDAP_END_DECL
 
 #define LDAP_PVT_THREAD_H_DONE
@@ -345,6 +345,9 @@ ber_put_boolean(
 #define SOS_LENLEN (1 + (sizeof(ber_elem_size_t) > MAXINT_BERSIZE_OCTETS ? \
 		(ber_len_t) sizeof(ber_elem_size_t) : MAXINT_BERSIZE_OCTETS))
 
+/* Smallest contents that LBER_USE_LONGLEN leaves with SOS_LENLEN length octets */
+#define SOS_LONGLEN_MIN	4096
+
 /* Header of incomplete sequence or set */
 typedef struct seqorset_header {
 	char xtagbuf[TAGBUF_SIZE + 1];	/* room for tag + len(tag or len) */
@@ -453,9 +456,13 @@ ber_put_seqorset( BerElement *ber )
 	/* Extract sequence/set information from length octets */
 	memcpy( SOS_TAG_END(header), lenptr, SOS_LENLEN );
 
-	/* Store length, and close gap of leftover reserved length octets */
+	/* Store length, and close gap of leftover reserved length octets.
+	 * Closing the gap moves the whole contents, so LBER_USE_LONGLEN
+	 * keeps the reserved octets of large sequences/sets instead.
+	 */
 	len = xlen - SOS_LENLEN;
-	if ( !(ber->ber_options & LBER_USE_DER) ) {
+	if ( !(ber->ber_options & LBER_USE_DER) ||
+		( (ber->ber_options & LBER_USE_LONGLEN) && len >= SOS_LONGLEN_MIN ) ) {
 		int i;
 		lenptr[0] = SOS_LENLEN - 1 + 0x80; /* length(length)-1 */
 		for( i = SOS_LENLEN; --i > 0; len >>= 8 ) {
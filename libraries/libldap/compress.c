@@ -0,0 +1,432 @@
+/* compress.c - zlib compression of an LDAP stream */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 2022 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/*
+ * A Sockbuf layer that compresses one direction of a connection.
+ *
+ * The sender deflates everything it writes after the layer is
+ * installed, flushing at the end of each write so that every PDU can
+ * be decoded as soon as it arrives. The stream is a single zlib stream
+ * for the life of the connection, primed with a fixed dictionary of
+ * common attribute and object class names.
+ *
+ * The receiver installs its layer before it sends the request that
+ * asks for compression, and looks at the first octet that comes back:
+ * an LDAPMessage always starts with a SEQUENCE tag, which a zlib
+ * header never does. If the peer did not agree to compress, the layer
+ * stays out of the way for the rest of the connection.
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+
+#include <ac/errno.h>
+#include <ac/string.h>
+
+#include "ldap-int.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+
+/*
+ * The preset dictionary. Both sides must use exactly the same one,
+ * so it may not be changed; a new one needs a new control value.
+ * zlib favours matches near the end of the dictionary, so the most
+ * frequent strings come last.
+ */
+static const char zlib_dict[] =
+	"olcSyncrepl" "olcDatabase" "olcAccess" "olcOverlay"
+	"telexNumber" "facsimileTelephoneNumber" "registeredAddress"
+	"destinationIndicator" "preferredDeliveryMethod" "x121Address"
+	"internationaliSDNNumber" "teletexTerminalIdentifier"
+	"physicalDeliveryOfficeName" "postOfficeBox" "postalAddress"
+	"postalCode" "street" "st" "l" "c" "seeAlso" "businessCategory"
+	"carLicense" "departmentNumber" "employeeNumber" "employeeType"
+	"homePhone" "homePostalAddress" "initials" "jpegPhoto"
+	"labeledURI" "manager" "mobile" "pager" "photo" "roomNumber"
+	"secretary" "userCertificate" "userPKCS12" "userSMIMECertificate"
+	"x500UniqueIdentifier" "preferredLanguage" "audio"
+	"loginShell" "homeDirectory" "gecos" "gidNumber" "uidNumber"
+	"memberUid" "shadowLastChange" "shadowMax" "shadowWarning"
+	"posixAccount" "posixGroup" "shadowAccount"
+	"organizationalRole" "organization" "dcObject" "domain"
+	"referral" "ref" "alias" "aliasedObjectName" "extensibleObject"
+	"groupOfUniqueNames" "uniqueMember" "groupOfNames" "owner"
+	"organizationalUnit" "ou" "o" "dc" "title" "description"
+	"telephoneNumber" "userPassword" "displayName" "givenName"
+	"mail" "memberOf" "member" "uid" "sn" "cn"
+	"person" "organizationalPerson" "inetOrgPerson" "top"
+	"contextCSN" "hasSubordinates" "entryDN" "subschemaSubentry"
+	"structuralObjectClass" "creatorsName" "createTimestamp"
+	"modifiersName" "modifyTimestamp"
+	"1.3.6.1.4.1.4203.1.9.1.1" "1.3.6.1.4.1.4203.1.9.1.3"
+	"1.3.6.1.4.1.4203.1.9.1.4" "1.3.6.1.4.1.4203.1.9.1.2"
+	"entryUUID" "#000000#000#000000Z" "entryCSN" "objectClass";
+
+#define ZLIB_DEFLATE	0x01	/* compress what is written */
+#define ZLIB_INFLATE	0x02	/* decompress what is read */
+#define ZLIB_STARTED	0x04	/* the peer is compressing */
+#define ZLIB_PLAIN		0x08	/* the peer is not compressing */
+#define ZLIB_MORE		0x10	/* inflate may have output pending */
+#define ZLIB_PARTIAL	0x20	/* output of the last write is pending */
+
+#define ZLIB_BUFSIZE	16384
+#define ZLIB_MAX_WRITE	65536	/* input deflated per write */
+
+struct sb_zlib_data {
+	z_stream		zd_strm;
+	int				zd_flags;
+	uLong			zd_dictid;
+	ber_len_t		zd_last;	/* input consumed by a partial write */
+	Sockbuf_Buf		zd_buf;		/* compressed data */
+	ber_len_t		zd_raw;		/* bytes before compression */
+	ber_len_t		zd_wire;	/* bytes on the wire */
+};
+
+static int
+sb_zlib_setup( Sockbuf_IO_Desc *sbiod, void *arg )
+{
+	struct sb_zlib_data	*p;
+	int rc;
+
+	assert( sbiod != NULL );
+
+	p = LBER_CALLOC( 1, sizeof( *p ) );
+	if ( p == NULL )
+		return -1;
+	p->zd_flags = (int)(long)arg;
+	ber_pvt_sb_buf_init( &p->zd_buf );
+	if ( ber_pvt_sb_grow_buffer( &p->zd_buf, ZLIB_BUFSIZE ) < 0 ) {
+		LBER_FREE( p );
+		sock_errset(ENOMEM);
+		return -1;
+	}
+
+	if ( p->zd_flags & ZLIB_DEFLATE ) {
+		rc = deflateInit( &p->zd_strm, Z_DEFAULT_COMPRESSION );
+		if ( rc == Z_OK ) {
+			rc = deflateSetDictionary( &p->zd_strm,
+				(const Bytef *)zlib_dict, sizeof( zlib_dict ) - 1 );
+			if ( rc != Z_OK )
+				deflateEnd( &p->zd_strm );
+		}
+	} else {
+		p->zd_dictid = adler32( adler32( 0L, Z_NULL, 0 ),
+			(const Bytef *)zlib_dict, sizeof( zlib_dict ) - 1 );
+		rc = inflateInit( &p->zd_strm );
+	}
+	if ( rc != Z_OK ) {
+		ber_pvt_sb_buf_destroy( &p->zd_buf );
+		LBER_FREE( p );
+		sock_errset(ENOMEM);
+		return -1;
+	}
+
+	sbiod->sbiod_pvt = p;
+	return 0;
+}
+
+static int
+sb_zlib_remove( Sockbuf_IO_Desc *sbiod )
+{
+	struct sb_zlib_data	*p;
+
+	assert( sbiod != NULL );
+
+	p = (struct sb_zlib_data *)sbiod->sbiod_pvt;
+	if ( p->zd_flags & ZLIB_DEFLATE )
+		deflateEnd( &p->zd_strm );
+	else
+		inflateEnd( &p->zd_strm );
+	ber_pvt_sb_buf_destroy( &p->zd_buf );
+	LBER_FREE( p );
+	sbiod->sbiod_pvt = NULL;
+	return 0;
+}
+
+static ber_slen_t
+sb_zlib_read( Sockbuf_IO_Desc *sbiod, void *buf, ber_len_t len )
+{
+	struct sb_zlib_data	*p;
+	Sockbuf_Buf *in;
+	ber_slen_t ret;
+	int rc, more;
+
+	assert( sbiod != NULL );
+	assert( SOCKBUF_VALID( sbiod->sbiod_sb ) );
+
+	p = (struct sb_zlib_data *)sbiod->sbiod_pvt;
+	in = &p->zd_buf;
+
+	if ( !( p->zd_flags & ZLIB_INFLATE ) || len == 0 )
+		return LBER_SBIOD_READ_NEXT( sbiod, buf, len );
+
+	more = p->zd_flags & ZLIB_MORE;
+
+	for (;;) {
+		if ( p->zd_flags & ZLIB_PLAIN ) {
+			/* Hand over what was read ahead, then get out of the way */
+			ret = ber_pvt_sb_copy_out( in, buf, len );
+			if ( ret )
+				return ret;
+			return LBER_SBIOD_READ_NEXT( sbiod, buf, len );
+		}
+
+		if ( !( p->zd_flags & ZLIB_STARTED ) && in->buf_ptr < in->buf_end ) {
+			if ( (unsigned char)in->buf_base[in->buf_ptr] == LBER_SEQUENCE ) {
+				p->zd_flags |= ZLIB_PLAIN;
+			} else {
+				p->zd_flags |= ZLIB_STARTED;
+			}
+			continue;
+		}
+
+		if ( p->zd_flags & ZLIB_STARTED ) {
+			p->zd_strm.next_in = (Bytef *)in->buf_base + in->buf_ptr;
+			p->zd_strm.avail_in = in->buf_end - in->buf_ptr;
+			p->zd_strm.next_out = buf;
+			p->zd_strm.avail_out = len;
+			rc = inflate( &p->zd_strm, Z_SYNC_FLUSH );
+			if ( rc == Z_NEED_DICT ) {
+				if ( p->zd_strm.adler == p->zd_dictid )
+					rc = inflateSetDictionary( &p->zd_strm,
+						(const Bytef *)zlib_dict, sizeof( zlib_dict ) - 1 );
+				if ( rc == Z_OK )
+					rc = inflate( &p->zd_strm, Z_SYNC_FLUSH );
+			}
+			in->buf_ptr = in->buf_end - p->zd_strm.avail_in;
+			if ( in->buf_ptr == in->buf_end )
+				in->buf_ptr = in->buf_end = 0;
+			if ( rc != Z_OK && rc != Z_BUF_ERROR ) {
+				ber_log_printf( LDAP_DEBUG_ANY, sbiod->sbiod_sb->sb_debug,
+					"sb_zlib_read: inflate failed (%d)\n", rc );
+				sock_errset(EIO);
+				return -1;
+			}
+			if ( p->zd_strm.avail_out == 0 )
+				p->zd_flags |= ZLIB_MORE;
+			else
+				p->zd_flags &= ~ZLIB_MORE;
+			ret = len - p->zd_strm.avail_out;
+			if ( ret ) {
+				p->zd_raw += ret;
+				return ret;
+			}
+			if ( in->buf_ptr < in->buf_end )
+				continue;
+		}
+
+		/* We said data was ready because inflate might have had
+		 * more output. It had none, so don't block on the socket.
+		 */
+		if ( more ) {
+			sock_errset(EWOULDBLOCK);
+			return -1;
+		}
+
+		/* Need more input */
+		if ( in->buf_ptr && in->buf_ptr == in->buf_end )
+			in->buf_ptr = in->buf_end = 0;
+		ret = LBER_SBIOD_READ_NEXT( sbiod, in->buf_base + in->buf_end,
+			in->buf_size - in->buf_end );
+#ifdef EINTR
+		if ( ( ret < 0 ) && ( errno == EINTR ) )
+			continue;
+#endif
+		if ( ret <= 0 )
+			return ret;
+		in->buf_end += ret;
+		p->zd_wire += ret;
+	}
+}
+
+static ber_slen_t
+sb_zlib_write( Sockbuf_IO_Desc *sbiod, void *buf, ber_len_t len )
+{
+	struct sb_zlib_data	*p;
+	Sockbuf_Buf *out;
+	ber_slen_t ret;
+	ber_len_t len2;
+	int rc;
+
+	assert( sbiod != NULL );
+	assert( SOCKBUF_VALID( sbiod->sbiod_sb ) );
+
+	p = (struct sb_zlib_data *)sbiod->sbiod_pvt;
+	out = &p->zd_buf;
+
+	if ( !( p->zd_flags & ZLIB_DEFLATE ))
+		return LBER_SBIOD_WRITE_NEXT( sbiod, buf, len );
+
+	/* Is there anything left in the buffer? */
+	if ( out->buf_ptr != out->buf_end ) {
+		ret = ber_pvt_sb_do_write( sbiod, out );
+		if ( ret < 0 ) return ret;
+
+		/* Still have something left?? */
+		if ( out->buf_ptr != out->buf_end ) {
+			sock_errset(EAGAIN);
+			return -1;
+		}
+	}
+
+	/* If we're just retrying a partial write, tell the
+	 * caller it's done. Let them call again if there's
+	 * still more left to write.
+	 */
+	if ( p->zd_flags & ZLIB_PARTIAL ) {
+		p->zd_flags ^= ZLIB_PARTIAL;
+		return p->zd_last;
+	}
+
+	len2 = len > ZLIB_MAX_WRITE ? ZLIB_MAX_WRITE : len;
+
+	out->buf_ptr = out->buf_end = 0;
+	p->zd_strm.next_in = buf;
+	p->zd_strm.avail_in = len2;
+	do {
+		if ( out->buf_size - out->buf_end < 64 &&
+			ber_pvt_sb_grow_buffer( out, out->buf_size * 2 ) < 0 )
+		{
+			sock_errset(ENOMEM);
+			return -1;
+		}
+		p->zd_strm.next_out = (Bytef *)out->buf_base + out->buf_end;
+		p->zd_strm.avail_out = out->buf_size - out->buf_end;
+		rc = deflate( &p->zd_strm, Z_SYNC_FLUSH );
+		if ( rc != Z_OK && rc != Z_BUF_ERROR ) {
+			ber_log_printf( LDAP_DEBUG_ANY, sbiod->sbiod_sb->sb_debug,
+				"sb_zlib_write: deflate failed (%d)\n", rc );
+			sock_errset(EIO);
+			return -1;
+		}
+		out->buf_end = out->buf_size - p->zd_strm.avail_out;
+	} while ( p->zd_strm.avail_out == 0 );
+
+	p->zd_raw += len2;
+	p->zd_wire += out->buf_end;
+
+	ret = ber_pvt_sb_do_write( sbiod, out );
+
+	if ( ret < 0 ) {
+		/* error? */
+		int err = sock_errno();
+		/* caller can retry this */
+		if ( err == EAGAIN || err == EWOULDBLOCK || err == EINTR ) {
+			p->zd_flags |= ZLIB_PARTIAL;
+			p->zd_last = len2;
+		}
+		return ret;
+	} else if ( out->buf_ptr != out->buf_end ) {
+		/* partial write? pretend nothing got written */
+		p->zd_flags |= ZLIB_PARTIAL;
+		p->zd_last = len2;
+		sock_errset(EAGAIN);
+		return -1;
+	}
+
+	/* return number of bytes compressed, not written, to ensure
+	 * no byte is compressed twice (even if only sent once).
+	 */
+	return len2;
+}
+
+static int
+sb_zlib_ctrl( Sockbuf_IO_Desc *sbiod, int opt, void *arg )
+{
+	struct sb_zlib_data	*p;
+
+	p = (struct sb_zlib_data *)sbiod->sbiod_pvt;
+
+	if ( opt == LBER_SB_OPT_DATA_READY && ( p->zd_flags & ZLIB_INFLATE )) {
+		if ( p->zd_buf.buf_ptr != p->zd_buf.buf_end ) return 1;
+		if ( p->zd_flags & ZLIB_MORE ) return 1;
+	}
+
+	return LBER_SBIOD_CTRL_NEXT( sbiod, opt, arg );
+}
+
+static Sockbuf_IO ldap_pvt_sockbuf_io_zlib = {
+	sb_zlib_setup,		/* sbi_setup */
+	sb_zlib_remove,		/* sbi_remove */
+	sb_zlib_ctrl,		/* sbi_ctrl */
+	sb_zlib_read,		/* sbi_read */
+	sb_zlib_write,		/* sbi_write */
+	NULL				/* sbi_close */
+};
+
+#endif /* HAVE_ZLIB */
+
+/*
+ * Compress what is written to sb (LDAP_PVT_COMPRESS_WRITE), or
+ * decompress what is read from it if the peer turns out to be
+ * compressing (LDAP_PVT_COMPRESS_READ). The other direction is left
+ * alone. Returns LDAP_ALREADY_EXISTS if sb already has a layer.
+ */
+int
+ldap_pvt_compress_install( Sockbuf *sb, int how )
+{
+#ifdef HAVE_ZLIB
+	long flags;
+
+	Debug1( LDAP_DEBUG_TRACE, "ldap_pvt_compress_install: %s\n",
+		how == LDAP_PVT_COMPRESS_WRITE ? "write" : "read" );
+
+	if ( ber_sockbuf_ctrl( sb, LBER_SB_OPT_HAS_IO,
+			&ldap_pvt_sockbuf_io_zlib ) )
+		return LDAP_ALREADY_EXISTS;
+
+	flags = how == LDAP_PVT_COMPRESS_WRITE ? ZLIB_DEFLATE : ZLIB_INFLATE;
+	if ( ber_sockbuf_add_io( sb, &ldap_pvt_sockbuf_io_zlib,
+			LBER_SBIOD_LEVEL_APPLICATION, (void *)flags ))
+		return LDAP_NO_MEMORY;
+
+	return LDAP_SUCCESS;
+#else
+	return LDAP_NOT_SUPPORTED;
+#endif
+}
+
+/*
+ * Get the bytes that went through the compressor and the bytes that
+ * went over the wire. Returns -1 if nothing on sb is being compressed.
+ */
+int
+ldap_pvt_compress_stats( Sockbuf *sb, ber_len_t *raw, ber_len_t *wire )
+{
+#ifdef HAVE_ZLIB
+	Sockbuf_IO_Desc *sbiod;
+	struct sb_zlib_data	*p;
+
+	for ( sbiod = sb->sb_iod; sbiod; sbiod = sbiod->sbiod_next ) {
+		if ( sbiod->sbiod_io == &ldap_pvt_sockbuf_io_zlib )
+			break;
+	}
+	if ( !sbiod )
+		return -1;
+
+	p = (struct sb_zlib_data *)sbiod->sbiod_pvt;
+	if ( !( p->zd_flags & ( ZLIB_DEFLATE|ZLIB_STARTED )))
+		return -1;
+
+	*raw = p->zd_raw;
+	*wire = p->zd_wire;
+	return 0;
+#else
+	return -1;
+#endif
+}
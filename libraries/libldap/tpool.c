@@ -176,6 +176,9 @@ struct ldap_int_thread_pool_s {
 
 	/* Max pending + paused + idle tasks, negated when ltp_finishing */
 	int ltp_max_pending;
+
+	/* Idle threads take pending tasks from the other queues */
+	int ltp_steal;
 };
 
 static ldap_int_tpool_plist_t empty_pending_list =
@@ -189,6 +192,9 @@ static LDAP_STAILQ_HEAD(tpq, ldap_int_thread_pool_s)
 static ldap_pvt_thread_mutex_t ldap_pvt_thread_pool_mutex;
 
 static void *ldap_int_thread_pool_wrapper( void *pool );
+static void ldap_int_thread_pool_nudge(
+	struct ldap_int_thread_pool_s *pool,
+	struct ldap_int_thread_poolq_s *self );
 
 static ldap_pvt_thread_key_t	ldap_tpool_key;
 
@@ -356,14 +362,29 @@ ldap_pvt_thread_pool_submit2 (
 	ldap_pvt_thread_pool_t *tpool,
 	ldap_pvt_thread_start_t *start_routine, void *arg,
 	void **cookie )
+{
+	return ldap_pvt_thread_pool_submitq( tpool, 0, 1,
+		start_routine, arg, cookie );
+}
+
+/* Submit a task to be performed by the thread pool, preferring
+ * the queues whose index is group modulo ngroups.  Other queues
+ * are used when there are none such or they are all full.
+ */
+int
+ldap_pvt_thread_pool_submitq (
+	ldap_pvt_thread_pool_t *tpool,
+	int group, int ngroups,
+	ldap_pvt_thread_start_t *start_routine, void *arg,
+	void **cookie )
 {
 	struct ldap_int_thread_pool_s *pool;
 	struct ldap_int_thread_poolq_s *pq;
 	ldap_int_thread_task_t *task;
 	ldap_pvt_thread_t thr;
-	int i, j;
+	int i, j, nudge = 0;
 
-	if (tpool == NULL)
+	if (tpool == NULL || ngroups < 1)
 		return(-1);
 
 	pool = *tpool;
@@ -371,10 +392,16 @@ ldap_pvt_thread_pool_submit2 (
 	if (pool == NULL)
 		return(-1);
 
+	group %= ngroups;
+	if ( group < 0 || group >= pool->ltp_numqs ) {
+		group = 0;
+		ngroups = 1;
+	}
+
 	if ( pool->ltp_numqs > 1 ) {
 		int min = pool->ltp_wqs[0]->ltp_max_pending + pool->ltp_wqs[0]->ltp_max_count;
-		int min_x = 0, cnt;
-		for ( i = 0; i < pool->ltp_numqs; i++ ) {
+		int min_x = group, cnt;
+		for ( i = group; i < pool->ltp_numqs; i += ngroups ) {
 			/* take first queue that has nothing active */
 			if ( !pool->ltp_wqs[i]->ltp_active_count ) {
 				min_x = i;
@@ -390,7 +417,8 @@ ldap_pvt_thread_pool_submit2 (
 	} else
 		i = 0;
 
-	j = i;
+	/* Try each queue once. A queue that was just removed looks full. */
+	j = 0;
 	while(1) {
 		ldap_pvt_thread_mutex_lock(&pool->ltp_wqs[i]->ltp_mutex);
 		if (pool->ltp_wqs[i]->ltp_pending_count < pool->ltp_wqs[i]->ltp_max_pending) {
@@ -399,7 +427,7 @@ ldap_pvt_thread_pool_submit2 (
 		ldap_pvt_thread_mutex_unlock(&pool->ltp_wqs[i]->ltp_mutex);
 		i++;
 		i %= pool->ltp_numqs;
-		if ( i == j )
+		if ( ++j >= pool->ltp_numqs )
 			return -1;
 	}
 
@@ -471,8 +499,17 @@ ldap_pvt_thread_pool_submit2 (
 	}
 	ldap_pvt_thread_cond_signal(&pq->ltp_cond);
 
+	/* more queued here than threads waiting for it, let an
+	 * idle thread on another queue come and take it
+	 */
+	if (pool->ltp_steal && pq->ltp_pending_count >
+		pq->ltp_open_count - pq->ltp_starting - pq->ltp_active_count)
+		nudge = 1;
+
  done:
 	ldap_pvt_thread_mutex_unlock(&pq->ltp_mutex);
+	if (nudge)
+		ldap_int_thread_pool_nudge(pool, pq);
 	return(0);
 
  failed:
@@ -579,8 +616,29 @@ ldap_pvt_thread_pool_queues(
 		return(-1);
 
 	if (numqs < pool->ltp_numqs) {
-		for (i=numqs; i<pool->ltp_numqs; i++)
-			pool->ltp_wqs[i]->ltp_max_count = 0;
+		for (i=numqs; i<pool->ltp_numqs; i++) {
+			ldap_int_thread_task_t *task;
+			struct ldap_int_thread_poolq_s *dst = pool->ltp_wqs[i % numqs];
+
+			/* Let the threads go, refuse new tasks (a submitter may
+			 * still have read the old ltp_numqs), and hand the pending
+			 * tasks to a remaining queue so they still get run.
+			 */
+			pq = pool->ltp_wqs[i];
+			ldap_pvt_thread_mutex_lock(&pq->ltp_mutex);
+			pq->ltp_max_count = 0;
+			pq->ltp_max_pending = 0;
+			ldap_pvt_thread_mutex_lock(&dst->ltp_mutex);
+			while ((task = LDAP_STAILQ_FIRST(&pq->ltp_pending_list)) != NULL) {
+				LDAP_STAILQ_REMOVE_HEAD(&pq->ltp_pending_list, ltt_next.q);
+				pq->ltp_pending_count--;
+				task->ltt_queue = dst;
+				LDAP_STAILQ_INSERT_TAIL(&dst->ltp_pending_list, task, ltt_next.q);
+				dst->ltp_pending_count++;
+			}
+			ldap_pvt_thread_mutex_unlock(&dst->ltp_mutex);
+			ldap_pvt_thread_mutex_unlock(&pq->ltp_mutex);
+		}
 	} else if (numqs > pool->ltp_numqs) {
 		struct ldap_int_thread_poolq_s **wqs;
 		wqs = LDAP_REALLOC(pool->ltp_wqs, numqs * sizeof(struct ldap_int_thread_poolq_s *));
@@ -628,6 +686,28 @@ ldap_pvt_thread_pool_queues(
 	return 0;
 }
 
+/* Let idle threads take pending tasks from the other work queues
+ * instead of waiting for work on their own queue only.
+ */
+int
+ldap_pvt_thread_pool_steal(
+	ldap_pvt_thread_pool_t *tpool,
+	int steal )
+{
+	struct ldap_int_thread_pool_s *pool;
+
+	if (tpool == NULL)
+		return(-1);
+
+	pool = *tpool;
+
+	if (pool == NULL)
+		return(-1);
+
+	pool->ltp_steal = steal;
+	return(0);
+}
+
 /* Set max #threads.  value <= 0 means max supported #threads (LDAP_MAXTHR) */
 int
 ldap_pvt_thread_pool_maxthreads(
@@ -940,12 +1020,85 @@ ldap_pvt_thread_pool_free ( ldap_pvt_thread_pool_t *tpool )
 	return(0);
 }
 
+/* Take the first pending task from another queue than self, and
+ * return the queue it was taken from in *owner.  Called with no queue
+ * locked, by a thread still counted active in self so that a pause
+ * waits for it as for any running task.  Paused queues have an empty
+ * work list, so nothing is taken from them.
+ */
+static ldap_int_thread_task_t *
+ldap_int_thread_pool_steal(
+	struct ldap_int_thread_pool_s *pool,
+	struct ldap_int_thread_poolq_s *self,
+	struct ldap_int_thread_poolq_s **owner )
+{
+	struct ldap_int_thread_poolq_s *pq;
+	ldap_int_thread_task_t *task;
+	int i, j, numqs = pool->ltp_numqs;
+
+	for (i=0; i<numqs; i++)
+		if (pool->ltp_wqs[i] == self) break;
+
+	for (j=1; j<numqs; j++) {
+		pq = pool->ltp_wqs[(i+j) % numqs];
+		if (pq == self)
+			continue;
+		/* unlocked peek, checked again below */
+		if (LDAP_STAILQ_EMPTY(pq->ltp_work_list))
+			continue;
+		ldap_pvt_thread_mutex_lock(&pq->ltp_mutex);
+		task = LDAP_STAILQ_FIRST(pq->ltp_work_list);
+		if (task) {
+			LDAP_STAILQ_REMOVE_HEAD(pq->ltp_work_list, ltt_next.q);
+			pq->ltp_pending_count--;
+		}
+		ldap_pvt_thread_mutex_unlock(&pq->ltp_mutex);
+		if (task) {
+			*owner = pq;
+			return task;
+		}
+	}
+	return NULL;
+}
+
+/* Wake a thread waiting on another queue than self, which has
+ * more queued tasks than waiting threads.
+ */
+static void
+ldap_int_thread_pool_nudge(
+	struct ldap_int_thread_pool_s *pool,
+	struct ldap_int_thread_poolq_s *self )
+{
+	struct ldap_int_thread_poolq_s *pq;
+	int i;
+
+	for (i=0; i<pool->ltp_numqs; i++) {
+		/* the queues may be resized while paused */
+		if (pool->ltp_pause)
+			break;
+		pq = pool->ltp_wqs[i];
+		if (pq == self)
+			continue;
+		/* unlocked peek, checked again below */
+		if (pq->ltp_open_count - pq->ltp_starting - pq->ltp_active_count <=
+			pq->ltp_pending_count)
+			continue;
+		ldap_pvt_thread_mutex_lock(&pq->ltp_mutex);
+		if (pq->ltp_open_count - pq->ltp_starting - pq->ltp_active_count >
+			pq->ltp_pending_count) {
+			ldap_pvt_thread_cond_signal(&pq->ltp_cond);
+			i = pool->ltp_numqs;
+		}
+		ldap_pvt_thread_mutex_unlock(&pq->ltp_mutex);
+	}
+}
+
 /* Thread loop.  Accept and handle submitted tasks. */
 static void *
 ldap_int_thread_pool_wrapper ( 
 	void *xpool )
 {
-	struct ldap_int_thread_poolq_s *pq = xpool;
+	struct ldap_int_thread_poolq_s *pq = xpool, *owner;
 	struct ldap_int_thread_pool_s *pool = pq->ltp_pool;
 	ldap_int_thread_task_t *task;
 	ldap_int_tpool_plist_t *work_list;
@@ -989,8 +1142,23 @@ ldap_int_thread_pool_wrapper (
 	pq->ltp_active_count++;
 
 	for (;;) {
+		owner = pq;
 		work_list = pq->ltp_work_list; /* help the compiler a bit */
 		task = LDAP_STAILQ_FIRST(work_list);
+		if (task == NULL && pool->ltp_steal && !pool->ltp_pause &&
+			!pool->ltp_finishing && pq->ltp_open_count <= pq->ltp_max_count)
+		{
+			/* Nothing here, look for work on the other queues
+			 * before going idle.
+			 */
+			ldap_pvt_thread_mutex_unlock(&pq->ltp_mutex);
+			task = ldap_int_thread_pool_steal(pool, pq, &owner);
+			if (task != NULL)
+				goto run;
+			ldap_pvt_thread_mutex_lock(&pq->ltp_mutex);
+			work_list = pq->ltp_work_list;
+			task = LDAP_STAILQ_FIRST(work_list);
+		}
 		if (task == NULL) {	/* paused or no pending tasks */
 			if (--(pq->ltp_active_count) < 1) {
 				if (pool->ltp_pause) {
@@ -1036,7 +1204,13 @@ ldap_int_thread_pool_wrapper (
 
 				work_list = pq->ltp_work_list;
 				task = LDAP_STAILQ_FIRST(work_list);
-			} while (task == NULL);
+				/* When stealing, a wakeup may be for work on
+				 * another queue; go look for it.  Not while
+				 * paused: this queue may already be counted out
+				 * of ltp_active_queues.
+				 */
+			} while (task == NULL &&
+				(pool_lock || pool->ltp_pause || !pool->ltp_steal));
 
 			if (pool_lock) {
 				ldap_pvt_thread_mutex_unlock(&pool->ltp_mutex);
@@ -1044,16 +1218,39 @@ ldap_int_thread_pool_wrapper (
 				pool_lock = 0;
 			}
 			pq->ltp_active_count++;
+			if (task == NULL)
+				continue;
 		}
 
 		LDAP_STAILQ_REMOVE_HEAD(work_list, ltt_next.q);
 		pq->ltp_pending_count--;
 		ldap_pvt_thread_mutex_unlock(&pq->ltp_mutex);
 
+	run:
 		task->ltt_start_routine(&ctx, task->ltt_arg);
 
-		ldap_pvt_thread_mutex_lock(&pq->ltp_mutex);
-		LDAP_SLIST_INSERT_HEAD(&pq->ltp_free_list, task, ltt_next.l);
+		if (owner != pq) {
+			/* Give a stolen task back to the queue it was submitted
+			 * to, so that task structures don't pile up on the free
+			 * lists of the queues that steal.  The task may have
+			 * changed the number of queues, so only if owner is
+			 * still in use; we are counted active, so that can't
+			 * change again while we look.
+			 */
+			for (i=0; i<pool->ltp_numqs; i++)
+				if (pool->ltp_wqs[i] == owner) break;
+			if (i == pool->ltp_numqs)
+				owner = pq;
+		}
+		if (owner != pq) {
+			ldap_pvt_thread_mutex_lock(&owner->ltp_mutex);
+			LDAP_SLIST_INSERT_HEAD(&owner->ltp_free_list, task, ltt_next.l);
+			ldap_pvt_thread_mutex_unlock(&owner->ltp_mutex);
+			ldap_pvt_thread_mutex_lock(&pq->ltp_mutex);
+		} else {
+			ldap_pvt_thread_mutex_lock(&pq->ltp_mutex);
+			LDAP_SLIST_INSERT_HEAD(&pq->ltp_free_list, task, ltt_next.l);
+		}
 	}
  done:
 
@@ -1083,8 +1280,8 @@ ldap_int_thread_pool_wrapper (
 	if (freeme) {
 		ldap_pvt_thread_cond_destroy(&pq->ltp_cond);
 		ldap_pvt_thread_mutex_destroy(&pq->ltp_mutex);
+		/* pq is inside the block, don't touch it after this */
 		LDAP_FREE(pq->ltp_free);
-		pq->ltp_free = NULL;
 	}
 	ldap_pvt_thread_exit(NULL);
 	return(NULL);
@@ -1484,6 +1681,23 @@ ldap_pvt_thread_t ldap_pvt_thread_pool_tid( void *vctx )
 
 	return ctx->ltu_id;
 }
+
+/* Index of the work queue the context's thread serves, -1 if none */
+int ldap_pvt_thread_pool_queueid( void *vctx )
+{
+	ldap_int_thread_userctx_t *ctx = vctx;
+	struct ldap_int_thread_pool_s *pool;
+	int i;
+
+	if ( !ctx || !ctx->ltu_pq )
+		return -1;
+
+	pool = ctx->ltu_pq->ltp_pool;
+	for ( i=0; i<pool->ltp_numqs; i++ )
+		if ( pool->ltp_wqs[i] == ctx->ltu_pq )
+			return i;
+	return -1;
+}
 #endif /* LDAP_THREAD_HAVE_TPOOL */
 
 #endif /* LDAP_R_COMPILE */
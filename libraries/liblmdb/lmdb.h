@@ -1411,6 +1411,27 @@ void mdb_cursor_close(MDB_cursor *cursor);
 	 */
 int  mdb_cursor_renew(MDB_txn *txn, MDB_cursor *cursor);
 
+	/** @brief Set read-ahead for a sequential scan with a cursor.
+	 *
+	 * Each time the cursor moves onto a new leaf page, the library
+	 * asks the OS to read in the overflow pages of that leaf's remaining
+	 * records and the next \b pages leaf pages after it, so that a forward
+	 * scan (#MDB_NEXT and friends) does not wait for each page in turn.
+	 * Unlike #MDB_NORDAHEAD this only affects the given cursor; it is
+	 * meant for cursors that walk a large part of a database whose pages
+	 * may not be cached. The setting is kept by #mdb_cursor_renew().
+	 * It has no effect on Windows.
+	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
+	 * @param[in] pages The number of leaf pages to read ahead, or 0 to
+	 * turn read-ahead off.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_cursor_readahead(MDB_cursor *cursor, unsigned int pages);
+
 	/** @brief Return the cursor's transaction handle.
 	 *
 	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
@@ -1211,6 +1211,14 @@ struct MDB_cursor {
 	unsigned int	mc_flags;	/**< @ref mdb_cursor */
 	MDB_page	*mc_pg[CURSOR_STACK];	/**< stack of pushed pages */
 	indx_t		mc_ki[CURSOR_STACK];	/**< stack of page indices */
+	/** Number of leaf pages to read ahead, set by #mdb_cursor_readahead() */
+	unsigned int	mc_rdahead;
+	/** Leaf page whose overflow pages were last read ahead */
+	MDB_page	*mc_rdleaf;
+	/** Branch page whose children were last read ahead */
+	MDB_page	*mc_rdparent;
+	/** First child of #mc_rdparent not read ahead yet */
+	indx_t		mc_rdnext;
 };
 
 	/** Context for sorted-dup records.
@@ -6322,6 +6330,96 @@ mdb_cursor_last(MDB_cursor *mc, MDB_val *key, MDB_val *data)
 	return MDB_SUCCESS;
 }
 
+/** Advise the OS that a range of pages will be read soon. */
+static void
+mdb_page_willneed(MDB_env *env, pgno_t pgno, pgno_t npages)
+{
+#if defined(MADV_WILLNEED) || defined(POSIX_MADV_WILLNEED)
+	char *ptr = env->me_map + (size_t)pgno * env->me_psize;
+	size_t len = (size_t)npages * env->me_psize;
+	size_t off = (size_t)(ptr - env->me_map) & (env->me_os_psize - 1);
+
+	ptr -= off;
+	len += off;
+#ifdef MADV_WILLNEED
+	madvise(ptr, len, MADV_WILLNEED);
+#else
+	posix_madvise(ptr, len, POSIX_MADV_WILLNEED);
+#endif
+#endif
+}
+
+/** Read ahead for a cursor that has just moved onto a new leaf page.
+ * Requests the overflow pages of the leaf's remaining nodes, and the
+ * next #MDB_cursor.%mc_rdahead leaf pages listed in the parent branch
+ * page, so a forward scan finds them in memory. Runs of consecutive
+ * page numbers are coalesced into a single request.
+ */
+static void
+mdb_cursor_prefetch(MDB_cursor *mc)
+{
+	MDB_env *env = mc->mc_txn->mt_env;
+	MDB_page *mp = mc->mc_pg[mc->mc_top];
+	MDB_page *parent;
+	MDB_node *node;
+	pgno_t pg, first = 0, count = 0;
+	unsigned int i, end, nkeys;
+
+	mc->mc_rdleaf = mp;
+
+	if (!IS_LEAF2(mp)) {
+		nkeys = NUMKEYS(mp);
+		for (i = mc->mc_ki[mc->mc_top]; i < nkeys; i++) {
+			node = NODEPTR(mp, i);
+			if (!F_ISSET(node->mn_flags, F_BIGDATA))
+				continue;
+			memcpy(&pg, NODEDATA(node), sizeof(pg));
+			if (count && pg == first + count) {
+				count += OVPAGES(NODEDSZ(node), env->me_psize);
+				continue;
+			}
+			if (count)
+				mdb_page_willneed(env, first, count);
+			first = pg;
+			count = OVPAGES(NODEDSZ(node), env->me_psize);
+		}
+	}
+
+	if (mc->mc_snum < 2)
+		goto done;
+
+	parent = mc->mc_pg[mc->mc_top-1];
+	i = mc->mc_ki[mc->mc_top-1] + 1;
+	/* Only issue more requests once half the window has been used */
+	if (parent == mc->mc_rdparent) {
+		if (i + mc->mc_rdahead / 2 < mc->mc_rdnext)
+			goto done;
+		if (i < mc->mc_rdnext)
+			i = mc->mc_rdnext;
+	}
+	nkeys = NUMKEYS(parent);
+	end = mc->mc_ki[mc->mc_top-1] + 1 + mc->mc_rdahead;
+	if (end > nkeys)
+		end = nkeys;
+	for (; i < end; i++) {
+		pg = NODEPGNO(NODEPTR(parent, i));
+		if (count && pg == first + count) {
+			count++;
+			continue;
+		}
+		if (count)
+			mdb_page_willneed(env, first, count);
+		first = pg;
+		count = 1;
+	}
+	mc->mc_rdparent = parent;
+	mc->mc_rdnext = end;
+
+done:
+	if (count)
+		mdb_page_willneed(env, first, count);
+}
+
 int
 mdb_cursor_get(MDB_cursor *mc, MDB_val *key, MDB_val *data,
     MDB_cursor_op op)
@@ -6506,6 +6604,10 @@ fetchm:
 	if (mc->mc_flags & C_DEL)
 		mc->mc_flags ^= C_DEL;
 
+	if (mc->mc_rdahead && rc == MDB_SUCCESS &&
+		mc->mc_pg[mc->mc_top] != mc->mc_rdleaf)
+		mdb_cursor_prefetch(mc);
+
 	return rc;
 }
 
@@ -7524,6 +7626,10 @@ mdb_xcursor_init0(MDB_cursor *mc)
 	mx->mx_cursor.mc_snum = 0;
 	mx->mx_cursor.mc_top = 0;
 	mx->mx_cursor.mc_flags = C_SUB;
+	mx->mx_cursor.mc_rdahead = 0;
+	mx->mx_cursor.mc_rdleaf = NULL;
+	mx->mx_cursor.mc_rdparent = NULL;
+	mx->mx_cursor.mc_rdnext = 0;
 	mx->mx_dbx.md_name.mv_size = 0;
 	mx->mx_dbx.md_name.mv_data = NULL;
 	mx->mx_dbx.md_cmp = mc->mc_dbx->md_dcmp;
@@ -7627,6 +7733,10 @@ mdb_cursor_init(MDB_cursor *mc, MDB_txn *txn, MDB_dbi dbi, MDB_xcursor *mx)
 	mc->mc_pg[0] = 0;
 	mc->mc_ki[0] = 0;
 	mc->mc_flags = 0;
+	mc->mc_rdahead = 0;
+	mc->mc_rdleaf = NULL;
+	mc->mc_rdparent = NULL;
+	mc->mc_rdnext = 0;
 	if (txn->mt_dbs[dbi].md_flags & MDB_DUPSORT) {
 		mdb_tassert(txn, mx != NULL);
 		mc->mc_xcursor = mx;
@@ -7685,7 +7795,24 @@ mdb_cursor_renew(MDB_txn *txn, MDB_cursor *mc)
 	if (txn->mt_flags & MDB_TXN_BLOCKED)
 		return MDB_BAD_TXN;
 
-	mdb_cursor_init(mc, txn, mc->mc_dbi, mc->mc_xcursor);
+	{
+		unsigned int rdahead = mc->mc_rdahead;
+		mdb_cursor_init(mc, txn, mc->mc_dbi, mc->mc_xcursor);
+		mc->mc_rdahead = rdahead;
+	}
+	return MDB_SUCCESS;
+}
+
+int
+mdb_cursor_readahead(MDB_cursor *mc, unsigned int pages)
+{
+	if (!mc || (mc->mc_flags & C_SUB))
+		return EINVAL;
+
+	mc->mc_rdahead = pages;
+	mc->mc_rdleaf = NULL;
+	mc->mc_rdparent = NULL;
+	mc->mc_rdnext = 0;
 	return MDB_SUCCESS;
 }
 
@@ -8235,6 +8362,7 @@ mdb_cursor_copy(const MDB_cursor *csrc, MDB_cursor *cdst)
 	cdst->mc_snum = csrc->mc_snum;
 	cdst->mc_top = csrc->mc_top;
 	cdst->mc_flags = csrc->mc_flags;
+	cdst->mc_rdahead = 0;
 
 	for (i=0; i<csrc->mc_snum; i++) {
 		cdst->mc_pg[i] = csrc->mc_pg[i];
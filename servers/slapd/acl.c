@@ -69,10 +69,85 @@ static slap_control_t slap_acl_mask(
 	slap_access_t access );
 
 static int	regex_matches(
+	Operation *op,
 	struct berval *pat, char *str,
 	struct berval *dn_matches, struct berval *val_matches,
 	AclRegexMatches *matches);
 
+/*
+ * Per-operation ACL decision cache, enabled by "acl-cache on".
+ *
+ * An operation evaluates the same ACL list many times: for every
+ * attribute and value of every entry it returns. Two results are
+ * remembered for the life of the operation:
+ *
+ * - which ACLs have a "to" part (DN, and for searches the filter)
+ *   that does not match the current entry, so that they are skipped
+ *   for the remaining attributes of that entry without running their
+ *   regex or filter again;
+ * - the outcome of each "by" regular expression, keyed by the
+ *   expanded pattern and the string it was matched against, so that
+ *   it is compiled and run once per operation instead of once per
+ *   check.
+ *
+ * Group membership is already cached per operation in o_groups.
+ *
+ * The cache is allocated for client operations when they start and is
+ * only used by the thread it was allocated on; copies of an operation
+ * that run elsewhere, e.g. parallel search tasks, go without it.
+ */
+int slap_acl_cache;
+
+#define ACL_CACHE_MAXREGEX	64
+
+typedef struct AclMiss {
+	AccessControl *am_acl;
+	unsigned int am_serial;		/* valid when equal to ac_serial */
+} AclMiss;
+
+typedef struct AclRegexResult {
+	struct AclRegexResult *ar_next;
+	struct berval *ar_pat;		/* pattern as configured */
+	struct berval ar_expanded;
+	struct berval ar_str;
+	int ar_match;
+} AclRegexResult;
+
+struct AclCache {
+	void *ac_memctx;
+	ldap_pvt_thread_t ac_thread;	/* the only thread using it */
+	unsigned int ac_gen;
+
+	/* Hash set of the ACLs whose "to" part does not match the
+	 * entry ac_e/ac_ndn. ac_serial changes whenever it is reset
+	 * for another entry, which a nested check (e.g. on a group
+	 * entry) can do while an outer one is running. */
+	unsigned int ac_serial;
+	Entry *ac_e;
+	struct berval ac_ndn;
+	ber_len_t ac_ndnsize;
+	AclMiss *ac_miss;
+	int ac_misssize;		/* power of 2 */
+	int ac_nmiss;
+
+	AclRegexResult *ac_regex;
+	int ac_nregex;
+
+	unsigned long ac_hits;
+	unsigned long ac_misses;
+};
+
+static unsigned int acl_cache_gen;
+static unsigned long acl_cache_hits, acl_cache_misses;
+
+#ifdef __GNUC__
+#define ACL_ADD(p,n)	__atomic_fetch_add( (p), (n), __ATOMIC_RELAXED )
+#define ACL_LOAD(p)	__atomic_load_n( (p), __ATOMIC_RELAXED )
+#else
+#define ACL_ADD(p,n)	(*(p) += (n))
+#define ACL_LOAD(p)	(*(p))
+#endif
+
 typedef	struct AclSetCookie {
 	SetCookie	asc_cookie;
 #define	asc_op		asc_cookie.set_op
@@ -489,6 +564,210 @@ done:
 }
 
 
+void
+acl_cache_invalidate( void )
+{
+	ACL_ADD( &acl_cache_gen, 1 );
+}
+
+void
+acl_cache_free( Operation *op )
+{
+	AclCache *ac = op->o_aclcache;
+	AclRegexResult *ar, *next;
+
+	op->o_aclcache = NULL;
+	if ( ac == NULL )
+		return;
+
+	if ( ac->ac_hits )
+		ACL_ADD( &acl_cache_hits, ac->ac_hits );
+	if ( ac->ac_misses )
+		ACL_ADD( &acl_cache_misses, ac->ac_misses );
+
+	for ( ar = ac->ac_regex; ar; ar = next ) {
+		next = ar->ar_next;
+		slap_sl_free( ar, ac->ac_memctx );
+	}
+	if ( ac->ac_miss )
+		slap_sl_free( ac->ac_miss, ac->ac_memctx );
+	if ( ac->ac_ndn.bv_val )
+		slap_sl_free( ac->ac_ndn.bv_val, ac->ac_memctx );
+	slap_sl_free( ac, ac->ac_memctx );
+}
+
+void
+acl_cache_stats( unsigned long *hits, unsigned long *misses )
+{
+	*hits = ACL_LOAD( &acl_cache_hits );
+	*misses = ACL_LOAD( &acl_cache_misses );
+}
+
+/*
+ * Do the access controls of a database, including the global ones,
+ * depend on properties of the client's connection? Two operations by
+ * the same identity can then be granted different access.
+ */
+int
+acl_uses_connection( BackendDB *be )
+{
+	AccessControl *acls[2], *a;
+	Access *b;
+	int i;
+
+	acls[0] = be ? be->be_acl : NULL;
+	acls[1] = frontendDB->be_acl;
+	for ( i = 0; i < 2; i++ ) {
+		for ( a = acls[i]; a != NULL; a = a->acl_next ) {
+			for ( b = a->acl_access; b != NULL; b = b->a_next ) {
+				if ( !BER_BVISNULL( &b->a_peername_pat ) ||
+					!BER_BVISNULL( &b->a_sockname_pat ) ||
+					!BER_BVISNULL( &b->a_sockurl_pat ) ||
+					!BER_BVISNULL( &b->a_domain_pat ) ||
+					b->a_authz.sai_ssf ||
+					b->a_authz.sai_transport_ssf ||
+					b->a_authz.sai_tls_ssf ||
+					b->a_authz.sai_sasl_ssf )
+					return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+void
+acl_cache_alloc( Operation *op )
+{
+	AclCache *ac;
+
+	assert( op->o_aclcache == NULL );
+
+	ac = slap_sl_calloc( 1, sizeof( AclCache ), op->o_tmpmemctx );
+	ac->ac_memctx = op->o_tmpmemctx;
+	ac->ac_thread = ldap_pvt_thread_self();
+	ac->ac_gen = ACL_LOAD( &acl_cache_gen );
+	op->o_aclcache = ac;
+}
+
+static AclCache *
+acl_cache_get( Operation *op )
+{
+	AclCache *ac = op->o_aclcache;
+	unsigned int gen;
+
+	if ( ac == NULL ||
+		!ldap_pvt_thread_equal( ac->ac_thread, ldap_pvt_thread_self() ))
+		return NULL;
+
+	gen = ACL_LOAD( &acl_cache_gen );
+	if ( ac->ac_gen != gen ) {
+		/* ACLs were changed under us, e.g. by a replicated
+		 * cn=config update during a pause */
+		AclRegexResult *ar, *next;
+
+		for ( ar = ac->ac_regex; ar; ar = next ) {
+			next = ar->ar_next;
+			slap_sl_free( ar, ac->ac_memctx );
+		}
+		ac->ac_regex = NULL;
+		ac->ac_nregex = 0;
+		ac->ac_e = NULL;
+		ac->ac_gen = gen;
+	}
+
+	return ac;
+}
+
+/* Point the "to" cache at entry e */
+static unsigned int
+acl_cache_entry( AclCache *ac, Entry *e )
+{
+	if ( ac->ac_e == e && bvmatch( &ac->ac_ndn, &e->e_nname ) )
+		return ac->ac_serial;
+
+	if ( ac->ac_ndnsize <= e->e_nname.bv_len ) {
+		ac->ac_ndnsize = e->e_nname.bv_len + 1;
+		ac->ac_ndn.bv_val = slap_sl_realloc( ac->ac_ndn.bv_val,
+			ac->ac_ndnsize, ac->ac_memctx );
+	}
+	AC_MEMCPY( ac->ac_ndn.bv_val, e->e_nname.bv_val, e->e_nname.bv_len );
+	ac->ac_ndn.bv_len = e->e_nname.bv_len;
+	ac->ac_ndn.bv_val[ ac->ac_ndn.bv_len ] = '\0';
+	ac->ac_e = e;
+	ac->ac_nmiss = 0;
+	if ( ++ac->ac_serial == 0 ) {
+		/* wrapped, old slots could look valid again */
+		if ( ac->ac_miss )
+			memset( ac->ac_miss, 0, ac->ac_misssize * sizeof( AclMiss ) );
+		ac->ac_serial = 1;
+	}
+	return ac->ac_serial;
+}
+
+#define ACL_MISS_HASH(ac,a) \
+	( ( (unsigned int)( (uintptr_t)(a) >> 4 ) * 2654435761U ) & \
+		( (ac)->ac_misssize - 1 ) )
+
+static int
+acl_cache_missed( AclCache *ac, AccessControl *a )
+{
+	AclMiss *am;
+	int i;
+
+	if ( ac->ac_nmiss ) {
+		for ( i = ACL_MISS_HASH( ac, a ); ; i = ( i + 1 ) & ( ac->ac_misssize - 1 ) ) {
+			am = &ac->ac_miss[ i ];
+			if ( am->am_serial != ac->ac_serial )
+				break;
+			if ( am->am_acl == a ) {
+				ac->ac_hits++;
+				return 1;
+			}
+		}
+	}
+	ac->ac_misses++;
+	return 0;
+}
+
+static void
+acl_cache_set_miss( AclCache *ac, AccessControl *a )
+{
+	AclMiss *am;
+	int i;
+
+	if ( ( ac->ac_nmiss + 1 ) * 2 > ac->ac_misssize ) {
+		AclMiss *old = ac->ac_miss;
+		int j, oldsize = ac->ac_misssize;
+
+		ac->ac_misssize = oldsize ? oldsize * 2 : 64;
+		ac->ac_miss = slap_sl_calloc( ac->ac_misssize, sizeof( AclMiss ),
+			ac->ac_memctx );
+		for ( j = 0; j < oldsize; j++ ) {
+			if ( old[ j ].am_serial != ac->ac_serial )
+				continue;
+			for ( i = ACL_MISS_HASH( ac, old[ j ].am_acl );
+				ac->ac_miss[ i ].am_serial == ac->ac_serial;
+				i = ( i + 1 ) & ( ac->ac_misssize - 1 ) )
+				;
+			ac->ac_miss[ i ] = old[ j ];
+		}
+		if ( old )
+			slap_sl_free( old, ac->ac_memctx );
+	}
+
+	for ( i = ACL_MISS_HASH( ac, a ); ; i = ( i + 1 ) & ( ac->ac_misssize - 1 ) ) {
+		am = &ac->ac_miss[ i ];
+		if ( am->am_serial != ac->ac_serial ) {
+			am->am_acl = a;
+			am->am_serial = ac->ac_serial;
+			ac->ac_nmiss++;
+			return;
+		}
+		if ( am->am_acl == a )
+			return;
+	}
+}
+
 /*
  * slap_acl_get - return the acl applicable to entry e, attribute
  * attr.  the acl returned is suitable for use in subsequent calls to
@@ -510,6 +789,8 @@ slap_acl_get(
 	const char *attr;
 	ber_len_t dnlen;
 	AccessControl *prev;
+	AclCache *ac = NULL;
+	unsigned int serial = 0;
 
 	assert( e != NULL );
 	assert( count != NULL );
@@ -538,6 +819,9 @@ slap_acl_get(
 
 	dnlen = e->e_nname.bv_len;
 
+	if ( slap_acl_cache && ( ac = acl_cache_get( op )) != NULL )
+		serial = acl_cache_entry( ac, e );
+
  retry:
 	for ( ; a != NULL; prev = a, a = a->acl_next ) {
 		(*count) ++;
@@ -545,6 +829,13 @@ slap_acl_get(
 		if ( a != frontendDB->be_acl && state->as_fe_done )
 			state->as_fe_done++;
 
+		if ( ac ) {
+			if ( ac->ac_serial != serial )
+				serial = acl_cache_entry( ac, e );
+			if ( acl_cache_missed( ac, a ) )
+				continue;
+		}
+
 		if ( a->acl_dn_pat.bv_len || ( a->acl_dn_style != ACL_STYLE_REGEX )) {
 			if ( a->acl_dn_style == ACL_STYLE_REGEX ) {
 				Debug( LDAP_DEBUG_ACL, "=> dnpat: [%d] %s nsub: %d\n", 
@@ -553,7 +844,7 @@ slap_acl_get(
 					       e->e_ndn, 
 				 	       matches->dn_count, 
 					       matches->dn_data, 0 ) )
-					continue;
+					goto nomatch;
 
 			} else {
 				ber_len_t patlen;
@@ -562,43 +853,43 @@ slap_acl_get(
 					*count, a->acl_dn_pat.bv_val );
 				patlen = a->acl_dn_pat.bv_len;
 				if ( dnlen < patlen )
-					continue;
+					goto nomatch;
 
 				if ( a->acl_dn_style == ACL_STYLE_BASE ) {
 					/* base dn -- entire object DN must match */
 					if ( dnlen != patlen )
-						continue;
+						goto nomatch;
 
 				} else if ( a->acl_dn_style == ACL_STYLE_ONE ) {
 					ber_len_t	rdnlen = 0;
 					ber_len_t	sep = 0;
 
 					if ( dnlen <= patlen )
-						continue;
+						goto nomatch;
 
 					if ( patlen > 0 ) {
 						if ( !DN_SEPARATOR( e->e_ndn[dnlen - patlen - 1] ) )
-							continue;
+							goto nomatch;
 						sep = 1;
 					}
 
 					rdnlen = dn_rdnlen( NULL, &e->e_nname );
 					if ( rdnlen + patlen + sep != dnlen )
-						continue;
+						goto nomatch;
 
 				} else if ( a->acl_dn_style == ACL_STYLE_SUBTREE ) {
 					if ( dnlen > patlen && !DN_SEPARATOR( e->e_ndn[dnlen - patlen - 1] ) )
-						continue;
+						goto nomatch;
 
 				} else if ( a->acl_dn_style == ACL_STYLE_CHILDREN ) {
 					if ( dnlen <= patlen )
-						continue;
+						goto nomatch;
 					if ( !DN_SEPARATOR( e->e_ndn[dnlen - patlen - 1] ) )
-						continue;
+						goto nomatch;
 				}
 
 				if ( strcmp( a->acl_dn_pat.bv_val, e->e_ndn + dnlen - patlen ) != 0 )
-					continue;
+					goto nomatch;
 			}
 
 			Debug( LDAP_DEBUG_ACL, "=> acl_get: [%d] matched\n",
@@ -696,13 +987,25 @@ slap_acl_get(
 		if ( a->acl_filter != NULL ) {
 			ber_int_t rc = test_filter( NULL, e, a->acl_filter );
 			if ( rc != LDAP_COMPARE_TRUE ) {
-				continue;
+				/* Other operations may see the entry change
+				 * under the same pointer and DN */
+				if ( op->o_tag != LDAP_REQ_SEARCH )
+					continue;
+				goto nomatch;
 			}
 		}
 
 		Debug( LDAP_DEBUG_ACL, "=> acl_get: [%d] attr %s\n",
 		       *count, attr );
 		return a;
+
+nomatch:
+		if ( ac ) {
+			/* the filter may have run a nested check */
+			if ( ac->ac_serial != serial )
+				serial = acl_cache_entry( ac, e );
+			acl_cache_set_miss( ac, a );
+		}
 	}
 
 	if ( !state->as_fe_done ) {
@@ -836,7 +1139,7 @@ acl_mask_dn(
 				return 1;
 			}
 
-			if ( !regex_matches( &bdn->a_pat, opndn->bv_val,
+			if ( !regex_matches( op, &bdn->a_pat, opndn->bv_val,
 				&e->e_nname, NULL, tmp_matchesp ) )
 			{
 				return 1;
@@ -1251,7 +1554,7 @@ slap_acl_mask(
 
 			if ( !ber_bvccmp( &b->a_sockurl_pat, '*' ) ) {
 				if ( b->a_sockurl_style == ACL_STYLE_REGEX) {
-					if ( !regex_matches( &b->a_sockurl_pat, op->o_conn->c_listener_url.bv_val,
+					if ( !regex_matches( op, &b->a_sockurl_pat, op->o_conn->c_listener_url.bv_val,
 							&e->e_nname, val, matches ) ) 
 					{
 						continue;
@@ -1290,7 +1593,7 @@ slap_acl_mask(
 				b->a_domain_pat.bv_val );
 			if ( !ber_bvccmp( &b->a_domain_pat, '*' ) ) {
 				if ( b->a_domain_style == ACL_STYLE_REGEX) {
-					if ( !regex_matches( &b->a_domain_pat, op->o_conn->c_peer_domain.bv_val,
+					if ( !regex_matches( op, &b->a_domain_pat, op->o_conn->c_peer_domain.bv_val,
 							&e->e_nname, val, matches ) ) 
 					{
 						continue;
@@ -1344,7 +1647,7 @@ slap_acl_mask(
 				b->a_peername_pat.bv_val );
 			if ( !ber_bvccmp( &b->a_peername_pat, '*' ) ) {
 				if ( b->a_peername_style == ACL_STYLE_REGEX ) {
-					if ( !regex_matches( &b->a_peername_pat, op->o_conn->c_peer_name.bv_val,
+					if ( !regex_matches( op, &b->a_peername_pat, op->o_conn->c_peer_name.bv_val,
 							&e->e_nname, val, matches ) ) 
 					{
 						continue;
@@ -1496,7 +1799,7 @@ slap_acl_mask(
 				b->a_sockname_pat.bv_val );
 			if ( !ber_bvccmp( &b->a_sockname_pat, '*' ) ) {
 				if ( b->a_sockname_style == ACL_STYLE_REGEX) {
-					if ( !regex_matches( &b->a_sockname_pat, op->o_conn->c_sock_name.bv_val,
+					if ( !regex_matches( op, &b->a_sockname_pat, op->o_conn->c_sock_name.bv_val,
 							&e->e_nname, val, matches ) ) 
 					{
 						continue;
@@ -2638,6 +2941,7 @@ acl_string_expand(
 
 static int
 regex_matches(
+	Operation	*op,		/* operation, for the ACL cache */
 	struct berval	*pat,		/* pattern to expand and match against */
 	char		*str,		/* string to match against pattern */
 	struct berval	*dn_matches,	/* buffer with $N expansion variables from DN */
@@ -2649,6 +2953,9 @@ regex_matches(
 	char newbuf[ACL_BUF_SIZE];
 	struct berval bv;
 	int	rc;
+	AclCache *ac = NULL;
+	AclRegexResult *ar;
+	ber_len_t len = 0;
 
 	bv.bv_len = sizeof( newbuf ) - 1;
 	bv.bv_val = newbuf;
@@ -2663,6 +2970,23 @@ regex_matches(
 			pat->bv_val, str );
 		return( 0 );
 	}
+
+	if ( slap_acl_cache && op != NULL &&
+		( ac = acl_cache_get( op )) != NULL )
+	{
+		len = strlen( str );
+		for ( ar = ac->ac_regex; ar; ar = ar->ar_next ) {
+			if ( ar->ar_pat == pat && ar->ar_str.bv_len == len &&
+				bvmatch( &ar->ar_expanded, &bv ) &&
+				memcmp( ar->ar_str.bv_val, str, len ) == 0 )
+			{
+				ac->ac_hits++;
+				return ar->ar_match;
+			}
+		}
+		ac->ac_misses++;
+	}
+
 	rc = regcomp( &re, newbuf, REG_EXTENDED|REG_ICASE );
 	if ( rc ) {
 		char error[ACL_BUF_SIZE];
@@ -2682,6 +3006,23 @@ regex_matches(
 	Debug( LDAP_DEBUG_TRACE,
 	    "=> regex_matches: rc: %d %s\n",
 		rc, !rc ? "matches" : "no matches" );
+
+	if ( ac && ac->ac_nregex < ACL_CACHE_MAXREGEX ) {
+		ar = slap_sl_malloc( sizeof( AclRegexResult ) +
+			bv.bv_len + 1 + len + 1, ac->ac_memctx );
+		ar->ar_pat = pat;
+		ar->ar_match = !rc;
+		ar->ar_expanded.bv_val = (char *)( ar + 1 );
+		ar->ar_expanded.bv_len = bv.bv_len;
+		AC_MEMCPY( ar->ar_expanded.bv_val, bv.bv_val, bv.bv_len + 1 );
+		ar->ar_str.bv_val = ar->ar_expanded.bv_val + bv.bv_len + 1;
+		ar->ar_str.bv_len = len;
+		AC_MEMCPY( ar->ar_str.bv_val, str, len + 1 );
+		ar->ar_next = ac->ac_regex;
+		ac->ac_regex = ar;
+		ac->ac_nregex++;
+	}
+
 	return( !rc );
 }
 
@@ -2306,6 +2306,7 @@ acl_append( AccessControl **l, AccessControl *a, int pos )
 	if ( *l && a )
 		a->acl_next = *l;
 	*l = a;
+	acl_cache_invalidate();
 }
 
 static void
@@ -2388,6 +2389,7 @@ acl_free( AccessControl *a )
 		access_free( a->acl_access );
 	}
 	free( a );
+	acl_cache_invalidate();
 }
 
 void
@@ -76,6 +76,40 @@ static int msad_range_hack = 0;
 
 static int ad_count;
 
+/*
+ * Per-thread cache of recent name to AttributeDescription lookups, used
+ * when decoding search requests. Clients reuse a small set of filter
+ * shapes and attribute lists, so most names are found here instead of
+ * going through at_bvfind() and the option parser each time. Only
+ * successful lookups are kept; ADs are never freed while running, and
+ * every slot is dropped when a type or option definition changes.
+ */
+#define AD_CACHE_SIZE		64	/* must be a power of 2 */
+#define AD_CACHE_NAMELEN	32
+
+typedef struct ad_cache_slot {
+	AttributeDescription *acs_ad;
+	ber_len_t acs_len;
+	char acs_name[AD_CACHE_NAMELEN];
+} ad_cache_slot;
+
+typedef struct ad_cache {
+	unsigned int ac_gen;
+	ad_cache_slot ac_slots[AD_CACHE_SIZE];
+} ad_cache;
+
+/* Bumped by schema changes, which happen while the server is paused,
+ * and read by every lookup */
+static unsigned int ad_cache_gen;
+
+#ifdef __GNUC__
+#define AD_GEN_BUMP(p)	__atomic_fetch_add( (p), 1, __ATOMIC_RELEASE )
+#define AD_GEN_LOAD(p)	__atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#else
+#define AD_GEN_BUMP(p)	(++*(p))
+#define AD_GEN_LOAD(p)	(*(p))
+#endif
+
 static Attr_option *ad_find_option_definition( const char *opt, int optlen );
 
 int ad_keystring(
@@ -461,6 +495,79 @@ done:;
 	return LDAP_SUCCESS;
 }
 
+void
+ad_cache_invalidate( void )
+{
+	AD_GEN_BUMP( &ad_cache_gen );
+}
+
+static void
+ad_cache_free( void *key, void *data )
+{
+	ch_free( data );
+}
+
+int slap_bv2ad_cached(
+	void *ctx,
+	struct berval *bv,
+	AttributeDescription **ad,
+	const char **text )
+{
+	ad_cache *ac = NULL;
+	ad_cache_slot *acs;
+	unsigned int gen, h = 2166136261U;
+	ber_len_t i;
+	int rc;
+
+	if ( ctx == NULL || bv == NULL || BER_BVISNULL( bv ) ||
+		bv->bv_len == 0 || bv->bv_len > AD_CACHE_NAMELEN )
+	{
+		return slap_bv2ad( bv, ad, text );
+	}
+
+	gen = AD_GEN_LOAD( &ad_cache_gen );
+	ldap_pvt_thread_pool_getkey( ctx, (void *)slap_bv2ad_cached,
+		(void **)&ac, NULL );
+	if ( ac == NULL ) {
+		ac = ch_calloc( 1, sizeof( ad_cache ) );
+		if ( ldap_pvt_thread_pool_setkey( ctx, (void *)slap_bv2ad_cached,
+			ac, ad_cache_free, NULL, NULL ) )
+		{
+			ch_free( ac );
+			return slap_bv2ad( bv, ad, text );
+		}
+		ac->ac_gen = gen;
+
+	} else if ( ac->ac_gen != gen ) {
+		memset( ac->ac_slots, 0, sizeof( ac->ac_slots ) );
+		ac->ac_gen = gen;
+	}
+
+	/* FNV-1a; names are matched exactly, so "cn" and "CN" use
+	 * separate slots */
+	for ( i = 0; i < bv->bv_len; i++ ) {
+		h ^= (unsigned char)bv->bv_val[i];
+		h *= 16777619U;
+	}
+	acs = &ac->ac_slots[ h & ( AD_CACHE_SIZE - 1 ) ];
+
+	if ( acs->acs_ad != NULL && acs->acs_len == bv->bv_len &&
+		memcmp( acs->acs_name, bv->bv_val, bv->bv_len ) == 0 )
+	{
+		*ad = acs->acs_ad;
+		return LDAP_SUCCESS;
+	}
+
+	rc = slap_bv2ad( bv, ad, text );
+	if ( rc == LDAP_SUCCESS ) {
+		acs->acs_ad = *ad;
+		acs->acs_len = bv->bv_len;
+		AC_MEMCPY( acs->acs_name, bv->bv_val, bv->bv_len );
+	}
+
+	return rc;
+}
+
 static int is_ad_subtags(
 	struct berval *subtagsbv, 
 	struct berval *suptagsbv )
@@ -1239,6 +1346,7 @@ ad_define_option( const char *name, const char *fname, int lineno )
 
 	options[i].name.bv_val = ch_strdup( name );
 	options[i].name.bv_len = optlen;
+	ad_cache_invalidate();
 	options[i].prefix = (name[optlen-1] == '-') ||
  		(name[optlen-1] == '=');
 
@@ -258,6 +258,7 @@ at_delete( AttributeType *at )
 	LDAP_STAILQ_REMOVE(&attr_list, at, AttributeType, sat_next);
 
 	at_delete_names( at );
+	ad_cache_invalidate();
 }
 
 static void
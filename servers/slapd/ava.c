@@ -84,7 +84,7 @@ get_ava(
 	aa->aa_cf = NULL;
 #endif
 
-	rc = slap_bv2ad( &type, &aa->aa_desc, text );
+	rc = slap_bv2ad_cached( op->o_threadctx, &type, &aa->aa_desc, text );
 
 	if( rc != LDAP_SUCCESS ) {
 		f->f_choice |= SLAPD_FILTER_UNDEFINED;
@@ -115,7 +115,9 @@ mdb_attr_dbs_open(
 		rc = 0;
 	}
 
-	flags = MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP;
+	flags = MDB_DUPSORT;
+	if ( !mdb->mi_idlcompress )
+		flags |= MDB_DUPFIXED|MDB_INTEGERDUP;
 	if ( !(slapMode & SLAP_TOOL_READONLY) )
 		flags |= MDB_CREATE;
 
@@ -137,6 +139,16 @@ mdb_attr_dbs_open(
 				cr->msg );
 			break;
 		}
+		/* Existing indices keep their format until slapindex rebuilds them */
+		if (( slapMode & SLAP_SERVER_MODE ) &&
+			mdb_idl_packed( txn, mdb->mi_attrs[i]->ai_dbi ) != !!mdb->mi_idlcompress ) {
+			Debug( LDAP_DEBUG_ANY,
+				LDAP_XSTRING(mdb_attr_dbs) ": database \"%s\": "
+				"index %s does not match idlcompress setting, "
+				"run slapindex to convert it.\n",
+				be->be_suffix[0].bv_val,
+				mdb->mi_attrs[i]->ai_desc->ad_type->sat_cname.bv_val );
+		}
 		/* Remember newly opened DBI handles */
 		if ( dbis )
 			dbis[i] = mdb->mi_attrs[i]->ai_dbi;
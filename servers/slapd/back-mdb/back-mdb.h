@@ -52,6 +52,9 @@ LDAP_BEGIN_DECL
 /* Most users will never see this */
 #define DEFAULT_RTXN_SIZE	10000
 
+/* Leaf pages LMDB reads ahead of a sequential id2entry scan */
+#define MDB_READAHEAD	16
+
 #ifdef LDAP_DEVEL
 #define MDB_MONITOR_IDX
 #endif
@@ -114,6 +117,34 @@ struct mdb_info {
 		/* less than this many values in an attr goes
 		 * back into main blob */
 
+	int		mi_idlcompress;
+		/* new index DBs store packed IDL blocks */
+
+	unsigned	mi_scan_threads;
+		/* pool threads used to filter large candidate lists */
+
+	unsigned long	mi_ecache_max;
+	struct mdb_ecache	*mi_ecache;
+
+	unsigned	mi_index_rate;
+		/* max entries per second for the online indexer */
+
+	/* online indexer progress, written only by the indexer task */
+	int		mi_ixb_active;
+	ID		mi_ixb_pos;	/* next ID to index */
+	ID		mi_ixb_start;	/* position when this run of the build started */
+	ID		mi_ixb_last;	/* last ID in id2entry when the build started */
+	unsigned long	mi_ixb_count;	/* entries indexed by this run */
+	time_t		mi_ixb_time;	/* when this run started */
+
+	unsigned	mi_gc_max;
+		/* max write ops sharing one group commit */
+	int		mi_gc_busy;	/* a member txn is open, or a batch is starting */
+	int		mi_gc_waiters;	/* writers waiting for mi_gc_busy */
+	struct mdb_gcbatch	*mi_gc_batch;	/* batch open for new members */
+	ldap_pvt_thread_mutex_t	mi_gc_mutex;
+	ldap_pvt_thread_cond_t	mi_gc_cond;
+
 	MDB_dbi	mi_dbis[MDB_NDB];
 	AttributeDescription *mi_ads[MDB_MAXADS];
 	int mi_adxs[MDB_MAXADS];
@@ -130,10 +161,13 @@ typedef struct mdb_op_info {
 	MDB_txn*	moi_txn;
 	int			moi_ref;
 	char		moi_flag;
+	int			moi_numads;	/* mi_numads when the write txn began */
+	struct mdb_gcbatch	*moi_gcb;	/* group commit this txn belongs to */
 } mdb_op_info;
 #define MOI_READER	0x01
 #define MOI_FREEIT	0x02
 #define MOI_KEEPER	0x04
+#define MOI_GCLEADER	0x08
 
 LDAP_END_DECL
 
@@ -0,0 +1,421 @@
+/* cache.c - cache of decoded entries */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 2000-2022 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+#include <ac/string.h>
+
+#include "back-mdb.h"
+
+/*
+ * Entries from mdb_entry_decode() point into the memory map and are
+ * only good for the life of the read txn that decoded them, so the
+ * cache keeps a self-contained copy of each entry. A reader that hits
+ * gets its own copy of the Entry, Attribute and berval arrays, which
+ * share the cached value data, and holds a reference on the cached
+ * copy until mdb_entry_return().
+ *
+ * A cached copy is only correct for readers whose snapshot includes
+ * the write that produced it. Writers invalidate the IDs they touch
+ * from within their write txn, before it commits, and raise the
+ * shard's modification txn to their own txn ID. A reader may only add
+ * an entry if its snapshot is at least that new, and the copy is then
+ * valid for all readers whose snapshot is at least the shard's
+ * modification txn at the time it was added.
+ *
+ * The cache is split into shards by ID, each with its own mutex, AVL
+ * tree, LRU list and an equal share of the configured memory budget.
+ */
+
+#define MDB_ECACHE_SHARDS	64	/* must be a power of 2 */
+
+typedef struct mdb_ecnode {
+	ID		ecn_id;
+	size_t		ecn_txnid;	/* oldest snapshot the copy is valid for */
+	unsigned long	ecn_size;	/* size of the whole allocation */
+	size_t		ecn_hdrsize;	/* size of the Entry/Attribute/berval arrays */
+	int		ecn_refcnt;	/* readers holding a copy */
+	int		ecn_cached;	/* still linked into the shard */
+	struct mdb_ecshard	*ecn_shard;
+	struct mdb_ecnode	*ecn_lrunext, *ecn_lruprev;
+} mdb_ecnode;
+
+#define ECNODE_ENTRY(n)	((Entry *)((n)+1))
+
+typedef struct mdb_ecshard {
+	ldap_pvt_thread_mutex_t	ecs_mutex;
+	Avlnode		*ecs_tree;
+	mdb_ecnode	*ecs_lruhead, *ecs_lrutail;
+	size_t		ecs_modtxn;
+	unsigned long	ecs_size;
+	unsigned long	ecs_count;
+	unsigned long	ecs_hits;
+	unsigned long	ecs_misses;
+} mdb_ecshard;
+
+struct mdb_ecache {
+	mdb_ecshard	ec_shards[MDB_ECACHE_SHARDS];
+};
+
+#define ECACHE_SHARD(mdb, id) \
+	(&(mdb)->mi_ecache->ec_shards[(id) & (MDB_ECACHE_SHARDS-1)])
+
+static int
+ecnode_cmp( const void *v1, const void *v2 )
+{
+	const mdb_ecnode *n1 = v1, *n2 = v2;
+
+	return n1->ecn_id < n2->ecn_id ? -1 : n1->ecn_id > n2->ecn_id;
+}
+
+static void
+ecache_lru_del( mdb_ecshard *s, mdb_ecnode *n )
+{
+	if ( n->ecn_lruprev )
+		n->ecn_lruprev->ecn_lrunext = n->ecn_lrunext;
+	else
+		s->ecs_lruhead = n->ecn_lrunext;
+	if ( n->ecn_lrunext )
+		n->ecn_lrunext->ecn_lruprev = n->ecn_lruprev;
+	else
+		s->ecs_lrutail = n->ecn_lruprev;
+}
+
+static void
+ecache_lru_add( mdb_ecshard *s, mdb_ecnode *n )
+{
+	n->ecn_lruprev = NULL;
+	n->ecn_lrunext = s->ecs_lruhead;
+	if ( s->ecs_lruhead )
+		s->ecs_lruhead->ecn_lruprev = n;
+	else
+		s->ecs_lrutail = n;
+	s->ecs_lruhead = n;
+}
+
+/* Drop a node from its shard; it is freed once no reader holds it.
+ * Must be called with the shard mutex held.
+ */
+static void
+ecache_unlink( mdb_ecshard *s, mdb_ecnode *n )
+{
+	ldap_avl_delete( &s->ecs_tree, n, ecnode_cmp );
+	ecache_lru_del( s, n );
+	s->ecs_size -= n->ecn_size;
+	s->ecs_count--;
+	n->ecn_cached = 0;
+	if ( !n->ecn_refcnt )
+		ch_free( n );
+}
+
+static void
+ecache_trim( mdb_ecshard *s, unsigned long max )
+{
+	while ( s->ecs_size > max && s->ecs_lrutail )
+		ecache_unlink( s, s->ecs_lrutail );
+}
+
+/* Only plain read txns of the server may use the cache; a write txn
+ * sees its own uncommitted changes.
+ */
+static int
+ecache_reader( Operation *op, struct mdb_info *mdb, MDB_txn *txn )
+{
+	OpExtra *oex;
+	mdb_op_info *moi;
+
+	if ( !mdb->mi_ecache )
+		return 0;
+
+	LDAP_SLIST_FOREACH( oex, &op->o_extra, oe_next ) {
+		if ( oex->oe_key == mdb )
+			break;
+	}
+	moi = (mdb_op_info *)oex;
+	return moi && ( moi->moi_flag & MOI_READER ) && moi->moi_txn == txn;
+}
+
+static struct berval *
+ecache_copyvals( struct berval *dst, char **ptr, BerVarray src, unsigned n )
+{
+	unsigned i;
+
+	for ( i = 0; i < n; i++ ) {
+		dst->bv_len = src[i].bv_len;
+		dst->bv_val = *ptr;
+		AC_MEMCPY( *ptr, src[i].bv_val, src[i].bv_len );
+		(*ptr)[src[i].bv_len] = '\0';
+		*ptr += src[i].bv_len + 1;
+		dst++;
+	}
+	BER_BVZERO( dst );
+	return dst + 1;
+}
+
+int
+mdb_ecache_init( struct mdb_info *mdb )
+{
+	struct mdb_ecache *ec;
+	int i;
+
+	ec = ch_calloc( 1, sizeof( struct mdb_ecache ));
+	for ( i = 0; i < MDB_ECACHE_SHARDS; i++ )
+		ldap_pvt_thread_mutex_init( &ec->ec_shards[i].ecs_mutex );
+	mdb->mi_ecache = ec;
+	return 0;
+}
+
+void
+mdb_ecache_destroy( struct mdb_info *mdb )
+{
+	struct mdb_ecache *ec = mdb->mi_ecache;
+	int i;
+
+	if ( !ec )
+		return;
+
+	mdb->mi_ecache = NULL;
+	for ( i = 0; i < MDB_ECACHE_SHARDS; i++ ) {
+		mdb_ecshard *s = &ec->ec_shards[i];
+
+		ecache_trim( s, 0 );
+		ldap_pvt_thread_mutex_destroy( &s->ecs_mutex );
+	}
+	ch_free( ec );
+}
+
+/*
+ * Look up a decoded copy of entry id that is valid for txn. On success
+ * *e is a private copy that must be given back with mdb_entry_return().
+ */
+int
+mdb_ecache_get( Operation *op, MDB_txn *txn, ID id, Entry **e )
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	unsigned long max = mdb->mi_ecache_max / MDB_ECACHE_SHARDS;
+	mdb_ecshard *s;
+	mdb_ecnode *n, key;
+	Entry *x, *src;
+	Attribute *a;
+	char *d, *o;
+
+	if ( !ecache_reader( op, mdb, txn ))
+		return MDB_NOTFOUND;
+
+	s = ECACHE_SHARD( mdb, id );
+	key.ecn_id = id;
+
+	ldap_pvt_thread_mutex_lock( &s->ecs_mutex );
+	if ( s->ecs_size > max )
+		ecache_trim( s, max );
+	n = max ? ldap_avl_find( s->ecs_tree, &key, ecnode_cmp ) : NULL;
+	if ( n && n->ecn_txnid <= mdb_txn_id( txn )) {
+		n->ecn_refcnt++;
+		s->ecs_hits++;
+		if ( n != s->ecs_lruhead ) {
+			ecache_lru_del( s, n );
+			ecache_lru_add( s, n );
+		}
+	} else {
+		n = NULL;
+		if ( max )
+			s->ecs_misses++;
+	}
+	ldap_pvt_thread_mutex_unlock( &s->ecs_mutex );
+
+	if ( !n )
+		return MDB_NOTFOUND;
+
+	src = ECNODE_ENTRY( n );
+	x = op->o_tmpalloc( n->ecn_hdrsize, op->o_tmpmemctx );
+	AC_MEMCPY( x, src, n->ecn_hdrsize );
+
+	/* Point the copied arrays at each other; values stay shared */
+	d = (char *)x;
+	o = (char *)src;
+#define ECACHE_RELOC(p)	((void *)( d + ((char *)(p) - o) ))
+	if ( x->e_attrs ) {
+		x->e_attrs = ECACHE_RELOC( x->e_attrs );
+		for ( a = x->e_attrs; a; a = a->a_next ) {
+			a->a_vals = ECACHE_RELOC( a->a_vals );
+			a->a_nvals = ECACHE_RELOC( a->a_nvals );
+			if ( a->a_next )
+				a->a_next = ECACHE_RELOC( a->a_next );
+		}
+	}
+#undef ECACHE_RELOC
+	x->e_private = n;
+	*e = x;
+
+	return 0;
+}
+
+/*
+ * Add a copy of an entry just decoded with txn.
+ */
+void
+mdb_ecache_put( Operation *op, MDB_txn *txn, Entry *e )
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	unsigned long max = mdb->mi_ecache_max / MDB_ECACHE_SHARDS;
+	mdb_ecshard *s;
+	mdb_ecnode *n;
+	Entry *x;
+	Attribute *a, *b;
+	struct berval *bv;
+	char *ptr;
+	size_t txnid, hdrsize, size;
+	unsigned nattrs = 0, nvals = 0, i;
+	ber_len_t len = 0;
+
+	if ( !max || !ecache_reader( op, mdb, txn ))
+		return;
+
+	s = ECACHE_SHARD( mdb, e->e_id );
+	txnid = mdb_txn_id( txn );
+	/* unlocked peek, checked again below */
+	if ( txnid < s->ecs_modtxn )
+		return;
+
+	for ( a = e->e_attrs; a; a = a->a_next ) {
+		nattrs++;
+		nvals += a->a_numvals + 1;
+		for ( i = 0; i < a->a_numvals; i++ )
+			len += a->a_vals[i].bv_len + 1;
+		if ( a->a_nvals != a->a_vals ) {
+			nvals += a->a_numvals + 1;
+			for ( i = 0; i < a->a_numvals; i++ )
+				len += a->a_nvals[i].bv_len + 1;
+		}
+	}
+	hdrsize = sizeof(Entry) + nattrs * sizeof(Attribute) +
+		nvals * sizeof(struct berval);
+	size = sizeof(mdb_ecnode) + hdrsize + len;
+	if ( size > max )
+		return;
+
+	n = ch_malloc( size );
+	n->ecn_id = e->e_id;
+	n->ecn_size = size;
+	n->ecn_hdrsize = hdrsize;
+	n->ecn_refcnt = 0;
+	n->ecn_cached = 1;
+	n->ecn_shard = s;
+
+	x = ECNODE_ENTRY( n );
+	memset( x, 0, sizeof(Entry) );
+	x->e_id = e->e_id;
+	x->e_ocflags = e->e_ocflags;
+	b = (Attribute *)(x+1);
+	bv = (struct berval *)(b + nattrs);
+	ptr = (char *)(bv + nvals);
+	x->e_attrs = nattrs ? b : NULL;
+	for ( a = e->e_attrs; a; a = a->a_next, b++ ) {
+		*b = *a;
+		b->a_next = a->a_next ? b+1 : NULL;
+		b->a_vals = bv;
+		bv = ecache_copyvals( bv, &ptr, a->a_vals, a->a_numvals );
+		if ( a->a_nvals != a->a_vals ) {
+			b->a_nvals = bv;
+			bv = ecache_copyvals( bv, &ptr, a->a_nvals, a->a_numvals );
+		} else {
+			b->a_nvals = b->a_vals;
+		}
+	}
+
+	ldap_pvt_thread_mutex_lock( &s->ecs_mutex );
+	if ( txnid >= s->ecs_modtxn ) {
+		n->ecn_txnid = s->ecs_modtxn;
+		if ( ldap_avl_insert( &s->ecs_tree, n, ecnode_cmp,
+			ldap_avl_dup_error ) == 0 ) {
+			ecache_lru_add( s, n );
+			s->ecs_size += size;
+			s->ecs_count++;
+			ecache_trim( s, max );
+			n = NULL;
+		}
+	}
+	ldap_pvt_thread_mutex_unlock( &s->ecs_mutex );
+
+	if ( n )
+		ch_free( n );
+}
+
+/* Give back a copy obtained from mdb_ecache_get() */
+void
+mdb_ecache_release( Entry *e )
+{
+	mdb_ecnode *n = e->e_private;
+	mdb_ecshard *s = n->ecn_shard;
+	int dead;
+
+	ldap_pvt_thread_mutex_lock( &s->ecs_mutex );
+	dead = !--n->ecn_refcnt && !n->ecn_cached;
+	ldap_pvt_thread_mutex_unlock( &s->ecs_mutex );
+
+	if ( dead )
+		ch_free( n );
+}
+
+/*
+ * Called by writers for every entry they change, from within the
+ * write txn.
+ */
+void
+mdb_ecache_invalidate( struct mdb_info *mdb, MDB_txn *txn, ID id )
+{
+	mdb_ecshard *s;
+	mdb_ecnode *n, key;
+	size_t txnid;
+
+	if ( !mdb->mi_ecache )
+		return;
+
+	s = ECACHE_SHARD( mdb, id );
+	key.ecn_id = id;
+	txnid = mdb_txn_id( txn );
+
+	ldap_pvt_thread_mutex_lock( &s->ecs_mutex );
+	if ( txnid > s->ecs_modtxn )
+		s->ecs_modtxn = txnid;
+	n = ldap_avl_find( s->ecs_tree, &key, ecnode_cmp );
+	if ( n )
+		ecache_unlink( s, n );
+	ldap_pvt_thread_mutex_unlock( &s->ecs_mutex );
+}
+
+void
+mdb_ecache_stats( struct mdb_info *mdb, unsigned long *hits,
+	unsigned long *misses, unsigned long *count, unsigned long *size )
+{
+	int i;
+
+	*hits = *misses = *count = *size = 0;
+	if ( !mdb->mi_ecache )
+		return;
+
+	for ( i = 0; i < MDB_ECACHE_SHARDS; i++ ) {
+		mdb_ecshard *s = &mdb->mi_ecache->ec_shards[i];
+
+		ldap_pvt_thread_mutex_lock( &s->ecs_mutex );
+		*hits += s->ecs_hits;
+		*misses += s->ecs_misses;
+		*count += s->ecs_count;
+		*size += s->ecs_size;
+		ldap_pvt_thread_mutex_unlock( &s->ecs_mutex );
+	}
+}
@@ -68,16 +68,40 @@ static ConfigTable mdbcfg[] = {
 			"DESC 'Disable synchronous database writes' "
 			"EQUALITY booleanMatch "
 			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "entrycachesize", "size", 2, 2, 0, ARG_ULONG|ARG_OFFSET,
+		(void *)offsetof(struct mdb_info, mi_ecache_max),
+		"( OLcfgDbAt:12.8 NAME 'olcDbEntryCacheSize' "
+		"DESC 'Maximum size of the decoded entry cache in bytes' "
+		"EQUALITY integerMatch "
+		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "envflags", "flags", 2, 0, 0, ARG_MAGIC|MDB_ENVFLAGS,
 		mdb_cf_gen, "( OLcfgDbAt:12.3 NAME 'olcDbEnvFlags' "
 			"DESC 'Database environment flags' "
 			"EQUALITY caseIgnoreMatch "
 			"SYNTAX OMsDirectoryString )", NULL, NULL },
+	{ "groupcommit", "ops", 2, 2, 0, ARG_UINT|ARG_OFFSET,
+		(void *)offsetof(struct mdb_info, mi_gc_max),
+		"( OLcfgDbAt:12.11 NAME 'olcDbGroupCommit' "
+		"DESC 'Maximum number of write operations committed together' "
+		"EQUALITY integerMatch "
+		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "idlcompress", "on|off", 2, 2, 0, ARG_ON_OFF|ARG_OFFSET,
+		(void *)offsetof(struct mdb_info, mi_idlcompress),
+		"( OLcfgDbAt:12.7 NAME 'olcDbIdlCompress' "
+		"DESC 'Store new index databases as packed IDL blocks' "
+		"EQUALITY booleanMatch "
+		"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
 	{ "index", "attr> <[pres,eq,approx,sub]", 2, 3, 0, ARG_MAGIC|MDB_INDEX,
 		mdb_cf_gen, "( OLcfgDbAt:0.2 NAME 'olcDbIndex' "
 		"DESC 'Attribute index parameters' "
 		"EQUALITY caseIgnoreMatch "
 		"SYNTAX OMsDirectoryString )", NULL, NULL },
+	{ "indexrate", "entries", 2, 2, 0, ARG_UINT|ARG_OFFSET,
+		(void *)offsetof(struct mdb_info, mi_index_rate),
+		"( OLcfgDbAt:12.10 NAME 'olcDbIndexRate' "
+		"DESC 'Maximum number of entries per second for online indexing' "
+		"EQUALITY integerMatch "
+		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "maxentrysize", "size", 2, 2, 0, ARG_ULONG|ARG_OFFSET,
 		(void *)offsetof(struct mdb_info, mi_maxentrysize),
 		"( OLcfgDbAt:12.4 NAME 'olcDbMaxEntrySize' "
@@ -112,6 +136,12 @@ static ConfigTable mdbcfg[] = {
 		"EQUALITY integerMatch "
 		"SYNTAX OMsInteger SINGLE-VALUE )", NULL,
 		{ .v_uint = DEFAULT_RTXN_SIZE } },
+	{ "scanthreads", "num", 2, 2, 0, ARG_UINT|ARG_OFFSET,
+		(void *)offsetof(struct mdb_info, mi_scan_threads),
+		"( OLcfgDbAt:12.9 NAME 'olcDbScanThreads' "
+		"DESC 'Number of pool threads used to filter large candidate lists' "
+		"EQUALITY integerMatch "
+		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "searchstack", "depth", 2, 2, 0, ARG_INT|ARG_MAGIC|MDB_SSTACK,
 		mdb_cf_gen, "( OLcfgDbAt:1.9 NAME 'olcDbSearchStack' "
 		"DESC 'Depth of search stack in IDLs' "
@@ -138,7 +168,8 @@ static ConfigOCs mdbocs[] = {
 		"MAY ( olcDbCheckpoint $ olcDbEnvFlags $ "
 		"olcDbNoSync $ olcDbIndex $ olcDbMaxReaders $ olcDbMaxSize $ "
 		"olcDbMode $ olcDbSearchStack $ olcDbMaxEntrySize $ olcDbRtxnSize $ "
-		"olcDbMultival ) )",
+		"olcDbMultival $ olcDbIdlCompress $ olcDbEntryCacheSize $ olcDbScanThreads $ olcDbIndexRate $ "
+		"olcDbGroupCommit ) )",
 			Cft_Database, mdbcfg+1 },
 	{ NULL, 0, NULL }
 };
@@ -193,6 +224,12 @@ mdb_checkpoint( void *ctx, void *arg )
 	return NULL;
 }
 
+/* Number of entries the online indexer handles per write txn.
+ * Each txn holds the write lock, so keep it short enough that
+ * concurrent updates are not held up noticeably.
+ */
+#define MDB_ONLINE_INDEX_BATCH	32
+
 /* reindex entries on the fly */
 static void *
 mdb_online_index( void *ctx, void *arg )
@@ -206,13 +243,15 @@ mdb_online_index( void *ctx, void *arg )
 	Operation *op;
 
 	MDB_cursor *curs;
-	MDB_val key, data;
+	MDB_val key, data, k0;
 	MDB_txn *txn;
 	ID id;
 	Entry *e;
-	int rc, getnext = 1;
-	int i, first = 1;
-	int intr = 0;
+	unsigned short s = 0;
+	unsigned long n = 0;
+	int rc, i, first = 1;
+	int intr = 0, eod = 0;
+	time_t delay = 0;
 
 	connection_fake_init( &conn, &opbuf, ctx );
 	op = &opbuf.ob_op;
@@ -220,6 +259,8 @@ mdb_online_index( void *ctx, void *arg )
 	op->o_bd = be;
 
 	key.mv_size = sizeof(ID);
+	k0.mv_size = sizeof(s);
+	k0.mv_data = &s;
 
 	while ( 1 ) {
 		rc = mdb_txn_begin( mdb->mi_dbenv, NULL, 0, &txn );
@@ -228,32 +269,46 @@ mdb_online_index( void *ctx, void *arg )
 
 		/* pick up where we left off */
 		if ( first ) {
-			MDB_val k0;
-			unsigned short s = 0;
-
 			first = 0;
-			k0.mv_size = sizeof(s);
-			k0.mv_data = &s;
 			rc = mdb_get( txn, mdb->mi_idxckp, &k0, &data );
 			if ( rc ) {
 				mdb_txn_abort( txn );
+				/* no checkpoint, nothing to index */
+				if ( rc == MDB_NOTFOUND )
+					eod = 1;
 				break;
 			}
 			memcpy( &id, data.mv_data, sizeof( id ));
+
+			if ( !mdb->mi_ixb_active ) {
+				mdb->mi_ixb_last = 0;
+				rc = mdb_cursor_open( txn, mdb->mi_id2entry, &curs );
+				if ( rc == 0 ) {
+					if ( mdb_cursor_get( curs, &key, &data, MDB_LAST ) == 0 )
+						memcpy( &mdb->mi_ixb_last, key.mv_data, sizeof( ID ));
+					mdb_cursor_close( curs );
+				}
+				mdb->mi_ixb_start = id;
+				mdb->mi_ixb_pos = id;
+				mdb->mi_ixb_count = 0;
+				mdb->mi_ixb_time = slap_get_time();
+				mdb->mi_ixb_active = 1;
+			}
 		}
 
-		/* Save our stopping point */
+		/* The checkpoint DB already has our stopping point, so on a
+		 * pause or once this second's budget is used up just quit
+		 * and get rescheduled.
+		 */
 		if ( slapd_shutdown || ldap_pvt_thread_pool_pausequery( &connection_pool )) {
-			MDB_val k0;
-			unsigned short s = 0;
-
-			k0.mv_size = sizeof(s);
-			k0.mv_data = &s;
-			data.mv_data = &id;
-			data.mv_size = sizeof( id );
-			mdb_put( txn, mdb->mi_idxckp, &k0, &data, 0 );
-			mdb_txn_commit( txn );
+			mdb_txn_abort( txn );
+			intr = 1;
+			break;
+		}
+		if ( mdb->mi_index_rate && n >= mdb->mi_index_rate ) {
+			mdb_txn_abort( txn );
 			intr = 1;
+			delay = 1;
 			break;
 		}
 
@@ -262,52 +317,69 @@ mdb_online_index( void *ctx, void *arg )
 			mdb_txn_abort( txn );
 			break;
 		}
-		if ( getnext ) {
-			getnext = 0;
+		mdb_cursor_readahead( curs, MDB_READAHEAD );
+		for ( i = 0; i < MDB_ONLINE_INDEX_BATCH; i++ ) {
 			key.mv_data = &id;
 			rc = mdb_cursor_get( curs, &key, &data, MDB_SET_RANGE );
 			if ( rc ) {
-				mdb_txn_abort( txn );
-				if ( rc == MDB_NOTFOUND )
+				if ( rc == MDB_NOTFOUND ) {
+					eod = 1;
 					rc = 0;
+				}
 				break;
 			}
 			memcpy( &id, key.mv_data, sizeof( id ));
-		}
 
-		rc = mdb_id2entry( op, curs, id, &e );
-		mdb_cursor_close( curs );
-		if ( rc ) {
-			mdb_txn_abort( txn );
-			if ( rc == MDB_NOTFOUND ) {
-				id++;
-				getnext = 1;
-				continue;
+			rc = mdb_id2entry( op, curs, id, &e );
+			if ( rc ) {
+				if ( rc == MDB_NOTFOUND ) {
+					id++;
+					rc = 0;
+					continue;
+				}
+				break;
 			}
-			break;
+			rc = mdb_index_entry( op, txn, MDB_INDEX_UPDATE_OP, e );
+			mdb_entry_return( op, e );
+			if ( rc )
+				break;
+			id++;
+		}
+		mdb_cursor_close( curs );
+
+		/* record our position along with the index updates */
+		if ( rc == 0 ) {
+			data.mv_data = &id;
+			data.mv_size = sizeof( id );
+			rc = mdb_put( txn, mdb->mi_idxckp, &k0, &data, 0 );
 		}
-		rc = mdb_index_entry( op, txn, MDB_INDEX_UPDATE_OP, e );
-		mdb_entry_return( op, e );
 		if ( rc == 0 ) {
 			rc = mdb_txn_commit( txn );
-			txn = NULL;
 		} else {
 			mdb_txn_abort( txn );
-			txn = NULL;
 		}
+		txn = NULL;
 		if ( rc ) {
 			Debug( LDAP_DEBUG_ANY,
 				LDAP_XSTRING(mdb_online_index) ": database %s: "
-				"txn_commit failed: %s (%d)\n",
-				be->be_suffix[0].bv_val, mdb_strerror(rc), rc );
+				"indexing failed at entry %ld: %s (%d)\n",
+				be->be_suffix[0].bv_val, (long) id, mdb_strerror(rc), rc );
+			/* the last batch was rolled back, so the new masks must
+			 * not be switched on: searches keep the old index and the
+			 * checkpoint is kept so the build resumes on restart
+			 */
+			eod = 0;
 			break;
 		}
-		id++;
-		getnext = 1;
+		n += i;
+		mdb->mi_ixb_count += i;
+		mdb->mi_ixb_pos = id;
+		if ( eod )
+			break;
 	}
 
 	/* all done */
-	if ( !intr ) {
+	if ( eod ) {
 		for ( i = 0; i < mdb->mi_nattrs; i++ ) {
 			if ( mdb->mi_attrs[ i ]->ai_indexmask & MDB_INDEX_DELETING
 				|| mdb->mi_attrs[ i ]->ai_newmask == 0 )
@@ -323,15 +395,26 @@ mdb_online_index( void *ctx, void *arg )
 			mdb_drop( txn, mdb->mi_idxckp, 0 );
 			mdb_txn_commit( txn );
 		}
+		if ( mdb->mi_ixb_active ) {
+			Debug( LDAP_DEBUG_STATS,
+				LDAP_XSTRING(mdb_online_index) ": database %s: "
+				"indexed %lu entries in %ld seconds\n",
+				be->be_suffix[0].bv_val, mdb->mi_ixb_count,
+				(long)( slap_get_time() - mdb->mi_ixb_time ));
+		}
 	}
+	if ( !intr )
+		mdb->mi_ixb_active = 0;
 
 	ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
 	if ( ldap_pvt_runqueue_isrunning( &slapd_rq, rtask ))
 		ldap_pvt_runqueue_stoptask( &slapd_rq, rtask );
 	if ( intr && !slapd_shutdown ) {
-		/* on pause, resched to run again immediately */
+		/* on pause, resched to run again immediately,
+		 * when throttled, after a second
+		 */
 		time_t t = rtask->interval.tv_sec;
-		rtask->interval.tv_sec = 0;
+		rtask->interval.tv_sec = delay;
 		ldap_pvt_runqueue_resched( &slapd_rq, rtask, 0 );
 		rtask->interval.tv_sec = t;
 	} else if ( mdb->mi_index_task ) {
@@ -385,6 +468,7 @@ mdb_setup_indexer( struct mdb_info *mdb )
 	/* set indexer task to start at first entry */
 	if ( changed ) {
 		ID id = 0;
+		mdb->mi_ixb_active = 0;
 		s = 0;			/* key 0 records next entryID to index */
 		data.mv_size = sizeof( ID );
 		data.mv_data = &id;
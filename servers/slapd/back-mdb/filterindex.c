@@ -57,6 +57,26 @@ static int substring_candidates(
 	ID *ids,
 	ID *tmp );
 
+/* Index keys computed while estimating a filter term, kept so that
+ * fetching the term's candidates does not compute them again
+ */
+typedef struct filter_keys {
+	struct filter_keys *fk_next;
+	Filter *fk_f;
+	MDB_dbi fk_dbi;
+	struct berval *fk_keys;
+	ID fk_est;
+} filter_keys;
+
+static int filter_candidates(
+	Operation *op,
+	MDB_txn *rtxn,
+	Filter *f,
+	ID *ids,
+	ID *tmp,
+	ID *stack,
+	filter_keys **cache );
+
 static int list_candidates(
 	Operation *op,
 	MDB_txn *rtxn,
@@ -64,7 +84,24 @@ static int list_candidates(
 	int ftype,
 	ID *ids,
 	ID *tmp,
-	ID *stack );
+	ID *stack,
+	filter_keys **cache );
+
+static int and_candidates(
+	Operation *op,
+	MDB_txn *rtxn,
+	Filter *flist,
+	ID *ids,
+	ID *tmp,
+	ID *stack,
+	filter_keys **cache );
+
+static int keys_candidates(
+	Operation *op,
+	MDB_txn *rtxn,
+	filter_keys *fk,
+	ID *ids,
+	ID *tmp );
 
 static int
 ext_candidates(
@@ -105,8 +142,22 @@ mdb_filter_candidates(
 	ID *ids,
 	ID *tmp,
 	ID *stack )
+{
+	return filter_candidates( op, rtxn, f, ids, tmp, stack, NULL );
+}
+
+static int
+filter_candidates(
+	Operation *op,
+	MDB_txn *rtxn,
+	Filter	*f,
+	ID *ids,
+	ID *tmp,
+	ID *stack,
+	filter_keys **cache )
 {
 	int rc = 0;
+	filter_keys *fk;
 #ifdef LDAP_COMP_MATCH
 	AttributeAliasing *aa;
 #endif
@@ -117,7 +168,15 @@ mdb_filter_candidates(
 		goto out;
 	}
 
-	switch ( f->f_choice ) {
+	/* reuse the keys of a term that has already been estimated */
+	for ( fk = cache ? *cache : NULL; fk; fk = fk->fk_next ) {
+		if ( fk->fk_f == f )
+			break;
+	}
+
+	if ( fk ) {
+		rc = keys_candidates( op, rtxn, fk, ids, tmp );
+	} else switch ( f->f_choice ) {
 	case SLAPD_FILTER_COMPUTED:
 		switch( f->f_result ) {
 		case SLAPD_COMPARE_UNDEFINED:
@@ -192,14 +251,14 @@ mdb_filter_candidates(
 
 	case LDAP_FILTER_AND:
 		Debug( LDAP_DEBUG_FILTER, "\tAND\n" );
-		rc = list_candidates( op, rtxn, 
-			f->f_and, LDAP_FILTER_AND, ids, tmp, stack );
+		rc = and_candidates( op, rtxn,
+			f->f_and, ids, tmp, stack, cache );
 		break;
 
 	case LDAP_FILTER_OR:
 		Debug( LDAP_DEBUG_FILTER, "\tOR\n" );
 		rc = list_candidates( op, rtxn,
-			f->f_or, LDAP_FILTER_OR, ids, tmp, stack );
+			f->f_or, LDAP_FILTER_OR, ids, tmp, stack, cache );
 		break;
 	case LDAP_FILTER_EXT:
                 Debug( LDAP_DEBUG_FILTER, "\tEXT\n" );
@@ -558,6 +617,324 @@ base:
 	return 0;
 }
 
+/* Estimated candidate counts for terms that have no cheap count */
+#define FILTER_EST_ALL	NOID		/* does not narrow the candidates */
+#define FILTER_EST_UNKNOWN	(NOID-1)	/* indexed, cost unknown */
+
+/* Once an AND has narrowed its candidates to a list, a remaining term
+ * is left to test_filter() if its IDL is expected to be more than
+ * FILTER_SKIP_RATIO times longer than the list, or if its size is
+ * unknown and the list has at most FILTER_FEW_CANDIDATES IDs.
+ * Terms are never skipped when a size.unchecked limit applies, since
+ * the limit is checked against the number of candidates.
+ */
+#define FILTER_SKIP_RATIO	32
+#define FILTER_FEW_CANDIDATES	16
+
+static ID
+keys_estimate(
+	Operation *op,
+	MDB_txn *rtxn,
+	Filter *f,
+	AttributeDescription *desc,
+	int ftype,
+	MatchingRule *mr,
+	void *assertion,
+	filter_keys **cache )
+{
+	MDB_dbi dbi;
+	slap_mask_t mask;
+	struct berval prefix = {0, NULL};
+	struct berval *keys = NULL;
+	filter_keys *fk;
+	ID est = FILTER_EST_ALL, count;
+	int i, rc;
+
+	for ( fk = *cache; fk; fk = fk->fk_next ) {
+		if ( fk->fk_f == f )
+			return fk->fk_est;
+	}
+
+	rc = mdb_index_param( op->o_bd, desc, ftype, &dbi, &mask, &prefix );
+	if ( rc != LDAP_SUCCESS || !mr || !mr->smr_filter )
+		return FILTER_EST_ALL;
+
+	rc = (mr->smr_filter)( ftype, mask, desc->ad_type->sat_syntax,
+		mr, &prefix, assertion, &keys, op->o_tmpmemctx );
+	if ( rc != LDAP_SUCCESS || keys == NULL )
+		return FILTER_EST_ALL;
+
+	/* The candidates are the intersection of all the keys' IDLs */
+	for ( i = 0; keys[i].bv_val != NULL; i++ ) {
+		if ( mdb_key_count( op->o_bd, rtxn, dbi, &keys[i], &count )) {
+			est = FILTER_EST_UNKNOWN;
+			break;
+		}
+		if ( count < est )
+			est = count;
+		if ( !est )
+			break;
+	}
+
+	fk = op->o_tmpalloc( sizeof(filter_keys), op->o_tmpmemctx );
+	fk->fk_f = f;
+	fk->fk_dbi = dbi;
+	fk->fk_keys = keys;
+	fk->fk_est = est;
+	fk->fk_next = *cache;
+	*cache = fk;
+
+	return est;
+}
+
+static void
+filter_keys_free( Operation *op, filter_keys *fk )
+{
+	filter_keys *next;
+
+	for ( ; fk; fk = next ) {
+		next = fk->fk_next;
+		ber_bvarray_free_x( fk->fk_keys, op->o_tmpmemctx );
+		op->o_tmpfree( fk, op->o_tmpmemctx );
+	}
+}
+
+/* Intersect the IDLs of the keys of an estimated term */
+static int
+keys_candidates(
+	Operation *op,
+	MDB_txn *rtxn,
+	filter_keys *fk,
+	ID *ids,
+	ID *tmp )
+{
+	int i, rc = 0;
+
+	MDB_IDL_ALL( ids );
+
+	for ( i = 0; fk->fk_keys[i].bv_val != NULL; i++ ) {
+		rc = mdb_key_read( op->o_bd, rtxn, fk->fk_dbi, &fk->fk_keys[i],
+			tmp, NULL, 0 );
+
+		if ( rc == MDB_NOTFOUND ) {
+			MDB_IDL_ZERO( ids );
+			rc = 0;
+			break;
+		} else if ( rc != LDAP_SUCCESS ) {
+			Debug( LDAP_DEBUG_TRACE,
+				"<= mdb_keys_candidates: key read failed (%d)\n", rc );
+			break;
+		}
+
+		if ( MDB_IDL_IS_ZERO( tmp ) ) {
+			MDB_IDL_ZERO( ids );
+			break;
+		}
+
+		if ( i == 0 ) {
+			MDB_IDL_CPY( ids, tmp );
+		} else {
+			mdb_idl_intersection( ids, tmp );
+		}
+
+		if ( MDB_IDL_IS_ZERO( ids ) )
+			break;
+	}
+
+	return rc;
+}
+
+/*
+ * Cheaply estimate how many candidates mdb_filter_candidates() would
+ * return for a filter, by counting the index keys it would read.
+ */
+static ID
+filter_estimate(
+	Operation *op,
+	MDB_txn *rtxn,
+	Filter *f,
+	filter_keys **cache )
+{
+	AttributeDescription *ad;
+	MatchingRule *mr;
+	Filter *f2;
+	ID est, sub;
+
+	if ( f->f_choice & SLAPD_FILTER_UNDEFINED )
+		return 0;
+
+	switch ( f->f_choice ) {
+	case SLAPD_FILTER_COMPUTED:
+		if ( f->f_result == LDAP_COMPARE_FALSE ||
+			f->f_result == SLAPD_COMPARE_UNDEFINED )
+			return 0;
+		return FILTER_EST_ALL;
+
+	case LDAP_FILTER_PRESENT: {
+		MDB_dbi dbi;
+		slap_mask_t mask;
+		struct berval prefix = {0, NULL};
+
+		if ( f->f_desc == slap_schema.si_ad_objectClass ||
+			mdb_index_param( op->o_bd, f->f_desc, LDAP_FILTER_PRESENT,
+				&dbi, &mask, &prefix ) != LDAP_SUCCESS )
+			return FILTER_EST_ALL;
+		if ( prefix.bv_val == NULL ||
+			mdb_key_count( op->o_bd, rtxn, dbi, &prefix, &est ))
+			return FILTER_EST_UNKNOWN;
+		return est;
+		}
+
+	case LDAP_FILTER_EQUALITY:
+		ad = f->f_av_desc;
+#ifdef LDAP_COMP_MATCH
+		if ( is_aliased_attribute && is_aliased_attribute( ad ) )
+			return FILTER_EST_UNKNOWN;
+#endif
+		if ( ad == slap_schema.si_ad_entryDN )
+			return 1;
+		return keys_estimate( op, rtxn, f, ad, LDAP_FILTER_EQUALITY,
+			ad->ad_type->sat_equality, &f->f_av_value, cache );
+
+	case LDAP_FILTER_APPROX:
+		ad = f->f_av_desc;
+		mr = ad->ad_type->sat_approx;
+		if ( !mr )
+			mr = ad->ad_type->sat_equality;
+		return keys_estimate( op, rtxn, f, ad, LDAP_FILTER_APPROX,
+			mr, &f->f_av_value, cache );
+
+	case LDAP_FILTER_SUBSTRINGS:
+		ad = f->f_sub_desc;
+		return keys_estimate( op, rtxn, f, ad, LDAP_FILTER_SUBSTRINGS,
+			ad->ad_type->sat_substr, f->f_sub, cache );
+
+	case LDAP_FILTER_AND:
+		est = FILTER_EST_ALL;
+		for ( f2 = f->f_and; f2; f2 = f2->f_next ) {
+			sub = filter_estimate( op, rtxn, f2, cache );
+			if ( sub < est )
+				est = sub;
+		}
+		return est;
+
+	case LDAP_FILTER_OR:
+		est = 0;
+		for ( f2 = f->f_or; f2; f2 = f2->f_next ) {
+			sub = filter_estimate( op, rtxn, f2, cache );
+			if ( sub >= FILTER_EST_UNKNOWN )
+				return sub;
+			est += sub;
+			if ( est >= FILTER_EST_UNKNOWN )
+				return FILTER_EST_UNKNOWN;
+		}
+		return est;
+
+	case LDAP_FILTER_GE:
+	case LDAP_FILTER_LE:
+	case LDAP_FILTER_EXT:
+		return FILTER_EST_UNKNOWN;
+
+	default:
+		/* NOT, and anything else that returns all IDs */
+		return FILTER_EST_ALL;
+	}
+}
+
+/*
+ * Evaluate the terms of an AND filter from the most to the least
+ * selective, and stop fetching IDLs once the remaining terms would
+ * cost more to read than to test against the candidates.
+ */
+static int
+and_candidates(
+	Operation *op,
+	MDB_txn *rtxn,
+	Filter	*flist,
+	ID *ids,
+	ID *tmp,
+	ID *save,
+	filter_keys **cache )
+{
+	struct filter_cost {
+		Filter *f;
+		ID est;
+	} *fc;
+	Filter	*f;
+	filter_keys *own = NULL;
+	ID est;
+	int i, j, n = 0, rc = 0, have_ids = 0, noskip;
+
+	Debug( LDAP_DEBUG_FILTER, "=> mdb_and_candidates\n" );
+
+	if ( !cache )
+		cache = &own;
+	noskip = op->ors_limit && op->ors_limit->lms_s_unchecked != -1;
+
+	for ( f = flist; f != NULL; f = f->f_next )
+		n++;
+	fc = op->o_tmpalloc( n * sizeof(struct filter_cost), op->o_tmpmemctx );
+
+	/* Sort by estimate, keeping the filter order among equals */
+	n = 0;
+	for ( f = flist; f != NULL; f = f->f_next ) {
+		/* ignore precomputed scopes */
+		if ( f->f_choice == SLAPD_FILTER_COMPUTED &&
+		     f->f_result == LDAP_SUCCESS ) {
+			continue;
+		}
+		est = filter_estimate( op, rtxn, f, cache );
+		for ( j = n++; j > 0 && fc[j-1].est > est; j-- )
+			fc[j] = fc[j-1];
+		fc[j].f = f;
+		fc[j].est = est;
+	}
+
+	for ( i = 0; i < n; i++ ) {
+		f = fc[i].f;
+		est = fc[i].est;
+
+		if ( have_ids && !noskip && !MDB_IDL_IS_RANGE( ids ) &&
+			( est == FILTER_EST_UNKNOWN ? ids[0] <= FILTER_FEW_CANDIDATES :
+				est / FILTER_SKIP_RATIO > ids[0] )) {
+			Debug( LDAP_DEBUG_FILTER,
+				"<= mdb_and_candidates: leaving term %d (est=%ld) "
+				"to filter test\n", i, (long) est );
+			continue;
+		}
+
+		MDB_IDL_ZERO( save );
+		rc = filter_candidates( op, rtxn, f, save, tmp,
+			save+MDB_idl_um_size, cache );
+
+		if ( rc != 0 ) {
+			rc = 0;
+			continue;
+		}
+
+		if ( !have_ids ) {
+			MDB_IDL_CPY( ids, save );
+			have_ids = 1;
+		} else {
+			mdb_idl_intersection( ids, save );
+		}
+		if( MDB_IDL_IS_ZERO( ids ) )
+			break;
+	}
+
+	op->o_tmpfree( fc, op->o_tmpmemctx );
+	if ( cache == &own )
+		filter_keys_free( op, own );
+
+	Debug( LDAP_DEBUG_FILTER,
+		"<= mdb_and_candidates: id=%ld first=%ld last=%ld\n",
+		(long) ids[0],
+		(long) MDB_IDL_FIRST(ids),
+		(long) MDB_IDL_LAST(ids) );
+
+	return rc;
+}
+
 static int
 list_candidates(
 	Operation *op,
@@ -566,12 +943,16 @@ list_candidates(
 	int		ftype,
 	ID *ids,
 	ID *tmp,
-	ID *save )
+	ID *save,
+	filter_keys **cache )
 {
 	int rc = 0;
 	Filter	*f;
+	filter_keys *own = NULL;
 
 	Debug( LDAP_DEBUG_FILTER, "=> mdb_list_candidates 0x%x\n", ftype );
+	if ( !cache )
+		cache = &own;
 	for ( f = flist; f != NULL; f = f->f_next ) {
 		/* ignore precomputed scopes */
 		if ( f->f_choice == SLAPD_FILTER_COMPUTED &&
@@ -579,34 +960,22 @@ list_candidates(
 			continue;
 		}
 		MDB_IDL_ZERO( save );
-		rc = mdb_filter_candidates( op, rtxn, f, save, tmp,
-			save+MDB_idl_um_size );
+		rc = filter_candidates( op, rtxn, f, save, tmp,
+			save+MDB_idl_um_size, cache );
 
 		if ( rc != 0 ) {
-			if ( ftype == LDAP_FILTER_AND ) {
-				rc = 0;
-				continue;
-			}
 			break;
 		}
 
-		
-		if ( ftype == LDAP_FILTER_AND ) {
-			if ( f == flist ) {
-				MDB_IDL_CPY( ids, save );
-			} else {
-				mdb_idl_intersection( ids, save );
-			}
-			if( MDB_IDL_IS_ZERO( ids ) )
-				break;
+		/* AND lists are handled by and_candidates() */
+		if ( f == flist ) {
+			MDB_IDL_CPY( ids, save );
 		} else {
-			if ( f == flist ) {
-				MDB_IDL_CPY( ids, save );
-			} else {
-				mdb_idl_union( ids, save );
-			}
+			mdb_idl_union( ids, save );
 		}
 	}
+	if ( cache == &own )
+		filter_keys_free( op, own );
 
 	if( rc == LDAP_SUCCESS ) {
 		Debug( LDAP_DEBUG_FILTER,
@@ -118,6 +118,7 @@ int mdb_mval_put(Operation *op, MDB_cursor *mc, ID id, Attribute *a)
 	memcpy(ivk, &id, sizeof(id));
 	s = mdb->mi_adxs[a->a_desc->ad_index];
 	memcpy(ivk+sizeof(ID), &s, 2);
+	mdb_ecache_invalidate( mdb, mdb_cursor_txn( mc ), id );
 	key.mv_data = &ivk;
 	key.mv_size = sizeof(ivk);
 	if ((a->a_desc->ad_type->sat_flags & SLAP_AT_ORDERED) || a->a_desc == slap_schema.si_ad_objectClass)
@@ -172,6 +173,7 @@ int mdb_mval_del(Operation *op, MDB_cursor *mc, ID id, Attribute *a)
 	memcpy(ivk, &id, sizeof(id));
 	s = mdb->mi_adxs[a->a_desc->ad_index];
 	memcpy(ivk+sizeof(ID), &s, 2);
+	mdb_ecache_invalidate( mdb, mdb_cursor_txn( mc ), id );
 	key.mv_data = &ivk;
 	key.mv_size = sizeof(ivk);
 	if ((a->a_desc->ad_type->sat_flags & SLAP_AT_ORDERED) || a->a_desc == slap_schema.si_ad_objectClass)
@@ -295,6 +297,8 @@ static int mdb_id2entry_put(
 		goto fail;
 	}
 
+	mdb_ecache_invalidate( mdb, txn, e->e_id );
+
 again:
 	data.mv_size = ec.dlen;
 	if ( mc )
@@ -404,6 +408,9 @@ int mdb_id2entry(
 
 	*e = NULL;
 
+	if ( mdb_ecache_get( op, mdb_cursor_txn( mc ), id, e ) == 0 )
+		return MDB_SUCCESS;
+
 	key.mv_data = &id;
 	key.mv_size = sizeof(ID);
 
@@ -452,6 +459,7 @@ int mdb_id2entry(
 	(*e)->e_id = id;
 	(*e)->e_name.bv_val = NULL;
 	(*e)->e_nname.bv_val = NULL;
+	mdb_ecache_put( op, mdb_cursor_txn( mc ), *e );
 
 	return rc;
 }
@@ -473,6 +481,8 @@ int mdb_id2entry_delete(
 	key.mv_data = kbuf;
 	key.mv_size = sizeof(kbuf);
 
+	mdb_ecache_invalidate( mdb, tid, e->e_id );
+
 	/* delete from database */
 	rc = mdb_del( tid, dbi, &key, NULL );
 	if (rc)
@@ -530,6 +540,8 @@ int mdb_entry_return(
 	if ( !e )
 		return 0;
 	if ( e->e_private ) {
+		if ( e->e_private != e )
+			mdb_ecache_release( e );
 		if ( op->o_hdr && op->o_tmpmfuncs ) {
 			op->o_tmpfree( e->e_nname.bv_val, op->o_tmpmemctx );
 			op->o_tmpfree( e->e_name.bv_val, op->o_tmpmemctx );
@@ -688,6 +700,161 @@ mdb_reader_flush( MDB_env *env )
 
 extern MDB_txn *mdb_tool_txn;
 
+/*
+ * Group commit. Every write txn ends with a sync, so with a single
+ * writer the update rate is bounded by the sync rate. When groupcommit
+ * is set, the first writer to arrive (the leader) begins a top-level
+ * txn and each write op, the leader's included, runs in a nested txn
+ * of it, so a failing op only rolls back its own changes. LMDB's
+ * writer lock belongs to the thread that took it, so only the leader
+ * can end the batch: once its own op is done it lets in the writers
+ * already waiting, up to mi_gc_max ops in all, then commits them with
+ * a single sync. The members wait for that commit before they return.
+ */
+struct mdb_gcbatch {
+	MDB_txn	*gb_txn;	/* the shared top-level txn */
+	int	gb_members;	/* ops that joined the batch */
+	int	gb_commits;	/* nested txns committed into gb_txn */
+	int	gb_refs;
+	int	gb_done;
+	int	gb_rc;
+	int	gb_numads;	/* mi_numads when the batch began */
+};
+
+static int
+mdb_gc_begin( struct mdb_info *mdb, mdb_op_info *moi, int flag )
+{
+	struct mdb_gcbatch *gb;
+	int rc;
+
+	ldap_pvt_thread_mutex_lock( &mdb->mi_gc_mutex );
+	mdb->mi_gc_waiters++;
+	while ( mdb->mi_gc_busy || ( mdb->mi_gc_batch &&
+		mdb->mi_gc_batch->gb_members >= mdb->mi_gc_max ))
+		ldap_pvt_thread_cond_wait( &mdb->mi_gc_cond, &mdb->mi_gc_mutex );
+	mdb->mi_gc_waiters--;
+	mdb->mi_gc_busy = 1;
+
+	gb = mdb->mi_gc_batch;
+	if ( !gb ) {
+		MDB_txn *txn;
+
+		/* the previous batch is committed, but a writer outside
+		 * of group commit may still hold the writer lock
+		 */
+		ldap_pvt_thread_mutex_unlock( &mdb->mi_gc_mutex );
+		rc = mdb_txn_begin( mdb->mi_dbenv, NULL, flag, &txn );
+		ldap_pvt_thread_mutex_lock( &mdb->mi_gc_mutex );
+		if ( rc )
+			goto fail;
+		gb = ch_calloc( 1, sizeof( struct mdb_gcbatch ));
+		gb->gb_txn = txn;
+		gb->gb_numads = mdb->mi_numads;
+		mdb->mi_gc_batch = gb;
+		moi->moi_flag |= MOI_GCLEADER;
+	}
+
+	rc = mdb_txn_begin( mdb->mi_dbenv, gb->gb_txn, 0, &moi->moi_txn );
+	if ( rc ) {
+		if ( moi->moi_flag & MOI_GCLEADER ) {
+			mdb->mi_gc_batch = NULL;
+			mdb_txn_abort( gb->gb_txn );
+			ch_free( gb );
+			moi->moi_flag ^= MOI_GCLEADER;
+		}
+		goto fail;
+	}
+	gb->gb_members++;
+	gb->gb_refs++;
+	moi->moi_gcb = gb;
+	moi->moi_numads = mdb->mi_numads;
+	ldap_pvt_thread_mutex_unlock( &mdb->mi_gc_mutex );
+	return 0;
+
+fail:
+	moi->moi_txn = NULL;
+	mdb->mi_gc_busy = 0;
+	ldap_pvt_thread_cond_broadcast( &mdb->mi_gc_cond );
+	ldap_pvt_thread_mutex_unlock( &mdb->mi_gc_mutex );
+	return rc;
+}
+
+static int
+mdb_gc_end( struct mdb_info *mdb, mdb_op_info *moi, int commit )
+{
+	struct mdb_gcbatch *gb = moi->moi_gcb;
+	int rc = 0;
+
+	if ( commit )
+		rc = mdb_txn_commit( moi->moi_txn );
+	else
+		mdb_txn_abort( moi->moi_txn );
+
+	ldap_pvt_thread_mutex_lock( &mdb->mi_gc_mutex );
+	if ( commit && !rc )
+		gb->gb_commits++;
+	else
+		mdb_ad_unwind( mdb, moi->moi_numads );
+	mdb->mi_gc_busy = 0;
+	ldap_pvt_thread_cond_broadcast( &mdb->mi_gc_cond );
+
+	if ( moi->moi_flag & MOI_GCLEADER ) {
+		while ( mdb->mi_gc_busy || ( mdb->mi_gc_waiters &&
+			gb->gb_members < mdb->mi_gc_max ))
+			ldap_pvt_thread_cond_wait( &mdb->mi_gc_cond, &mdb->mi_gc_mutex );
+		mdb->mi_gc_batch = NULL;
+		if ( gb->gb_commits ) {
+			gb->gb_rc = mdb_txn_commit( gb->gb_txn );
+			if ( gb->gb_rc )
+				mdb_ad_unwind( mdb, gb->gb_numads );
+		} else {
+			mdb_txn_abort( gb->gb_txn );
+		}
+		Debug( LDAP_DEBUG_TRACE, "mdb_gc_end: batch of %d ops, "
+			"%d committed, rc=%d\n",
+			gb->gb_members, gb->gb_commits, gb->gb_rc );
+		gb->gb_done = 1;
+		ldap_pvt_thread_cond_broadcast( &mdb->mi_gc_cond );
+		moi->moi_flag ^= MOI_GCLEADER;
+	} else if ( commit && !rc ) {
+		while ( !gb->gb_done )
+			ldap_pvt_thread_cond_wait( &mdb->mi_gc_cond, &mdb->mi_gc_mutex );
+	}
+	if ( commit && !rc )
+		rc = gb->gb_rc;
+	if ( !--gb->gb_refs )
+		ch_free( gb );
+	ldap_pvt_thread_mutex_unlock( &mdb->mi_gc_mutex );
+	moi->moi_gcb = NULL;
+	return rc;
+}
+
+/* Commit the write txn of an op. The result is only durable, and
+ * only visible to readers, once this returns.
+ */
+int
+mdb_opinfo_commit( struct mdb_info *mdb, mdb_op_info *moi )
+{
+	int rc;
+
+	if ( moi->moi_gcb )
+		return mdb_gc_end( mdb, moi, 1 );
+
+	rc = mdb_txn_commit( moi->moi_txn );
+	if ( rc )
+		mdb_ad_unwind( mdb, moi->moi_numads );
+	return rc;
+}
+
+void
+mdb_opinfo_abort( struct mdb_info *mdb, mdb_op_info *moi )
+{
+	if ( moi->moi_gcb )
+		mdb_gc_end( mdb, moi, 0 );
+	else
+		mdb_txn_abort( moi->moi_txn );
+}
+
 int
 mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **moip )
 {
@@ -731,6 +898,7 @@ mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **m
 		moi->moi_oe.oe_key = mdb;
 		moi->moi_ref = 0;
 		moi->moi_txn = NULL;
+		moi->moi_gcb = NULL;
 	}
 
 	if ( !rdonly ) {
@@ -752,7 +920,12 @@ mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **m
 				if ( get_lazyCommit( op ))
 					flag |= MDB_NOMETASYNC;
 #endif
-				rc = mdb_txn_begin( mdb->mi_dbenv, NULL, flag, &moi->moi_txn );
+				moi->moi_numads = mdb->mi_numads;
+				if ( mdb->mi_gc_max > 1 &&
+					!( mdb->mi_dbenv_flags & MDB_WRITEMAP ))
+					rc = mdb_gc_begin( mdb, moi, flag );
+				else
+					rc = mdb_txn_begin( mdb->mi_dbenv, NULL, flag, &moi->moi_txn );
 				if (rc) {
 					Debug( LDAP_DEBUG_ANY, "mdb_opinfo_get: err %s(%d)\n",
 						mdb_strerror(rc), rc );
@@ -840,14 +1013,14 @@ int mdb_txn( Operation *op, int txnop, OpExtra **ptr )
 		}
 		return rc;
 	case SLAP_TXN_COMMIT:
-		rc = mdb_txn_commit( moi->moi_txn );
+		rc = mdb_opinfo_commit( mdb, moi );
 		if ( rc )
 			mdb->mi_numads = 0;
 		op->o_tmpfree( moi, op->o_tmpmemctx );
 		return rc;
 	case SLAP_TXN_ABORT:
 		mdb->mi_numads = 0;
-		mdb_txn_abort( moi->moi_txn );
+		mdb_opinfo_abort( mdb, moi );
 		op->o_tmpfree( moi, op->o_tmpmemctx );
 		return 0;
 	}
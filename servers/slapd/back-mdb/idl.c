@@ -275,6 +275,282 @@ mdb_show_key(
 	}
 }
 
+/* Packed IDLs
+ *
+ * Index databases created while "idlcompress" is enabled are opened
+ * without MDB_DUPFIXED and keep each key's IDs in variable-length
+ * blocks instead of one ID per duplicate. A block starts with its
+ * first ID in big-endian order, so the default dup ordering sorts the
+ * blocks by ID, followed by the gap to each subsequent ID as a 7-bit
+ * variable-length integer. Packed keys never turn into a range on
+ * disk; only the in-memory IDL does, once it exceeds MDB_idl_db_max.
+ */
+#define MDB_IDL_BLOCK_SIZE	256
+#define MDB_IDL_BLOCK_IDS	(MDB_IDL_BLOCK_SIZE - sizeof(ID) + 1)
+
+int
+mdb_idl_packed( MDB_txn *txn, MDB_dbi dbi )
+{
+	unsigned int flags = 0;
+
+	mdb_dbi_flags( txn, dbi, &flags );
+	return !( flags & MDB_DUPFIXED );
+}
+
+static void
+mdb_idl_put_first( unsigned char *ptr, ID id )
+{
+	int i;
+
+	for ( i = sizeof(ID) - 1; i >= 0; i-- ) {
+		ptr[i] = id & 0xff;
+		id >>= 8;
+	}
+}
+
+static ID
+mdb_idl_get_first( unsigned char *ptr )
+{
+	ID id = 0;
+	int i;
+
+	for ( i = 0; i < sizeof(ID); i++ )
+		id = (id << 8) | ptr[i];
+	return id;
+}
+
+/* Encode n sorted IDs as a single block, return its length */
+static size_t
+mdb_idl_pack( unsigned char *buf, ID *ids, unsigned n )
+{
+	unsigned char *ptr = buf + sizeof(ID);
+	unsigned i;
+	ID delta;
+
+	mdb_idl_put_first( buf, ids[0] );
+	for ( i = 1; i < n; i++ ) {
+		delta = ids[i] - ids[i-1];
+		while ( delta >= 0x80 ) {
+			*ptr++ = delta | 0x80;
+			delta >>= 7;
+		}
+		*ptr++ = delta;
+	}
+	return ptr - buf;
+}
+
+/* Decode a block, return the number of IDs or -1 if it is malformed */
+static int
+mdb_idl_unpack( MDB_val *data, ID *ids )
+{
+	unsigned char *ptr = data->mv_data;
+	unsigned char *end = ptr + data->mv_size;
+	unsigned n = 0, shift;
+	ID id, delta;
+
+	if ( data->mv_size < sizeof(ID) || data->mv_size > MDB_IDL_BLOCK_SIZE )
+		return -1;
+
+	id = mdb_idl_get_first( ptr );
+	ptr += sizeof(ID);
+	ids[n++] = id;
+	while ( ptr < end ) {
+		delta = 0;
+		shift = 0;
+		do {
+			if ( ptr >= end || shift >= sizeof(ID) * CHAR_BIT )
+				return -1;
+			delta |= (ID)(*ptr & 0x7f) << shift;
+			shift += 7;
+		} while ( *ptr++ & 0x80 );
+		if ( !delta || n >= MDB_IDL_BLOCK_IDS )
+			return -1;
+		id += delta;
+		ids[n++] = id;
+	}
+	return n;
+}
+
+/* Count the IDs in a block without decoding them: one for the first
+ * ID, plus one for each byte that ends a gap.
+ */
+static ID
+mdb_idl_block_count( MDB_val *data )
+{
+	unsigned char *ptr = (unsigned char *)data->mv_data + sizeof(ID);
+	unsigned char *end = (unsigned char *)data->mv_data + data->mv_size;
+	ID n = 1;
+
+	for ( ; ptr < end; ptr++ ) {
+		if ( !( *ptr & 0x80 ))
+			n++;
+	}
+	return n;
+}
+
+/* Position the cursor on the block that id belongs to: the last
+ * block starting at or before id, or the first block of the key if
+ * id precedes them all.
+ */
+static int
+mdb_idl_packed_seek(
+	MDB_cursor	*cursor,
+	MDB_val		*key,
+	MDB_val		*data,
+	ID			id )
+{
+	unsigned char buf[sizeof(ID)];
+	MDB_val k2 = *key;	/* cursor moves may repoint it into the map */
+	int rc;
+
+	mdb_idl_put_first( buf, id );
+	data->mv_data = buf;
+	data->mv_size = sizeof(buf);
+	rc = mdb_cursor_get( cursor, &k2, data, MDB_GET_BOTH_RANGE );
+	if ( rc == 0 ) {
+		if ( mdb_idl_get_first( data->mv_data ) == id )
+			return 0;
+		rc = mdb_cursor_get( cursor, &k2, data, MDB_PREV_DUP );
+		if ( rc == MDB_NOTFOUND ) {
+			k2 = *key;
+			rc = mdb_cursor_get( cursor, &k2, data, MDB_SET );
+		}
+	} else if ( rc == MDB_NOTFOUND ) {
+		/* id follows the start of the last block, or no such key */
+		rc = mdb_cursor_get( cursor, &k2, data, MDB_SET );
+		if ( rc == 0 )
+			rc = mdb_cursor_get( cursor, &k2, data, MDB_LAST_DUP );
+	}
+	return rc;
+}
+
+static int
+mdb_idl_packed_fetch(
+	MDB_cursor	*cursor,
+	MDB_val		*key,
+	MDB_val		*data,
+	ID			*ids )
+{
+	ID tmp[MDB_IDL_BLOCK_IDS], *dst, lo;
+	unsigned count = 0;
+	int n, rc;
+
+	do {
+		if ( count + MDB_IDL_BLOCK_IDS <= MDB_idl_db_max )
+			dst = ids + count + 1;
+		else
+			dst = tmp;
+		n = mdb_idl_unpack( data, dst );
+		if ( n < 0 )
+			return MDB_CORRUPTED;
+		if ( count + n > MDB_idl_db_max ) {
+			/* Too big for an in-memory IDL, return the range */
+			lo = count ? ids[1] : dst[0];
+			rc = mdb_cursor_get( cursor, key, data, MDB_LAST_DUP );
+			if ( rc )
+				return rc;
+			n = mdb_idl_unpack( data, tmp );
+			if ( n < 0 )
+				return MDB_CORRUPTED;
+			MDB_IDL_RANGE( ids, lo, tmp[n-1] );
+			return 0;
+		}
+		if ( dst == tmp )
+			AC_MEMCPY( ids + count + 1, tmp, n * sizeof(ID) );
+		count += n;
+		rc = mdb_cursor_get( cursor, key, data, MDB_NEXT_DUP );
+	} while ( rc == 0 );
+
+	ids[0] = count;
+	return rc == MDB_NOTFOUND ? 0 : rc;
+}
+
+static int
+mdb_idl_packed_insert(
+	MDB_cursor	*cursor,
+	MDB_val		*key,
+	ID			id )
+{
+	unsigned char buf[MDB_IDL_BLOCK_SIZE * 2];
+	ID ids[MDB_IDL_BLOCK_IDS + 1];
+	MDB_val data;
+	int n, x, rc;
+
+	rc = mdb_idl_packed_seek( cursor, key, &data, id );
+	if ( rc == MDB_NOTFOUND ) {
+		/* First ID for this key */
+		data.mv_data = buf;
+		data.mv_size = mdb_idl_pack( buf, &id, 1 );
+		return mdb_cursor_put( cursor, key, &data, 0 );
+	}
+	if ( rc )
+		return rc;
+
+	n = mdb_idl_unpack( &data, ids );
+	if ( n < 0 )
+		return MDB_CORRUPTED;
+
+	/* New IDs are usually appended, search from the end */
+	for ( x = n; x > 0 && ids[x-1] > id; x-- ) ;
+	if ( x > 0 && ids[x-1] == id )
+		return 0;
+	AC_MEMCPY( &ids[x+1], &ids[x], (n - x) * sizeof(ID) );
+	ids[x] = id;
+	n++;
+
+	rc = mdb_cursor_del( cursor, 0 );
+	if ( rc )
+		return rc;
+
+	data.mv_data = buf;
+	data.mv_size = mdb_idl_pack( buf, ids, n );
+	if ( data.mv_size > MDB_IDL_BLOCK_SIZE ) {
+		/* Split the block in two */
+		x = n / 2;
+		data.mv_size = mdb_idl_pack( buf, ids, x );
+		rc = mdb_cursor_put( cursor, key, &data, 0 );
+		if ( rc )
+			return rc;
+		data.mv_data = buf;
+		data.mv_size = mdb_idl_pack( buf, ids + x, n - x );
+	}
+	return mdb_cursor_put( cursor, key, &data, 0 );
+}
+
+static int
+mdb_idl_packed_delete(
+	MDB_cursor	*cursor,
+	MDB_val		*key,
+	ID			id )
+{
+	unsigned char buf[MDB_IDL_BLOCK_SIZE];
+	ID ids[MDB_IDL_BLOCK_IDS];
+	MDB_val data;
+	int n, x, rc;
+
+	rc = mdb_idl_packed_seek( cursor, key, &data, id );
+	if ( rc )
+		return rc;
+
+	n = mdb_idl_unpack( &data, ids );
+	if ( n < 0 )
+		return MDB_CORRUPTED;
+
+	for ( x = 0; x < n && ids[x] < id; x++ ) ;
+	if ( x == n || ids[x] != id )
+		return MDB_NOTFOUND;
+
+	rc = mdb_cursor_del( cursor, 0 );
+	if ( rc || n == 1 )
+		return rc;
+
+	n--;
+	AC_MEMCPY( &ids[x], &ids[x+1], (n - x) * sizeof(ID) );
+	data.mv_data = buf;
+	data.mv_size = mdb_idl_pack( buf, ids, n );
+	return mdb_cursor_put( cursor, key, &data, 0 );
+}
+
 int
 mdb_idl_fetch_key(
 	BackendDB	*be,
@@ -289,7 +565,7 @@ mdb_idl_fetch_key(
 	MDB_cursor *cursor;
 	ID *i;
 	size_t len;
-	int rc;
+	int rc, packed;
 	MDB_cursor_op opflag;
 
 	char keybuf[16];
@@ -300,6 +576,8 @@ mdb_idl_fetch_key(
 
 	assert( ids != NULL );
 
+	packed = mdb_idl_packed( txn, dbi );
+
 	if ( saved_cursor && *saved_cursor ) {
 		opflag = MDB_NEXT;
 	} else if ( get_flag == LDAP_FILTER_GE ) {
@@ -348,7 +626,10 @@ mdb_idl_fetch_key(
 		key->mv_data, key->mv_size ) > 0 ) {
 		rc = MDB_NOTFOUND;
 	}
-	if (rc == 0) {
+	if (rc == 0 && packed) {
+		rc = mdb_idl_packed_fetch( cursor, kptr, &data, ids );
+		data.mv_size = MDB_IDL_SIZEOF(ids);
+	} else if (rc == 0) {
 		i = ids+1;
 		rc = mdb_cursor_get( cursor, key, &data, MDB_GET_MULTIPLE );
 		while (rc == 0) {
@@ -406,6 +687,78 @@ mdb_idl_fetch_key(
 	return rc;
 }
 
+/*
+ * Count the IDs stored under a key without building an IDL. Plain
+ * lists are counted exactly and ranges by their span. Packed lists are
+ * counted block by block until they hold more IDs than an in-memory
+ * IDL, at which point mdb_idl_fetch_key() would return a range, so
+ * they are counted by the span of that range instead.
+ */
+int
+mdb_idl_count_key(
+	MDB_txn		*txn,
+	MDB_dbi		dbi,
+	MDB_val		*key,
+	ID			*count )
+{
+	MDB_cursor *cursor;
+	MDB_val data;
+	size_t n = 0;
+	ID lo, hi;
+	int rc;
+
+	*count = 0;
+	rc = mdb_cursor_open( txn, dbi, &cursor );
+	if ( rc != 0 )
+		return rc;
+
+	rc = mdb_cursor_get( cursor, key, &data, MDB_SET );
+	if ( rc == 0 )
+		rc = mdb_cursor_count( cursor, &n );
+	if ( rc == 0 && mdb_idl_packed( txn, dbi )) {
+		ID ids[MDB_IDL_BLOCK_IDS];
+		int x;
+
+		lo = mdb_idl_get_first( data.mv_data );
+		do {
+			*count += mdb_idl_block_count( &data );
+			if ( *count > MDB_idl_db_max ) {
+				rc = mdb_cursor_get( cursor, key, &data, MDB_LAST_DUP );
+				if ( rc == 0 ) {
+					x = mdb_idl_unpack( &data, ids );
+					if ( x < 0 )
+						rc = MDB_CORRUPTED;
+					else
+						*count = ids[x-1] - lo + 1;
+				}
+				break;
+			}
+			rc = mdb_cursor_get( cursor, key, &data, MDB_NEXT_DUP );
+		} while ( rc == 0 );
+	} else if ( rc == 0 ) {
+		memcpy( &lo, data.mv_data, sizeof(ID) );
+		if ( lo == 0 && n == MDB_IDL_RANGE_SIZE ) {
+			/* On disk, a range is denoted by 0 in the first element */
+			rc = mdb_cursor_get( cursor, key, &data, MDB_NEXT_DUP );
+			if ( rc == 0 ) {
+				memcpy( &lo, data.mv_data, sizeof(ID) );
+				rc = mdb_cursor_get( cursor, key, &data, MDB_NEXT_DUP );
+			}
+			if ( rc == 0 ) {
+				memcpy( &hi, data.mv_data, sizeof(ID) );
+				*count = hi - lo + 1;
+			}
+		} else {
+			*count = n;
+		}
+	}
+	mdb_cursor_close( cursor );
+
+	if ( rc == MDB_NOTFOUND )
+		rc = 0;
+	return rc;
+}
+
 int
 mdb_idl_insert_keys(
 	BackendDB	*be,
@@ -417,7 +770,7 @@ mdb_idl_insert_keys(
 	MDB_val key, data;
 	ID lo, hi, *i;
 	char *err;
-	int	rc = 0, k;
+	int	rc = 0, k, packed;
 	unsigned int flag = MDB_NODUPDATA;
 #ifndef	MISALIGNED_OK
 	int kbuf[2];
@@ -432,6 +785,8 @@ mdb_idl_insert_keys(
 
 	assert( id != NOID );
 
+	packed = mdb_idl_packed( mdb_cursor_txn( cursor ), mdb_cursor_dbi( cursor ));
+
 #ifndef MISALIGNED_OK
 	if (keys[0].bv_len & ALIGNER)
 		kbuf[1] = 0;
@@ -451,6 +806,14 @@ mdb_idl_insert_keys(
 		key.mv_size = keys[k].bv_len;
 		key.mv_data = keys[k].bv_val;
 	}
+	if ( packed ) {
+		rc = mdb_idl_packed_insert( cursor, &key, id );
+		if ( rc ) {
+			err = "packed insert";
+			goto fail;
+		}
+		continue;
+	}
 	rc = mdb_cursor_get( cursor, &key, &data, MDB_SET );
 	err = "c_get";
 	if ( rc == 0 ) {
@@ -574,7 +937,7 @@ mdb_idl_delete_keys(
 	struct berval *keys,
 	ID			id )
 {
-	int	rc = 0, k;
+	int	rc = 0, k, packed;
 	MDB_val key, data;
 	ID lo, hi, tmp, *i;
 	char *err;
@@ -590,6 +953,8 @@ mdb_idl_delete_keys(
 	}
 	assert( id != NOID );
 
+	packed = mdb_idl_packed( mdb_cursor_txn( cursor ), mdb_cursor_dbi( cursor ));
+
 #ifndef MISALIGNED_OK
 	if (keys[0].bv_len & ALIGNER)
 		kbuf[1] = 0;
@@ -609,6 +974,11 @@ mdb_idl_delete_keys(
 		key.mv_size = keys[k].bv_len;
 		key.mv_data = keys[k].bv_val;
 	}
+	if ( packed ) {
+		rc = mdb_idl_packed_delete( cursor, &key, id );
+		err = "packed delete";
+		goto fail;
+	}
 	rc = mdb_cursor_get( cursor, &key, &data, MDB_SET );
 	err = "c_get";
 	if ( rc == 0 ) {
@@ -704,6 +1074,98 @@ fail:
 }
 
 
+/*
+ * Exponential ("galloping") search: return the position of the first
+ * element of ids[lo..hi] that is not less than id, or hi+1 if there
+ * is none. The cost is logarithmic in the distance skipped, so walking
+ * a long list with the elements of a short one is cheap, while the
+ * first probe makes it no worse than a plain merge for lists of
+ * similar density.
+ */
+static ID
+mdb_idl_gallop( ID *ids, ID lo, ID hi, ID id )
+{
+	ID step = 1, top;
+
+	if ( lo > hi || ids[lo] >= id )
+		return lo;
+
+	/* ids[lo] < id from here on */
+	while ( lo + step <= hi && ids[lo + step] < id ) {
+		lo += step;
+		step <<= 1;
+	}
+	top = lo + step <= hi ? lo + step : hi + 1;
+
+	while ( top - lo > 1 ) {
+		ID mid = lo + (( top - lo ) >> 1);
+		if ( ids[mid] < id )
+			lo = mid;
+		else
+			top = mid;
+	}
+	return top;
+}
+
+/* Lists whose sizes differ by more than this factor are intersected
+ * by galloping through the longer one.
+ */
+#define IDL_GALLOP_RATIO	16
+
+/*
+ * Intersect two non-range IDLs, leaving the result in a. Output
+ * positions never pass the input position in a, so this works in place.
+ */
+static void
+mdb_idl_intersect_lists( ID *a, ID *b )
+{
+	ID na = a[0], nb = b[0];
+	ID i = 1, j = 1, c = 0;
+
+	if ( na / IDL_GALLOP_RATIO > nb ) {
+		for ( ; j <= nb; j++ ) {
+			i = mdb_idl_gallop( a, i, na, b[j] );
+			if ( i > na )
+				break;
+			if ( a[i] == b[j] )
+				a[++c] = a[i++];
+		}
+
+	} else if ( nb / IDL_GALLOP_RATIO > na ) {
+		for ( ; i <= na; i++ ) {
+			j = mdb_idl_gallop( b, j, nb, a[i] );
+			if ( j > nb )
+				break;
+			if ( b[j] == a[i] ) {
+				a[++c] = a[i];
+				j++;
+			}
+		}
+
+	} else {
+		/* Comparable sizes: a branch-free merge, except that a run of
+		 * IDs only one list has is skipped by galloping once its end
+		 * is known to be more than IDL_GALLOP_RATIO elements away.
+		 */
+		while ( i <= na && j <= nb ) {
+			ID ida = a[i], idb = b[j];
+			if ( i + IDL_GALLOP_RATIO <= na && a[i + IDL_GALLOP_RATIO] < idb ) {
+				i = mdb_idl_gallop( a, i + IDL_GALLOP_RATIO, na, idb );
+				continue;
+			}
+			if ( j + IDL_GALLOP_RATIO <= nb && b[j + IDL_GALLOP_RATIO] < ida ) {
+				j = mdb_idl_gallop( b, j + IDL_GALLOP_RATIO, nb, ida );
+				continue;
+			}
+			a[c+1] = ida;
+			c += ( ida == idb );
+			i += ( ida <= idb );
+			j += ( idb <= ida );
+		}
+	}
+	a[0] = c;
+}
+
 /*
  * idl_intersection - return a = a intersection b
  */
@@ -712,9 +1174,8 @@ mdb_idl_intersection(
 	ID *a,
 	ID *b )
 {
-	ID ida, idb;
 	ID idmax, idmin;
-	ID cursora = 0, cursorb = 0, cursorc;
+	ID first, last;
 	int swap = 0;
 
 	if ( MDB_IDL_IS_ZERO( a ) || MDB_IDL_IS_ZERO( b ) ) {
@@ -748,36 +1209,19 @@ mdb_idl_intersection(
 		}
 	}
 
-	/* If a range completely covers the list, the result is
-	 * just the list.
-	 */
-	if ( MDB_IDL_IS_RANGE( b )
-		&& MDB_IDL_RANGE_FIRST( b ) <= MDB_IDL_FIRST( a )
-		&& MDB_IDL_RANGE_LAST( b ) >= MDB_IDL_LLAST( a ) ) {
-		goto done;
+	if ( MDB_IDL_IS_RANGE( b ) ) {
+		/* The result is the slice of the list inside the range */
+		first = mdb_idl_gallop( a, 1, a[0], idmin );
+		last = mdb_idl_gallop( a, first, a[0], idmax );
+		if ( last <= a[0] && a[last] == idmax )
+			last++;
+		if ( first > 1 )
+			AC_MEMCPY( a+1, a+first, ( last - first ) * sizeof(ID) );
+		a[0] = last - first;
+	} else {
+		mdb_idl_intersect_lists( a, b );
 	}
 
-	/* Fine, do the intersection one element at a time.
-	 * First advance to idmin in both IDLs.
-	 */
-	cursora = cursorb = idmin;
-	ida = mdb_idl_first( a, &cursora );
-	idb = mdb_idl_first( b, &cursorb );
-	cursorc = 0;
-
-	while( ida <= idmax || idb <= idmax ) {
-		if( ida == idb ) {
-			a[++cursorc] = ida;
-			ida = mdb_idl_next( a, &cursora );
-			idb = mdb_idl_next( b, &cursorb );
-		} else if ( ida < idb ) {
-			ida = mdb_idl_next( a, &cursora );
-		} else {
-			idb = mdb_idl_next( b, &cursorb );
-		}
-	}
-	a[0] = cursorc;
-done:
 	if (swap)
 		MDB_IDL_CPY( b, a );
 
@@ -794,7 +1238,7 @@ mdb_idl_union(
 	ID	*b )
 {
 	ID ida, idb;
-	ID cursora = 0, cursorb = 0, cursorc;
+	ID na, nb, i, j, c;
 
 	if ( MDB_IDL_IS_ZERO( b ) ) {
 		return 0;
@@ -814,44 +1258,82 @@ over:		ida = IDL_MIN( MDB_IDL_FIRST(a), MDB_IDL_FIRST(b) );
 		return 0;
 	}
 
-	ida = mdb_idl_first( a, &cursora );
-	idb = mdb_idl_first( b, &cursorb );
+	na = a[0];
+	nb = b[0];
 
-	cursorc = b[0];
+	/* Disjoint lists are just concatenated */
+	if ( a[na] < b[1] || b[nb] < a[1] ) {
+		if ( na + nb > MDB_idl_um_max )
+			goto over;
+		if ( a[na] < b[1] ) {
+			AC_MEMCPY( a+na+1, b+1, nb * sizeof(ID) );
+		} else {
+			AC_MEMCPY( a+nb+1, a+1, na * sizeof(ID) );
+			AC_MEMCPY( a+1, b+1, nb * sizeof(ID) );
+		}
+		a[0] = na + nb;
+		return 0;
+	}
 
-	/* The distinct elements of a are cat'd to b */
-	while( ida != NOID || idb != NOID ) {
-		if ( ida < idb ) {
-			if( ++cursorc > MDB_idl_um_max ) {
+	if ( nb <= na ) {
+		/* The elements of b that a lacks are cat'd to b, then
+		 * merged into a from the top down.
+		 */
+		c = nb;
+		for ( i = 1, j = 1; j <= nb; j++ ) {
+			i = mdb_idl_gallop( a, i, na, b[j] );
+			if ( i <= na && a[i] == b[j] ) {
+				i++;
+				continue;
+			}
+			if ( na + ++c - nb > MDB_idl_um_max ) {
 				goto over;
 			}
-			b[cursorc] = ida;
-			ida = mdb_idl_next( a, &cursora );
-
-		} else {
-			if ( ida == idb )
-				ida = mdb_idl_next( a, &cursora );
-			idb = mdb_idl_next( b, &cursorb );
+			b[c] = b[j];
+		}
+		a[0] = na + c - nb;
+		for ( i = na, j = c; j > nb; ) {
+			if ( i && a[i] > b[j] ) {
+				a[i + j - nb] = a[i];
+				i--;
+			} else {
+				a[i + j - nb] = b[j];
+				j--;
+			}
 		}
+		return 0;
 	}
 
-	/* b is copied back to a in sorted order */
-	a[0] = cursorc;
-	cursora = 1;
-	cursorb = 1;
-	cursorc = b[0]+1;
-	while (cursorb <= b[0] || cursorc <= a[0]) {
-		if (cursorc > a[0])
-			idb = NOID;
-		else
-			idb = b[cursorc];
-		if (cursorb <= b[0] && b[cursorb] < idb)
-			a[cursora++] = b[cursorb++];
-		else {
-			a[cursora++] = idb;
-			cursorc++;
+	/* The distinct elements of a are cat'd to b */
+	c = nb;
+	for ( i = 1, j = 1; i <= na; i++ ) {
+		j = mdb_idl_gallop( b, j, nb, a[i] );
+		if ( j <= nb && b[j] == a[i] ) {
+			j++;
+			continue;
 		}
-	}
+		if ( ++c > MDB_idl_um_max ) {
+			goto over;
+		}
+		b[c] = a[i];
+	}
+
+	/* b is merged back into a in sorted order */
+	a[0] = c;
+	i = 1;
+	j = nb + 1;
+	na = 0;
+	while ( i <= nb && j <= c ) {
+		ida = b[i];
+		idb = b[j];
+		a[++na] = ida < idb ? ida : idb;
+		i += ( ida < idb );
+		j += ( idb < ida );
+	}
+	if ( i <= nb )
+		AC_MEMCPY( a+na+1, b+i, ( nb - i + 1 ) * sizeof(ID) );
+	else if ( j <= c )
+		AC_MEMCPY( a+na+1, b+j, ( c - j + 1 ) * sizeof(ID) );
 
 	return 0;
 }
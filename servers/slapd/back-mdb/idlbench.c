@@ -0,0 +1,332 @@
+/* idlbench.c - micro-benchmark for the back-mdb IDL set operations */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 2000-2022 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/*
+ * Times mdb_idl_intersection() and mdb_idl_union() against the
+ * element-at-a-time versions they replaced, and checks that both
+ * produce the same IDLs. Build with "make idlbench" in this directory.
+ *
+ *	idlbench [-i iterations] [-l logn] [-s seed]
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+
+#include <ac/stdlib.h>
+#include <ac/string.h>
+#include <ac/time.h>
+#include <ac/unistd.h>
+
+#define CH_FREE 1	/* plain malloc/free, there is no slapd heap */
+#include "back-mdb.h"
+#include "idl.h"
+
+/* idl.c logs through these; there is no slapd here to provide them */
+int slap_debug;
+int ldap_syslog;
+int ldap_syslog_level;
+
+#define IDL_MAX(x,y)	( (x) > (y) ? (x) : (y) )
+#define IDL_MIN(x,y)	( (x) < (y) ? (x) : (y) )
+
+static int
+ref_intersection( ID *a, ID *b )
+{
+	ID ida, idb;
+	ID idmax, idmin;
+	ID cursora = 0, cursorb = 0, cursorc;
+	int swap = 0;
+
+	if ( MDB_IDL_IS_ZERO( a ) || MDB_IDL_IS_ZERO( b ) ) {
+		a[0] = 0;
+		return 0;
+	}
+
+	idmin = IDL_MAX( MDB_IDL_FIRST(a), MDB_IDL_FIRST(b) );
+	idmax = IDL_MIN( MDB_IDL_LAST(a), MDB_IDL_LAST(b) );
+	if ( idmin > idmax ) {
+		a[0] = 0;
+		return 0;
+	} else if ( idmin == idmax ) {
+		a[0] = 1;
+		a[1] = idmin;
+		return 0;
+	}
+
+	if ( MDB_IDL_IS_RANGE( a ) ) {
+		if ( MDB_IDL_IS_RANGE(b) ) {
+			a[1] = idmin;
+			a[2] = idmax;
+			return 0;
+		} else {
+			ID *tmp = a;
+			a = b;
+			b = tmp;
+			swap = 1;
+		}
+	}
+
+	if ( MDB_IDL_IS_RANGE( b )
+		&& MDB_IDL_RANGE_FIRST( b ) <= MDB_IDL_FIRST( a )
+		&& MDB_IDL_RANGE_LAST( b ) >= MDB_IDL_LLAST( a ) ) {
+		goto done;
+	}
+
+	cursora = cursorb = idmin;
+	ida = mdb_idl_first( a, &cursora );
+	idb = mdb_idl_first( b, &cursorb );
+	cursorc = 0;
+
+	while( ida <= idmax || idb <= idmax ) {
+		if( ida == idb ) {
+			a[++cursorc] = ida;
+			ida = mdb_idl_next( a, &cursora );
+			idb = mdb_idl_next( b, &cursorb );
+		} else if ( ida < idb ) {
+			ida = mdb_idl_next( a, &cursora );
+		} else {
+			idb = mdb_idl_next( b, &cursorb );
+		}
+	}
+	a[0] = cursorc;
+done:
+	if (swap)
+		MDB_IDL_CPY( b, a );
+
+	return 0;
+}
+
+static int
+ref_union( ID *a, ID *b )
+{
+	ID ida, idb;
+	ID cursora = 0, cursorb = 0, cursorc;
+
+	if ( MDB_IDL_IS_ZERO( b ) ) {
+		return 0;
+	}
+
+	if ( MDB_IDL_IS_ZERO( a ) ) {
+		MDB_IDL_CPY( a, b );
+		return 0;
+	}
+
+	if ( MDB_IDL_IS_RANGE( a ) || MDB_IDL_IS_RANGE(b) ) {
+over:		ida = IDL_MIN( MDB_IDL_FIRST(a), MDB_IDL_FIRST(b) );
+		idb = IDL_MAX( MDB_IDL_LAST(a), MDB_IDL_LAST(b) );
+		a[0] = NOID;
+		a[1] = ida;
+		a[2] = idb;
+		return 0;
+	}
+
+	ida = mdb_idl_first( a, &cursora );
+	idb = mdb_idl_first( b, &cursorb );
+
+	cursorc = b[0];
+
+	while( ida != NOID || idb != NOID ) {
+		if ( ida < idb ) {
+			if( ++cursorc > MDB_idl_um_max ) {
+				goto over;
+			}
+			b[cursorc] = ida;
+			ida = mdb_idl_next( a, &cursora );
+
+		} else {
+			if ( ida == idb )
+				ida = mdb_idl_next( a, &cursora );
+			idb = mdb_idl_next( b, &cursorb );
+		}
+	}
+
+	a[0] = cursorc;
+	cursora = 1;
+	cursorb = 1;
+	cursorc = b[0]+1;
+	while (cursorb <= b[0] || cursorc <= a[0]) {
+		if (cursorc > a[0])
+			idb = NOID;
+		else
+			idb = b[cursorc];
+		if (cursorb <= b[0] && b[cursorb] < idb)
+			a[cursora++] = b[cursorb++];
+		else {
+			a[cursora++] = idb;
+			cursorc++;
+		}
+	}
+
+	return 0;
+}
+
+/* Fill ids with n sorted IDs spread evenly over 1..about max */
+static void
+gen_uniform( ID *ids, ID n, ID max )
+{
+	ID i, id = 0, gap = max / n;
+
+	for ( i = 1; i <= n; i++ ) {
+		id += 1 + rand() % ( 2 * gap - 1 );
+		ids[i] = id;
+	}
+	ids[0] = n;
+}
+
+/* Fill ids with runs of consecutive IDs separated by gaps, the shape
+ * of an index on an attribute whose entries were loaded in batches
+ */
+static void
+gen_clustered( ID *ids, ID n, ID run, ID gap )
+{
+	ID i, id = 1 + rand() % gap;
+
+	for ( i = 1; i <= n; i++ ) {
+		ids[i] = id++;
+		if ( i % run == 0 )
+			id += 1 + rand() % gap;
+	}
+	ids[0] = n;
+}
+
+static double
+now( void )
+{
+	struct timeval tv;
+
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+typedef int (idl_op)( ID *a, ID *b );
+
+static double
+run_op( idl_op *op, ID *a, ID *b, ID *res, ID *tmp, int iters )
+{
+	double start;
+	int i;
+
+	start = now();
+	for ( i = 0; i < iters; i++ ) {
+		MDB_IDL_CPY( res, a );
+		MDB_IDL_CPY( tmp, b );
+		op( res, tmp );
+	}
+	return now() - start;
+}
+
+static int
+bench( const char *name, ID *a, ID *b, int iters )
+{
+	static ID *res, *res2, *tmp;
+	double t_ref, t_new;
+	int rc = 0;
+	struct {
+		const char *op;
+		idl_op *ref, *new;
+	} *o, ops[] = {
+		{ "intersection", ref_intersection, mdb_idl_intersection },
+		{ "union", ref_union, mdb_idl_union },
+		{ NULL }
+	};
+
+	if ( !res ) {
+		res = malloc( MDB_idl_um_size * sizeof(ID) );
+		res2 = malloc( MDB_idl_um_size * sizeof(ID) );
+		tmp = malloc( MDB_idl_um_size * sizeof(ID) );
+	}
+
+	for ( o = ops; o->op; o++ ) {
+		t_ref = run_op( o->ref, a, b, res, tmp, iters );
+		t_new = run_op( o->new, a, b, res2, tmp, iters );
+		if ( MDB_IDL_SIZEOF( res ) != MDB_IDL_SIZEOF( res2 ) ||
+			memcmp( res, res2, MDB_IDL_SIZEOF( res ) )) {
+			printf( "%-28s %-12s MISMATCH\n", name, o->op );
+			rc = 1;
+			continue;
+		}
+		printf( "%-28s %-12s %8lu %10.3f %10.3f %6.2fx\n",
+			name, o->op, MDB_IDL_IS_RANGE( res ) ? 0UL : (unsigned long)res[0],
+			t_ref * 1000000.0 / iters, t_new * 1000000.0 / iters,
+			t_new > 0 ? t_ref / t_new : 0.0 );
+	}
+	return rc;
+}
+
+int
+main( int argc, char **argv )
+{
+	ID *a, *b;
+	ID n;
+	int iters = 200, seed = 1, rc = 0, c;
+
+	while (( c = getopt( argc, argv, "i:l:s:" )) != EOF ) {
+		switch ( c ) {
+		case 'i':
+			iters = atoi( optarg );
+			break;
+		case 'l':
+			MDB_idl_logn = atoi( optarg );
+			break;
+		case 's':
+			seed = atoi( optarg );
+			break;
+		default:
+			fprintf( stderr,
+				"usage: %s [-i iterations] [-l logn] [-s seed]\n",
+				argv[0] );
+			return 1;
+		}
+	}
+	mdb_idl_reset();
+	srand( seed );
+
+	a = malloc( MDB_idl_um_size * sizeof(ID) );
+	b = malloc( MDB_idl_um_size * sizeof(ID) );
+	n = MDB_idl_db_max / 2;
+
+	printf( "%-28s %-12s %8s %10s %10s %7s\n",
+		"case", "op", "result", "old usec", "new usec", "speedup" );
+
+	gen_uniform( a, n, n * 4 );
+	gen_uniform( b, n, n * 4 );
+	rc |= bench( "uniform, equal sizes", a, b, iters );
+
+	gen_uniform( a, n, n * 64 );
+	gen_uniform( b, n, n * 64 );
+	rc |= bench( "sparse, equal sizes", a, b, iters );
+
+	gen_uniform( a, n, n * 4 );
+	gen_uniform( b, n / 100, n * 4 );
+	rc |= bench( "uniform, 100:1", a, b, iters );
+
+	gen_uniform( a, 16, n * 4 );
+	gen_uniform( b, n, n * 4 );
+	rc |= bench( "uniform, 1:4000", a, b, iters );
+
+	gen_clustered( a, n, 64, 256 );
+	gen_clustered( b, n / 4, 8, 1024 );
+	rc |= bench( "clustered, 4:1", a, b, iters );
+
+	gen_clustered( a, n, 1000, 10 );
+	MDB_IDL_RANGE( b, n / 3, n * 2 );
+	rc |= bench( "clustered, range", a, b, iters );
+
+	free( a );
+	free( b );
+	return rc;
+}
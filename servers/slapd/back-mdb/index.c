@@ -108,6 +108,8 @@ int mdb_index_param(
 
 		return LDAP_INAPPROPRIATE_MATCHING;
 	}
+	/* ai_newmask is still being built by the online indexer,
+	 * only ai_indexmask is complete */
 	mask = ai->ai_indexmask;
 
 	switch( ftype ) {
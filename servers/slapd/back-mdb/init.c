@@ -67,6 +67,9 @@ mdb_db_init( BackendDB *be, ConfigReply *cr )
 	mdb->mi_multi_hi = UINT_MAX;
 	mdb->mi_multi_lo = UINT_MAX;
 
+	ldap_pvt_thread_mutex_init( &mdb->mi_gc_mutex );
+	ldap_pvt_thread_cond_init( &mdb->mi_gc_cond );
+
 	be->be_private = mdb;
 	be->be_cf_ocs = be->bd_info->bi_cf_ocs+1;
 
@@ -304,6 +307,9 @@ mdb_db_open( BackendDB *be, ConfigReply *cr )
 		goto fail;
 	}
 
+	if (( slapMode & SLAP_SERVER_MODE ) && !mdb->mi_ecache )
+		mdb_ecache_init( mdb );
+
 	/* monitor setup */
 	rc = mdb_monitor_db_open( be );
 	if ( rc != 0 ) {
@@ -373,6 +379,8 @@ mdb_db_close( BackendDB *be, ConfigReply *cr )
 		mdb->mi_dbenv = NULL;
 	}
 
+	mdb_ecache_destroy( mdb );
+
 	return 0;
 }
 
@@ -399,6 +407,9 @@ mdb_db_destroy( BackendDB *be, ConfigReply *cr )
 
 	mdb_attr_index_destroy( mdb );
 
+	ldap_pvt_thread_cond_destroy( &mdb->mi_gc_cond );
+	ldap_pvt_thread_mutex_destroy( &mdb->mi_gc_mutex );
+
 	ch_free( mdb );
 	be->be_private = NULL;
 
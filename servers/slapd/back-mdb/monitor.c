@@ -50,6 +50,13 @@ static AttributeDescription *ad_olmMDBReadersMax,
 
 static AttributeDescription *ad_olmMDBEntries;
 
+static AttributeDescription *ad_olmMDBEntryCacheHits,
+	*ad_olmMDBEntryCacheMisses, *ad_olmMDBEntryCacheEntries,
+	*ad_olmMDBEntryCacheSize;
+
+static AttributeDescription *ad_olmMDBIndexProgress,
+	*ad_olmMDBIndexEntries, *ad_olmMDBIndexETA;
+
 /*
  * NOTE: there's some confusion in monitor OID arc;
  * by now, let's consider:
@@ -143,6 +150,62 @@ static struct {
 		"NO-USER-MODIFICATION "
 		"USAGE dSAOperation )",
 		&ad_olmMDBEntries },
+
+	{ "( olmMDBAttributes:7 "
+		"NAME ( 'olmMDBEntryCacheHits' ) "
+		"DESC 'Number of entries found in the entry cache' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBEntryCacheHits },
+
+	{ "( olmMDBAttributes:8 "
+		"NAME ( 'olmMDBEntryCacheMisses' ) "
+		"DESC 'Number of entries not found in the entry cache' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBEntryCacheMisses },
+
+	{ "( olmMDBAttributes:9 "
+		"NAME ( 'olmMDBEntryCacheEntries' ) "
+		"DESC 'Number of entries in the entry cache' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBEntryCacheEntries },
+
+	{ "( olmMDBAttributes:10 "
+		"NAME ( 'olmMDBEntryCacheSize' ) "
+		"DESC 'Bytes used by the entry cache' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBEntryCacheSize },
+
+	{ "( olmMDBAttributes:11 "
+		"NAME ( 'olmMDBIndexProgress' ) "
+		"DESC 'Percentage of entries processed by the online indexer' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBIndexProgress },
+
+	{ "( olmMDBAttributes:12 "
+		"NAME ( 'olmMDBIndexEntries' ) "
+		"DESC 'Number of entries indexed by the online indexer' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBIndexEntries },
+
+	{ "( olmMDBAttributes:13 "
+		"NAME ( 'olmMDBIndexETA' ) "
+		"DESC 'Estimated seconds until the online indexer is done' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBIndexETA },
 	{ NULL }
 };
 
@@ -162,6 +225,9 @@ static struct {
 #endif /* MDB_MONITOR_IDX */
 			"$ olmMDBPagesMax $ olmMDBPagesUsed $ olmMDBPagesFree "
 			"$ olmMDBReadersMax $ olmMDBReadersUsed $ olmMDBEntries "
+			"$ olmMDBEntryCacheHits $ olmMDBEntryCacheMisses "
+			"$ olmMDBEntryCacheEntries $ olmMDBEntryCacheSize "
+			"$ olmMDBIndexProgress $ olmMDBIndexEntries $ olmMDBIndexETA "
 			") )",
 		&oc_olmMDBDatabase },
 
@@ -182,7 +248,14 @@ mdb_monitor_update(
 	MDB_stat mst;
 	MDB_envinfo mei;
 	MDB_txn *txn;
-	int rc;
+	unsigned long ec[4];
+	AttributeDescription **ecad[4] = { &ad_olmMDBEntryCacheHits,
+		&ad_olmMDBEntryCacheMisses, &ad_olmMDBEntryCacheEntries,
+		&ad_olmMDBEntryCacheSize };
+	unsigned long ix[3];
+	AttributeDescription **ixad[3] = { &ad_olmMDBIndexProgress,
+		&ad_olmMDBIndexEntries, &ad_olmMDBIndexETA };
+	int i, rc;
 
 #ifdef MDB_MONITOR_IDX
 
@@ -216,6 +289,39 @@ mdb_monitor_update(
 	bv.bv_len = snprintf( buf, sizeof( buf ), "%u", mei.me_numreaders );
 	ber_bvreplace( &a->a_vals[ 0 ], &bv );
 
+	mdb_ecache_stats( mdb, &ec[0], &ec[1], &ec[2], &ec[3] );
+	for ( i = 0; i < 4; i++ ) {
+		a = attr_find( e->e_attrs, *ecad[i] );
+		assert( a != NULL );
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", ec[i] );
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+	}
+
+	/* online indexer progress, estimated from its position in id2entry */
+	ix[0] = 100;
+	ix[1] = mdb->mi_ixb_count;
+	ix[2] = 0;
+	if ( mdb->mi_ixb_active ) {
+		ID pos = mdb->mi_ixb_pos, start = mdb->mi_ixb_start,
+			last = mdb->mi_ixb_last;
+
+		if ( pos <= last ) {
+			ix[0] = (unsigned long)( (double)pos * 100 / ( last + 1 ));
+			if ( pos > start ) {
+				ix[2] = (unsigned long)( (double)( slap_get_time() - mdb->mi_ixb_time ) *
+					( last + 1 - pos ) / ( pos - start ));
+			}
+		}
+	}
+	for ( i = 0; i < 3; i++ ) {
+		a = attr_find( e->e_attrs, *ixad[i] );
+		assert( a != NULL );
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", ix[i] );
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+	}
+
 	rc = mdb_txn_begin( mdb->mi_dbenv, NULL, MDB_RDONLY, &txn );
 	if ( !rc ) {
 		MDB_cursor *cursor;
@@ -436,7 +542,7 @@ mdb_monitor_db_open( BackendDB *be )
 	}
 
 	/* alloc as many as required (plus 1 for objectClass) */
-	a = attrs_alloc( 1 + 7 );
+	a = attrs_alloc( 1 + 14 );
 	if ( a == NULL ) {
 		rc = 1;
 		goto cleanup;
@@ -472,6 +578,34 @@ mdb_monitor_db_open( BackendDB *be )
 		next->a_desc = ad_olmMDBEntries;
 		attr_valadd( next, &bv, NULL, 1 );
 		next = next->a_next;
+
+		next->a_desc = ad_olmMDBEntryCacheHits;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBEntryCacheMisses;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBEntryCacheEntries;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBEntryCacheSize;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBIndexProgress;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBIndexEntries;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBIndexETA;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
 	}
 
 	{
@@ -59,6 +59,19 @@ int mdb_ad_read( struct mdb_info *mdb, MDB_txn *txn );
 int mdb_ad_get( struct mdb_info *mdb, MDB_txn *txn, AttributeDescription *ad );
 void mdb_ad_unwind( struct mdb_info *mdb, int prev_ads );
 
+/*
+ * cache.c
+ */
+
+int mdb_ecache_init( struct mdb_info *mdb );
+void mdb_ecache_destroy( struct mdb_info *mdb );
+int mdb_ecache_get( Operation *op, MDB_txn *txn, ID id, Entry **e );
+void mdb_ecache_put( Operation *op, MDB_txn *txn, Entry *e );
+void mdb_ecache_release( Entry *e );
+void mdb_ecache_invalidate( struct mdb_info *mdb, MDB_txn *txn, ID id );
+void mdb_ecache_stats( struct mdb_info *mdb, unsigned long *hits,
+	unsigned long *misses, unsigned long *count, unsigned long *size );
+
 /*
  * config.c
  */
@@ -221,6 +234,8 @@ int mdb_entry_decode( Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry *
 
 void mdb_reader_flush( MDB_env *env );
 int mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **moi );
+int mdb_opinfo_commit( struct mdb_info *mdb, mdb_op_info *moi );
+void mdb_opinfo_abort( struct mdb_info *mdb, mdb_op_info *moi );
 
 int mdb_mval_put(Operation *op, MDB_cursor *mc, ID id, Attribute *a);
 int mdb_mval_del(Operation *op, MDB_cursor *mc, ID id, Attribute *a);
@@ -240,8 +255,16 @@ int mdb_idl_fetch_key(
 	MDB_cursor	**saved_cursor,
 	int                     get_flag );
 
+int mdb_idl_count_key(
+	MDB_txn		*txn,
+	MDB_dbi		dbi,
+	MDB_val		*key,
+	ID			*count );
+
 int mdb_idl_insert( ID *ids, ID id );
 
+int mdb_idl_packed( MDB_txn *txn, MDB_dbi dbi );
+
 typedef int (mdb_idl_keyfunc)(
 	BackendDB *be,
 	MDB_cursor *mc,
@@ -335,6 +358,14 @@ mdb_key_read(
     MDB_cursor **saved_cursor,
         int get_flags );
 
+extern int
+mdb_key_count(
+	Backend	*be,
+	MDB_txn *txn,
+	MDB_dbi dbi,
+	struct berval *k,
+	ID *count );
+
 /*
  * nextid.c
  */
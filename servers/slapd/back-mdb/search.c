@@ -416,6 +416,308 @@ mdb_waitfixup( Operation *op, ww_ctx *ww, MDB_cursor *mci, MDB_cursor *mcd, IdSc
 	return rc;
 }
 
+/* Parallel filter evaluation for large candidate lists.
+ *
+ * When scanthreads is set and a search walks a long candidate IDL,
+ * the candidates are tested against the filter ahead of the main loop
+ * in windows of MDB_PSCAN_WINDOW cursor positions. Each window is cut
+ * into chunks that are claimed by pool threads and by the searching
+ * thread itself. A chunk is only marked as filtered out if its thread
+ * read it from the same snapshot as the search's own read txn;
+ * anything else is left for the main loop. The main loop still visits
+ * the candidates in order and re-checks the ones that weren't
+ * filtered out, so scope, referral and result ordering are exactly
+ * what a serial scan would produce.
+ */
+
+#define MDB_PSCAN_CHUNK		256
+#define MDB_PSCAN_WINDOW	(MDB_PSCAN_CHUNK * 64)
+#define MDB_PSCAN_MIN		(MDB_PSCAN_CHUNK * 16)	/* smallest list to split */
+
+typedef struct mdb_pscan {
+	ldap_pvt_thread_mutex_t	ps_mutex;
+	ldap_pvt_thread_cond_t	ps_cond;
+	Operation	*ps_op;
+	ID		*ps_ids;
+	ID		ps_base;	/* ID of the search base */
+	ID		ps_end;		/* last valid cursor position + 1 */
+	ID		ps_lo, ps_hi;	/* cursor positions in the window */
+	ID		ps_next;	/* next unclaimed position */
+	size_t	ps_txnid;	/* snapshot the window is valid for */
+	int		ps_busy;	/* threads working on the window */
+	int		ps_tasks;	/* tasks submitted and not yet finished */
+	int		ps_refs;
+	int		ps_done;
+	unsigned char	ps_marks[MDB_PSCAN_WINDOW];
+} mdb_pscan;
+
+static void
+mdb_pscan_unref( mdb_pscan *ps )
+{
+	int refs;
+
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	refs = --ps->ps_refs;
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+	if ( !refs ) {
+		ldap_pvt_thread_cond_destroy( &ps->ps_cond );
+		ldap_pvt_thread_mutex_destroy( &ps->ps_mutex );
+		ch_free( ps );
+	}
+}
+
+/* Claim the next chunk of the window. Must be called with ps_mutex held. */
+static int
+mdb_pscan_claim( mdb_pscan *ps, ID *lo, ID *hi )
+{
+	if ( ps->ps_done || ps->ps_next >= ps->ps_hi )
+		return 0;
+	*lo = ps->ps_next;
+	*hi = *lo + MDB_PSCAN_CHUNK;
+	if ( *hi > ps->ps_hi )
+		*hi = ps->ps_hi;
+	ps->ps_next = *hi;
+	return 1;
+}
+
+/* Mark the positions in [lo,hi) that may match the filter */
+static void
+mdb_pscan_chunk(
+	Operation *op,
+	mdb_pscan *ps,
+	MDB_txn *txn,
+	MDB_cursor *mci,
+	MDB_cursor **mcd,
+	ID lo,
+	ID hi,
+	int same )
+{
+	int manageDSAit = get_manageDSAit( op );
+	unsigned char *marks = ps->ps_marks + ( lo - ps->ps_lo );
+	Entry *e;
+	ID pos, id;
+	int rc;
+
+	if ( !same ) {
+		memset( marks, 1, hi - lo );
+		return;
+	}
+
+	for ( pos = lo; pos < hi; pos++, marks++ ) {
+		id = MDB_IDL_IS_RANGE( ps->ps_ids ) ? pos : ps->ps_ids[pos];
+		*marks = 0;
+		if ( id == ps->ps_base ) {
+			*marks = 1;
+			continue;
+		}
+		rc = mdb_id2entry( op, mci, id, &e );
+		if ( rc ) {
+			/* missing entries are skipped by the main loop too */
+			if ( rc != MDB_NOTFOUND )
+				*marks = 1;
+			continue;
+		}
+		rc = mdb_id2name( op, txn, mcd, id, &e->e_name, &e->e_nname );
+		if ( rc ||
+			( !manageDSAit && op->ors_scope != LDAP_SCOPE_BASE &&
+				is_entry_referral( e )) ||
+			test_filter( op, e, op->ors_filter ) == LDAP_COMPARE_TRUE )
+		{
+			*marks = 1;
+		}
+		mdb_entry_return( op, e );
+	}
+}
+
+static void *
+mdb_pscan_task( void *ctx, void *arg )
+{
+	mdb_pscan *ps = arg;
+	struct mdb_info *mdb;
+	OperationBuffer opbuf;
+	Operation *op;
+	mdb_op_info opinfo = {{{0}}}, *moi = &opinfo;
+	MDB_cursor *mci = NULL, *mcd = NULL;
+	ID lo, hi;
+	size_t txnid;
+	int rc;
+
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	if ( !mdb_pscan_claim( ps, &lo, &hi )) {
+		ps->ps_tasks--;
+		ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+		goto unref;
+	}
+	ps->ps_busy++;
+	txnid = ps->ps_txnid;
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+
+	op = &opbuf.ob_op;
+	*op = *ps->ps_op;
+	op->o_hdr = &opbuf.ob_hdr;
+	*op->o_hdr = *ps->ps_op->o_hdr;
+	op->o_tmpmemctx = slap_sl_mem_create( SLAP_SLAB_SIZE, SLAP_SLAB_STACK, ctx, 1 );
+	op->o_tmpmfuncs = &slap_sl_mfuncs;
+	op->o_threadctx = ctx;
+	LDAP_SLIST_FIRST( &op->o_extra ) = NULL;
+	op->o_callback = NULL;
+	/* the group and ACL caches belong to the search's own thread */
+	op->o_groups = NULL;
+	op->o_do_not_cache = 1;
+	op->o_aclcache = NULL;
+	mdb = (struct mdb_info *) op->o_bd->be_private;
+
+	rc = mdb_opinfo_get( op, mdb, 1, &moi );
+	if ( !rc ) {
+		rc = mdb_cursor_open( moi->moi_txn, mdb->mi_id2entry, &mci );
+		if ( rc ) {
+			mdb_txn_reset( moi->moi_txn );
+			LDAP_SLIST_REMOVE( &op->o_extra, &moi->moi_oe, OpExtra, oe_next );
+		} else if ( MDB_IDL_IS_RANGE( ps->ps_ids )) {
+			mdb_cursor_readahead( mci, MDB_READAHEAD );
+		}
+	}
+
+	for (;;) {
+		if ( !rc && mdb_txn_id( moi->moi_txn ) != txnid ) {
+			/* the search moved to a newer snapshot, try to follow */
+			mdb_txn_reset( moi->moi_txn );
+			mdb_txn_renew( moi->moi_txn );
+			mdb_cursor_renew( moi->moi_txn, mci );
+			if ( mcd )
+				mdb_cursor_renew( moi->moi_txn, mcd );
+		}
+		mdb_pscan_chunk( op, ps, moi->moi_txn, mci, &mcd, lo, hi,
+			!rc && mdb_txn_id( moi->moi_txn ) == txnid );
+
+		ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+		if ( !mdb_pscan_claim( ps, &lo, &hi ))
+			break;
+		txnid = ps->ps_txnid;
+		ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+	}
+	ps->ps_busy--;
+	ps->ps_tasks--;
+	if ( !ps->ps_busy )
+		ldap_pvt_thread_cond_signal( &ps->ps_cond );
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+
+	if ( !rc ) {
+		if ( mcd )
+			mdb_cursor_close( mcd );
+		mdb_cursor_close( mci );
+		mdb_txn_reset( moi->moi_txn );
+		LDAP_SLIST_REMOVE( &op->o_extra, &moi->moi_oe, OpExtra, oe_next );
+	}
+
+unref:
+	mdb_pscan_unref( ps );
+	return NULL;
+}
+
+static mdb_pscan *
+mdb_pscan_init( Operation *op, ID *candidates, ID base, ID ncand )
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	mdb_pscan *ps;
+
+	if ( !mdb->mi_scan_threads || !op->o_threadctx ||
+		ncand < MDB_PSCAN_MIN || ncand == NOID )
+		return NULL;
+
+	ps = ch_calloc( 1, sizeof( mdb_pscan ));
+	ldap_pvt_thread_mutex_init( &ps->ps_mutex );
+	ldap_pvt_thread_cond_init( &ps->ps_cond );
+	ps->ps_op = op;
+	ps->ps_ids = candidates;
+	ps->ps_base = base;
+	ps->ps_end = MDB_IDL_IS_RANGE( candidates ) ?
+		MDB_IDL_RANGE_LAST( candidates ) + 1 : candidates[0] + 1;
+	ps->ps_refs = 1;
+	return ps;
+}
+
+static void
+mdb_pscan_destroy( mdb_pscan *ps )
+{
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	ps->ps_done = 1;
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+	mdb_pscan_unref( ps );
+}
+
+/* Evaluate the window of candidates that starts at cursor */
+static void
+mdb_pscan_fill(
+	Operation *op,
+	mdb_pscan *ps,
+	MDB_txn *txn,
+	MDB_cursor *mci,
+	ID cursor )
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	MDB_cursor *mcd = NULL;
+	ID lo, hi;
+	int n;
+
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	ps->ps_lo = ps->ps_next = cursor;
+	ps->ps_hi = cursor + MDB_PSCAN_WINDOW;
+	if ( ps->ps_hi > ps->ps_end || ps->ps_hi < cursor )
+		ps->ps_hi = ps->ps_end;
+	ps->ps_txnid = mdb_txn_id( txn );
+	/* keep scanthreads tasks around, one per chunk at most */
+	n = ( ps->ps_hi - ps->ps_lo + MDB_PSCAN_CHUNK - 1 ) / MDB_PSCAN_CHUNK - 1;
+	if ( n > (int)mdb->mi_scan_threads )
+		n = mdb->mi_scan_threads;
+	for ( n -= ps->ps_tasks; n > 0; n-- ) {
+		ps->ps_refs++;
+		ps->ps_tasks++;
+		if ( ldap_pvt_thread_pool_submit( &connection_pool,
+			mdb_pscan_task, ps ) ) {
+			ps->ps_refs--;
+			ps->ps_tasks--;
+			break;
+		}
+	}
+
+	Debug( LDAP_DEBUG_TRACE, "mdb_pscan_fill: positions %lu-%lu, %d tasks\n",
+		(unsigned long) ps->ps_lo, (unsigned long) ps->ps_hi - 1, ps->ps_tasks );
+
+	/* do our share, then wait for the chunks others claimed */
+	while ( mdb_pscan_claim( ps, &lo, &hi )) {
+		ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+		mdb_pscan_chunk( op, ps, txn, mci, &mcd, lo, hi, 1 );
+		ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	}
+	while ( ps->ps_busy )
+		ldap_pvt_thread_cond_wait( &ps->ps_cond, &ps->ps_mutex );
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+
+	if ( mcd )
+		mdb_cursor_close( mcd );
+}
+
+/* Returns zero if the candidate at cursor is known not to match */
+static int
+mdb_pscan_match(
+	Operation *op,
+	mdb_pscan *ps,
+	MDB_txn *txn,
+	MDB_cursor *mci,
+	ID cursor )
+{
+	if ( cursor < ps->ps_lo || cursor >= ps->ps_hi ||
+		ps->ps_txnid != mdb_txn_id( txn ))
+	{
+		/* not worth splitting the tail of the list */
+		if ( ps->ps_end - cursor < MDB_PSCAN_MIN )
+			return 1;
+		mdb_pscan_fill( op, ps, txn, mci, cursor );
+	}
+	return ps->ps_marks[cursor - ps->ps_lo];
+}
+
 int
 mdb_search( Operation *op, SlapReply *rs )
 {
@@ -437,6 +739,7 @@ mdb_search( Operation *op, SlapReply *rs )
 	MDB_cursor	*mci, *mcd;
 	ww_ctx wwctx;
 	slap_callback cb = { 0 };
+	mdb_pscan	*pscan = NULL;
 
 	mdb_op_info	opinfo = {{{0}}}, *moi = &opinfo;
 	MDB_txn			*ltid = NULL;
@@ -703,6 +1006,12 @@ adminlimit:
 	 */
 	cursor = 0;
 
+	/* A range means the filter wasn't indexed and the search will
+	 * step through id2entry in order, so let LMDB read ahead of it.
+	 */
+	if ( MDB_IDL_IS_RANGE( candidates ))
+		mdb_cursor_readahead( mci, MDB_READAHEAD );
+
 	if ( candidates[0] == 0 ) {
 		Debug( LDAP_DEBUG_TRACE,
 			LDAP_XSTRING(mdb_search) ": no candidates\n" );
@@ -769,8 +1078,19 @@ adminlimit:
 		if ( id == (ID)ps->ps_cookie )
 			id = mdb_idl_next( candidates, &cursor );
 		nsubs = ncand;	/* always bypass scope'd search */
+		if ( moi->moi_flag & MOI_READER )
+			pscan = mdb_pscan_init( op, candidates, base->e_id, ncand );
 		goto loop_begin;
 	}
+	if ( moi->moi_flag & MOI_READER ) {
+		/* The parallel scan works on the candidate list; prefer it
+		 * to the scope-based walk unless the scope is much smaller.
+		 */
+		if ( nsubs >= ncand || ( nsubs >= ncand / 2 && !admincheck ))
+			pscan = mdb_pscan_init( op, candidates, base->e_id, ncand );
+		if ( pscan )
+			nsubs = ncand;
+	}
 	if ( nsubs < ncand ) {
 		int rc;
 		/* Do scope-based search */
@@ -840,6 +1160,28 @@ loop_begin:
 			goto done;
 		}
 
+		if ( pscan ) {
+			if ( moi == &opinfo && !wwctx.flag &&
+				( cursor < pscan->ps_lo || cursor >= pscan->ps_hi ) &&
+				pscan->ps_end - cursor >= MDB_PSCAN_MIN )
+			{
+				/* start each window on the newest snapshot so
+				 * the scan threads can share it
+				 */
+				MDB_envinfo ei;
+				mdb_env_info( mdb->mi_dbenv, &ei );
+				if ( ei.me_last_txnid > mdb_txn_id( ltid )) {
+					mdb_rtxn_snap( op, &wwctx );
+					rs->sr_err = mdb_waitfixup( op, &wwctx, mci, mcd, &isc );
+					if ( rs->sr_err ) {
+						send_ldap_result( op, rs );
+						goto done;
+					}
+				}
+			}
+			if ( !mdb_pscan_match( op, pscan, ltid, mci, cursor ))
+				goto loop_continue;
+		}
 
 		if ( nsubs < ncand ) {
 			unsigned i;
@@ -908,6 +1250,8 @@ loop_begin:
 scopeok:
 		if ( id == base->e_id ) {
 			e = base;
+		} else if ( mdb_ecache_get( op, ltid, id, &e ) == 0 ) {
+			/* decoded copy from the entry cache */
 		} else {
 
 			/* get the entry */
@@ -956,6 +1300,7 @@ notfound:
 			e->e_id = id;
 			e->e_name.bv_val = NULL;
 			e->e_nname.bv_val = NULL;
+			mdb_ecache_put( op, ltid, e );
 		}
 
 		if ( is_entry_subentry( e ) ) {
@@ -1225,6 +1570,8 @@ done:
 			}
 		}
 	}
+	if ( pscan )
+		mdb_pscan_destroy( pscan );
 	mdb_cursor_close( mcd );
 	mdb_cursor_close( mci );
 	if ( moi == &opinfo ) {
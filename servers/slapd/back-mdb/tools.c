@@ -86,6 +86,7 @@ static ldap_pvt_thread_cond_t mdb_tool_index_cond_work;
 static void * mdb_tool_index_task( void *ctx, void *ptr );
 
 static int	mdb_writes, mdb_writes_per_commit;
+static int	mdb_tool_reformat_done;
 
 /* Number of ops per commit in Quick mode.
  * Batching speeds writes overall, but too large a
@@ -285,6 +286,7 @@ ID mdb_tool_entry_next(
 			mdb_txn_abort( mdb_tool_txn );
 			return NOID;
 		}
+		mdb_cursor_readahead( cursor, MDB_READAHEAD );
 	}
 
 next:;
@@ -458,6 +460,7 @@ mdb_tool_entry_get( BackendDB *be, ID id )
 			mdb_tool_txn = NULL;
 			return NULL;
 		}
+		mdb_cursor_readahead( cursor, MDB_READAHEAD );
 	}
 	(void)mdb_tool_entry_get_int( be, id, &e );
 	return e;
@@ -808,6 +811,30 @@ done:
 
 static int mdb_dn2id_upgrade( BackendDB *be );
 
+static int
+mdb_tool_idl_reformat( struct mdb_info *mi, MDB_txn *txn, AttrInfo *ai )
+{
+	unsigned flags = MDB_DUPSORT|MDB_CREATE;
+	int rc;
+
+	if ( mdb_idl_packed( txn, ai->ai_dbi ) == !!mi->mi_idlcompress )
+		return 0;
+
+	Debug( LDAP_DEBUG_ANY,
+		LDAP_XSTRING(mdb_tool_entry_reindex)
+		": converting index %s to %s IDL format\n",
+		ai->ai_desc->ad_type->sat_cname.bv_val,
+		mi->mi_idlcompress ? "packed" : "plain" );
+
+	rc = mdb_drop( txn, ai->ai_dbi, 1 );
+	if ( rc )
+		return rc;
+	if ( !mi->mi_idlcompress )
+		flags |= MDB_DUPFIXED|MDB_INTEGERDUP;
+	return mdb_dbi_open( txn, ai->ai_desc->ad_type->sat_cname.bv_val,
+		flags, &ai->ai_dbi );
+}
+
 int mdb_tool_entry_reindex(
 	BackendDB *be,
 	ID id,
@@ -901,6 +928,25 @@ int mdb_tool_entry_reindex(
 		}
 	}
 
+	/* Indices whose IDL format doesn't match the idlcompress
+	 * setting are recreated empty, the reindex fills them again.
+	 */
+	if ( !mdb_tool_reformat_done ) {
+		int i;
+		for ( i=0; i < mi->mi_nattrs; i++ ) {
+			rc = mdb_tool_idl_reformat( mi, txi, mi->mi_attrs[i] );
+			if ( rc ) {
+				Debug( LDAP_DEBUG_ANY,
+					LDAP_XSTRING(mdb_tool_entry_reindex)
+					": (Reformat) %s failed: %s (%d)\n",
+					mi->mi_attrs[i]->ai_desc->ad_type->sat_cname.bv_val,
+					mdb_strerror(rc), rc );
+				return -1;
+			}
+		}
+		mdb_tool_reformat_done = 1;
+	}
+
 	if ( slapMode & SLAP_TRUNCATE_MODE ) {
 		int i;
 		for ( i=0; i < mi->mi_nattrs; i++ ) {
@@ -958,6 +1004,7 @@ done:
 			/* and then reopen it so that tool_entry_next still works. */
 			mdb_txn_begin( mi->mi_dbenv, NULL, MDB_RDONLY, &mdb_tool_txn );
 			mdb_cursor_open( mdb_tool_txn, mi->mi_id2entry, &cursor );
+			mdb_cursor_readahead( cursor, MDB_READAHEAD );
 			key.mv_data = &id;
 			key.mv_size = sizeof(ID);
 			mdb_cursor_get( cursor, &key, NULL, MDB_SET );
@@ -108,6 +108,7 @@ typedef struct monitor_info_t {
 	ObjectClass		*mi_oc_monitorConnection;
 	ObjectClass		*mi_oc_managedObject;
 	ObjectClass		*mi_oc_monitoredObject;
+	ObjectClass		*mi_oc_monitorLatency;
 
 	AttributeDescription	*mi_ad_monitoredInfo;
 	AttributeDescription	*mi_ad_managedInfo;
@@ -140,6 +141,14 @@ typedef struct monitor_info_t {
 	AttributeDescription	*mi_ad_monitorConnectionOpsAsync;
 	AttributeDescription	*mi_ad_monitorLogLevel;
 	AttributeDescription	*mi_ad_monitorDebugLevel;
+	AttributeDescription	*mi_ad_monitorLatencyP50;
+	AttributeDescription	*mi_ad_monitorLatencyP90;
+	AttributeDescription	*mi_ad_monitorLatencyP99;
+	AttributeDescription	*mi_ad_monitorLatencyP999;
+	AttributeDescription	*mi_ad_monitorLatencyBucket;
+	AttributeDescription	*mi_ad_monitorConnectionRawBytes;
+	AttributeDescription	*mi_ad_monitorConnectionWireBytes;
+	AttributeDescription	*mi_ad_monitorConnectionCompressionRatio;
 
 	/*
 	 * Generic description attribute
@@ -403,6 +403,22 @@ conn_create(
 
 	attr_merge_normalize_one( e, mi->mi_ad_monitorConnectionActivityTime, &mtmbv, NULL );
 
+	{
+		ber_len_t raw, wire;
+
+		if ( c->c_sb && ldap_pvt_compress_stats( c->c_sb, &raw, &wire ) == 0 ) {
+			bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", (unsigned long)raw );
+			attr_merge_one( e, mi->mi_ad_monitorConnectionRawBytes, &bv, NULL );
+
+			bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", (unsigned long)wire );
+			attr_merge_one( e, mi->mi_ad_monitorConnectionWireBytes, &bv, NULL );
+
+			bv.bv_len = snprintf( buf, sizeof( buf ), "%.2f",
+				wire ? (double)raw / wire : 0.0 );
+			attr_merge_normalize_one( e, mi->mi_ad_monitorConnectionCompressionRatio, &bv, NULL );
+		}
+	}
+
 	mp = monitor_entrypriv_create();
 	if ( mp == NULL ) {
 		return LDAP_OTHER;
@@ -355,6 +355,17 @@ monitor_subsys_database_init_one(
 		return( -1 );
 	}
 
+	if ( be->be_latency ) {
+		int rc;
+
+		monitor_cache_lock( e );
+		rc = monitor_latency_init( mi, ms, e, SLAP_OP_LAST, be );
+		monitor_cache_release( mi, e );
+		if ( rc ) {
+			return( -1 );
+		}
+	}
+
 #if defined(LDAP_SLAPI)
 	monitor_back_add_plugin( mi, be, e );
 #endif /* defined(LDAP_SLAPI) */
@@ -1708,6 +1708,19 @@ monitor_back_initialize(
 			"DESC 'monitor monitored entity class' "
 			"SUP monitor STRUCTURAL )", SLAP_OC_OPERATIONAL|SLAP_OC_HIDE,
 			offsetof(monitor_info_t, mi_oc_monitoredObject) },
+		{ "( 1.3.6.1.4.1.4203.666.3.16.9 "
+			"NAME 'monitorLatency' "
+			"DESC 'monitor operation latency class' "
+			"SUP monitor STRUCTURAL "
+			"MAY ( "
+				"monitorCounter "
+				"$ monitorLatencyP50 "
+				"$ monitorLatencyP90 "
+				"$ monitorLatencyP99 "
+				"$ monitorLatencyP999 "
+				"$ monitorLatencyBucket "
+			") )", SLAP_OC_OPERATIONAL|SLAP_OC_HIDE,
+			offsetof(monitor_info_t, mi_oc_monitorLatency) },
 		{ NULL, 0, -1 }
 	}, mat[] = {
 		{ "( 1.3.6.1.4.1.4203.666.1.55.1 "
@@ -1956,6 +1969,67 @@ monitor_back_initialize(
 			"SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 "
 			"USAGE dSAOperation )", SLAP_AT_FINAL|SLAP_AT_HIDE,
 			offsetof(monitor_info_t, mi_ad_monitorDebugLevel) },
+		{ "( 1.3.6.1.4.1.4203.666.1.55.34 "
+			"NAME 'monitorLatencyP50' "
+			"DESC 'monitor median latency in microseconds' "
+			"SUP monitorCounter "
+			"SINGLE-VALUE "
+			"NO-USER-MODIFICATION "
+			"USAGE dSAOperation )", SLAP_AT_FINAL|SLAP_AT_HIDE,
+			offsetof(monitor_info_t, mi_ad_monitorLatencyP50) },
+		{ "( 1.3.6.1.4.1.4203.666.1.55.35 "
+			"NAME 'monitorLatencyP90' "
+			"DESC 'monitor 90th percentile latency in microseconds' "
+			"SUP monitorCounter "
+			"SINGLE-VALUE "
+			"NO-USER-MODIFICATION "
+			"USAGE dSAOperation )", SLAP_AT_FINAL|SLAP_AT_HIDE,
+			offsetof(monitor_info_t, mi_ad_monitorLatencyP90) },
+		{ "( 1.3.6.1.4.1.4203.666.1.55.36 "
+			"NAME 'monitorLatencyP99' "
+			"DESC 'monitor 99th percentile latency in microseconds' "
+			"SUP monitorCounter "
+			"SINGLE-VALUE "
+			"NO-USER-MODIFICATION "
+			"USAGE dSAOperation )", SLAP_AT_FINAL|SLAP_AT_HIDE,
+			offsetof(monitor_info_t, mi_ad_monitorLatencyP99) },
+		{ "( 1.3.6.1.4.1.4203.666.1.55.37 "
+			"NAME 'monitorLatencyP999' "
+			"DESC 'monitor 99.9th percentile latency in microseconds' "
+			"SUP monitorCounter "
+			"SINGLE-VALUE "
+			"NO-USER-MODIFICATION "
+			"USAGE dSAOperation )", SLAP_AT_FINAL|SLAP_AT_HIDE,
+			offsetof(monitor_info_t, mi_ad_monitorLatencyP999) },
+		{ "( 1.3.6.1.4.1.4203.666.1.55.38 "
+			"NAME 'monitorLatencyBucket' "
+			"DESC 'monitor latency histogram bucket: <low>-<high> <count>' "
+			"SUP monitoredInfo "
+			"NO-USER-MODIFICATION "
+			"USAGE dSAOperation )", SLAP_AT_FINAL|SLAP_AT_HIDE,
+			offsetof(monitor_info_t, mi_ad_monitorLatencyBucket) },
+		{ "( 1.3.6.1.4.1.4203.666.1.55.39 "
+			"NAME 'monitorConnectionRawBytes' "
+			"DESC 'monitor bytes written to the connection before compression' "
+			"SUP monitorCounter "
+			"NO-USER-MODIFICATION "
+			"USAGE dSAOperation )", SLAP_AT_FINAL|SLAP_AT_HIDE,
+			offsetof(monitor_info_t, mi_ad_monitorConnectionRawBytes) },
+		{ "( 1.3.6.1.4.1.4203.666.1.55.40 "
+			"NAME 'monitorConnectionWireBytes' "
+			"DESC 'monitor compressed bytes written to the connection' "
+			"SUP monitorCounter "
+			"NO-USER-MODIFICATION "
+			"USAGE dSAOperation )", SLAP_AT_FINAL|SLAP_AT_HIDE,
+			offsetof(monitor_info_t, mi_ad_monitorConnectionWireBytes) },
+		{ "( 1.3.6.1.4.1.4203.666.1.55.41 "
+			"NAME 'monitorConnectionCompressionRatio' "
+			"DESC 'monitor connection raw to compressed bytes' "
+			"SUP monitoredInfo "
+			"SINGLE-VALUE "
+			"NO-USER-MODIFICATION "
+			"USAGE dSAOperation )", SLAP_AT_FINAL|SLAP_AT_HIDE,
+			offsetof(monitor_info_t, mi_ad_monitorConnectionCompressionRatio) },
 		{ NULL, 0, -1 }
 	};
 
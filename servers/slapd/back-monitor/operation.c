@@ -45,6 +45,20 @@ struct monitor_ops_t {
 	{ BER_BVNULL,			BER_BVNULL }
 };
 
+static struct berval monitor_lat_rdn[] = {
+	BER_BVC( "cn=Queue" ),		/* SLAP_LAT_QUEUE */
+	BER_BVC( "cn=Execute" ),	/* SLAP_LAT_EXECUTE */
+	BER_BVC( "cn=Write" ),		/* SLAP_LAT_WRITE */
+	BER_BVC( "cn=Total" ),		/* SLAP_LAT_TOTAL */
+	BER_BVNULL
+};
+
+typedef struct monitor_latency_t {
+	slap_lat_t	ml_phase;
+	slap_op_t	ml_op;		/* if ml_be is NULL */
+	BackendDB	*ml_be;
+} monitor_latency_t;
+
 static int
 monitor_subsys_ops_destroy(
 	BackendDB		*be,
@@ -65,7 +79,7 @@ monitor_subsys_ops_init(
 	
 	Entry		*e_op;
 	monitor_entry_t	*mp;
-	int 		i;
+	int 		i, rc;
 	struct berval	bv_zero = BER_BVC( "0" );
 
 	assert( be != NULL );
@@ -137,6 +151,26 @@ monitor_subsys_ops_init(
 
 	monitor_cache_release( mi, e_op );
 
+	for ( i = 0; i < SLAP_OP_LAST; i++ ) {
+		struct berval	ndn;
+		Entry		*e;
+
+		/* these never send a result */
+		if ( i == SLAP_OP_UNBIND || i == SLAP_OP_ABANDON )
+			continue;
+
+		build_new_dn( &ndn, &ms->mss_ndn, &monitor_op[ i ].nrdn, NULL );
+		rc = monitor_cache_get( mi, &ndn, &e );
+		ch_free( ndn.bv_val );
+		if ( rc == 0 ) {
+			rc = monitor_latency_init( mi, ms, e, i, NULL );
+			monitor_cache_release( mi, e );
+		}
+		if ( rc ) {
+			return( -1 );
+		}
+	}
+
 	return( 0 );
 }
 
@@ -235,3 +269,161 @@ monitor_subsys_ops_update(
 	return SLAP_CB_CONTINUE;
 }
 
+
+static void
+monitor_latency_set( Entry *e, AttributeDescription *ad, unsigned long n )
+{
+	char		buf[ LDAP_PVT_INTTYPE_CHARS(unsigned long) ];
+	struct berval	bv;
+	Attribute	*a;
+
+	a = attr_find( e->e_attrs, ad );
+	assert( a != NULL );
+
+	bv.bv_val = buf;
+	bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", n );
+	ber_bvreplace( &a->a_vals[ 0 ], &bv );
+}
+
+static int
+monitor_latency_update(
+	Operation		*op,
+	SlapReply		*rs,
+	Entry			*e,
+	void			*priv )
+{
+	monitor_info_t		*mi = ( monitor_info_t * )op->o_bd->be_private;
+	monitor_latency_t	*ml = priv;
+	slap_latency_t		sl;
+	slap_counters_t		*sc;
+	unsigned long		n = 0, lo, hi;
+	BerVarray		vals = NULL;
+	int			i;
+
+	memset( &sl, 0, sizeof( sl ) );
+	if ( ml->ml_be ) {
+		if ( ml->ml_be->be_latency )
+			slap_latency_merge( &sl, &ml->ml_be->be_latency[ ml->ml_phase ], 1 );
+
+	} else {
+		ldap_pvt_thread_mutex_lock( &slap_counters.sc_mutex );
+		slap_latency_merge( &sl,
+			&slap_counters.sc_latency[ ml->ml_op ][ ml->ml_phase ], 1 );
+		for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next ) {
+			slap_latency_merge( &sl,
+				&sc->sc_latency[ ml->ml_op ][ ml->ml_phase ], 1 );
+		}
+		ldap_pvt_thread_mutex_unlock( &slap_counters.sc_mutex );
+	}
+
+	for ( i = 0; i < SLAP_LAT_BUCKETS; i++ ) {
+		char		buf[ 3 * LDAP_PVT_INTTYPE_CHARS(unsigned long) ];
+		struct berval	bv;
+
+		if ( !sl.sl_buckets[ i ] )
+			continue;
+		n += sl.sl_buckets[ i ];
+		slap_latency_bucket( i, &lo, &hi );
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu-%lu %lu",
+			lo, hi, sl.sl_buckets[ i ] );
+		value_add_one( &vals, &bv );
+	}
+
+	monitor_latency_set( e, mi->mi_ad_monitorCounter, n );
+	monitor_latency_set( e, mi->mi_ad_monitorLatencyP50,
+		slap_latency_percentile( &sl, 500 ) );
+	monitor_latency_set( e, mi->mi_ad_monitorLatencyP90,
+		slap_latency_percentile( &sl, 900 ) );
+	monitor_latency_set( e, mi->mi_ad_monitorLatencyP99,
+		slap_latency_percentile( &sl, 990 ) );
+	monitor_latency_set( e, mi->mi_ad_monitorLatencyP999,
+		slap_latency_percentile( &sl, 999 ) );
+
+	attr_delete( &e->e_attrs, mi->mi_ad_monitorLatencyBucket );
+	if ( vals ) {
+		attr_merge( e, mi->mi_ad_monitorLatencyBucket, vals, NULL );
+		ber_bvarray_free( vals );
+	}
+
+	return SLAP_CB_CONTINUE;
+}
+
+static int
+monitor_latency_free( Entry *e, void **priv )
+{
+	ch_free( *priv );
+	*priv = NULL;
+	return 0;
+}
+
+/*
+ * Add one child entry per latency phase below e_parent, for either
+ * operation type opidx or, if be is set, all operations on database be
+ */
+int
+monitor_latency_init(
+	monitor_info_t		*mi,
+	monitor_subsys_t	*ms,
+	Entry			*e_parent,
+	slap_op_t		opidx,
+	BackendDB		*be )
+{
+	struct berval	bv_zero = BER_BVC( "0" );
+	int		i;
+
+	for ( i = 0; i < SLAP_LAT_LAST; i++ ) {
+		Entry			*e;
+		monitor_entry_t		*mp;
+		monitor_callback_t	*cb;
+		monitor_latency_t	*ml;
+
+		e = monitor_entry_stub( &e_parent->e_name, &e_parent->e_nname,
+			&monitor_lat_rdn[ i ], mi->mi_oc_monitorLatency, NULL, NULL );
+		if ( e == NULL ) {
+			Debug( LDAP_DEBUG_ANY,
+				"monitor_latency_init: "
+				"unable to create entry \"%s,%s\"\n",
+				monitor_lat_rdn[ i ].bv_val,
+				e_parent->e_name.bv_val );
+			return( -1 );
+		}
+
+		attr_merge_one( e, mi->mi_ad_monitorCounter, &bv_zero, NULL );
+		attr_merge_one( e, mi->mi_ad_monitorLatencyP50, &bv_zero, NULL );
+		attr_merge_one( e, mi->mi_ad_monitorLatencyP90, &bv_zero, NULL );
+		attr_merge_one( e, mi->mi_ad_monitorLatencyP99, &bv_zero, NULL );
+		attr_merge_one( e, mi->mi_ad_monitorLatencyP999, &bv_zero, NULL );
+
+		ml = ch_malloc( sizeof( monitor_latency_t ) );
+		ml->ml_phase = i;
+		ml->ml_op = opidx;
+		ml->ml_be = be;
+
+		cb = ch_calloc( sizeof( monitor_callback_t ), 1 );
+		cb->mc_update = monitor_latency_update;
+		cb->mc_free = monitor_latency_free;
+		cb->mc_private = ml;
+
+		mp = monitor_entrypriv_create();
+		if ( mp == NULL ) {
+			return -1;
+		}
+		e->e_private = ( void * )mp;
+		mp->mp_info = ms;
+		mp->mp_flags = ms->mss_flags \
+			| MONITOR_F_SUB | MONITOR_F_PERSISTENT;
+		mp->mp_cb = cb;
+
+		if ( monitor_cache_add( mi, e, e_parent ) ) {
+			Debug( LDAP_DEBUG_ANY,
+				"monitor_latency_init: "
+				"unable to add entry \"%s,%s\"\n",
+				monitor_lat_rdn[ i ].bv_val,
+				e_parent->e_name.bv_val );
+			return( -1 );
+		}
+	}
+
+	return( 0 );
+}
@@ -279,6 +279,13 @@ extern int
 monitor_subsys_ops_init LDAP_P((
 	BackendDB		*be,
 	monitor_subsys_t	*ms ));
+extern int
+monitor_latency_init LDAP_P((
+	monitor_info_t		*mi,
+	monitor_subsys_t	*ms,
+	Entry			*e_parent,
+	slap_op_t		opidx,
+	BackendDB		*be ));
 
 /*
  * overlay
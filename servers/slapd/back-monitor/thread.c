@@ -33,6 +33,7 @@ typedef enum {
 	MT_UNKNOWN,
 	MT_RUNQUEUE,
 	MT_TASKLIST,
+	MT_NUMA,
 
 	MT_LAST
 } monitor_thread_t;
@@ -86,6 +87,9 @@ static struct {
 	{ BER_BVC( "cn=Tasklist" ),
 		BER_BVC("List of running plus standby threads - besides those handling operations"),
 		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_TASKLIST },
+	{ BER_BVC( "cn=NUMA" ),
+		BER_BVC("NUMA nodes with their bound threads and submitted tasks"),
+		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_NUMA },
 
 	{ BER_BVNULL }
 };
@@ -305,6 +309,28 @@ monitor_subsys_thread_update(
 			}
 			break;
 
+		case MT_NUMA:
+			if ( a != NULL ) {
+				if ( a->a_nvals != a->a_vals ) {
+					ber_bvarray_free( a->a_nvals );
+				}
+				ber_bvarray_free( a->a_vals );
+				a->a_vals = NULL;
+				a->a_nvals = NULL;
+				a->a_numvals = 0;
+			}
+
+			slap_numa_monitor( &vals );
+
+			if ( vals ) {
+				attr_merge_normalize( e, mi->mi_ad_monitoredInfo, vals, NULL );
+				ber_bvarray_free( vals );
+
+			} else {
+				attr_delete( &e->e_attrs, mi->mi_ad_monitoredInfo );
+			}
+			break;
+
 		default:
 			assert( 0 );
 		}
@@ -259,6 +259,98 @@ wt_show_key(
 	}
 }
 
+/*
+ * Exponential ("galloping") search: return the position of the first
+ * element of ids[lo..hi] that is not less than id, or hi+1 if there
+ * is none. The cost is logarithmic in the distance skipped, so walking
+ * a long list with the elements of a short one is cheap, while the
+ * first probe makes it no worse than a plain merge for lists of
+ * similar density.
+ */
+static ID
+wt_idl_gallop( ID *ids, ID lo, ID hi, ID id )
+{
+	ID step = 1, top;
+
+	if ( lo > hi || ids[lo] >= id )
+		return lo;
+
+	/* ids[lo] < id from here on */
+	while ( lo + step <= hi && ids[lo + step] < id ) {
+		lo += step;
+		step <<= 1;
+	}
+	top = lo + step <= hi ? lo + step : hi + 1;
+
+	while ( top - lo > 1 ) {
+		ID mid = lo + (( top - lo ) >> 1);
+		if ( ids[mid] < id )
+			lo = mid;
+		else
+			top = mid;
+	}
+	return top;
+}
+
+/* Lists whose sizes differ by more than this factor are intersected
+ * by galloping through the longer one.
+ */
+#define IDL_GALLOP_RATIO	16
+
+/*
+ * Intersect two non-range IDLs, leaving the result in a. Output
+ * positions never pass the input position in a, so this works in place.
+ */
+static void
+wt_idl_intersect_lists( ID *a, ID *b )
+{
+	ID na = a[0], nb = b[0];
+	ID i = 1, j = 1, c = 0;
+
+	if ( na / IDL_GALLOP_RATIO > nb ) {
+		for ( ; j <= nb; j++ ) {
+			i = wt_idl_gallop( a, i, na, b[j] );
+			if ( i > na )
+				break;
+			if ( a[i] == b[j] )
+				a[++c] = a[i++];
+		}
+
+	} else if ( nb / IDL_GALLOP_RATIO > na ) {
+		for ( ; i <= na; i++ ) {
+			j = wt_idl_gallop( b, j, nb, a[i] );
+			if ( j > nb )
+				break;
+			if ( b[j] == a[i] ) {
+				a[++c] = a[i];
+				j++;
+			}
+		}
+
+	} else {
+		/* Comparable sizes: a branch-free merge, except that a run of
+		 * IDs only one list has is skipped by galloping once its end
+		 * is known to be more than IDL_GALLOP_RATIO elements away.
+		 */
+		while ( i <= na && j <= nb ) {
+			ID ida = a[i], idb = b[j];
+			if ( i + IDL_GALLOP_RATIO <= na && a[i + IDL_GALLOP_RATIO] < idb ) {
+				i = wt_idl_gallop( a, i + IDL_GALLOP_RATIO, na, idb );
+				continue;
+			}
+			if ( j + IDL_GALLOP_RATIO <= nb && b[j + IDL_GALLOP_RATIO] < ida ) {
+				j = wt_idl_gallop( b, j + IDL_GALLOP_RATIO, nb, ida );
+				continue;
+			}
+			a[c+1] = ida;
+			c += ( ida == idb );
+			i += ( ida <= idb );
+			j += ( idb <= ida );
+		}
+	}
+	a[0] = c;
+}
+
 /*
  * idl_intersection - return a = a intersection b
  */
@@ -267,9 +359,8 @@ wt_idl_intersection(
 	ID *a,
 	ID *b )
 {
-	ID ida, idb;
 	ID idmax, idmin;
-	ID cursora = 0, cursorb = 0, cursorc;
+	ID first, last;
 	int swap = 0;
 
 	if ( WT_IDL_IS_ZERO( a ) || WT_IDL_IS_ZERO( b ) ) {
@@ -303,43 +394,26 @@ wt_idl_intersection(
 		}
 	}
 
-	/* If a range completely covers the list, the result is
-	 * just the list. If idmin to idmax is contiguous, just
-	 * turn it into a range.
-	 */
-	if ( WT_IDL_IS_RANGE( b )
-		&& WT_IDL_RANGE_FIRST( b ) <= WT_IDL_FIRST( a )
-		&& WT_IDL_RANGE_LAST( b ) >= WT_IDL_LLAST( a ) ) {
-		if (idmax - idmin + 1 == a[0])
-		{
+	if ( WT_IDL_IS_RANGE( b ) ) {
+		/* The result is the slice of the list inside the range */
+		first = wt_idl_gallop( a, 1, a[0], idmin );
+		last = wt_idl_gallop( a, first, a[0], idmax );
+		if ( last <= a[0] && a[last] == idmax )
+			last++;
+		if ( first == 1 && last > a[0] && idmax - idmin + 1 == a[0] ) {
+			/* A contiguous list covered by the range becomes a range */
 			a[0] = NOID;
 			a[1] = idmin;
 			a[2] = idmax;
-		}
-		goto done;
-	}
-
-	/* Fine, do the intersection one element at a time.
-	 * First advance to idmin in both IDLs.
-	 */
-	cursora = cursorb = idmin;
-	ida = wt_idl_first( a, &cursora );
-	idb = wt_idl_first( b, &cursorb );
-	cursorc = 0;
-
-	while( ida <= idmax || idb <= idmax ) {
-		if( ida == idb ) {
-			a[++cursorc] = ida;
-			ida = wt_idl_next( a, &cursora );
-			idb = wt_idl_next( b, &cursorb );
-		} else if ( ida < idb ) {
-			ida = wt_idl_next( a, &cursora );
 		} else {
-			idb = wt_idl_next( b, &cursorb );
+			if ( first > 1 )
+				AC_MEMCPY( a+1, a+first, ( last - first ) * sizeof(ID) );
+			a[0] = last - first;
 		}
+	} else {
+		wt_idl_intersect_lists( a, b );
 	}
-	a[0] = cursorc;
-done:
+
 	if (swap)
 		WT_IDL_CPY( b, a );
 
@@ -356,7 +430,7 @@ wt_idl_union(
 	ID	*b )
 {
 	ID ida, idb;
-	ID cursora = 0, cursorb = 0, cursorc;
+	ID na, nb, i, j, c;
 
 	if ( WT_IDL_IS_ZERO( b ) ) {
 		return 0;
@@ -376,44 +450,82 @@ over:		ida = IDL_MIN( WT_IDL_FIRST(a), WT_IDL_FIRST(b) );
 		return 0;
 	}
 
-	ida = wt_idl_first( a, &cursora );
-	idb = wt_idl_first( b, &cursorb );
+	na = a[0];
+	nb = b[0];
 
-	cursorc = b[0];
+	/* Disjoint lists are just concatenated */
+	if ( a[na] < b[1] || b[nb] < a[1] ) {
+		if ( na + nb > WT_IDL_UM_MAX )
+			goto over;
+		if ( a[na] < b[1] ) {
+			AC_MEMCPY( a+na+1, b+1, nb * sizeof(ID) );
+		} else {
+			AC_MEMCPY( a+nb+1, a+1, na * sizeof(ID) );
+			AC_MEMCPY( a+1, b+1, nb * sizeof(ID) );
+		}
+		a[0] = na + nb;
+		return 0;
+	}
 
-	/* The distinct elements of a are cat'd to b */
-	while( ida != NOID || idb != NOID ) {
-		if ( ida < idb ) {
-			if( ++cursorc > WT_IDL_UM_MAX ) {
+	if ( nb <= na ) {
+		/* The elements of b that a lacks are cat'd to b, then
+		 * merged into a from the top down.
+		 */
+		c = nb;
+		for ( i = 1, j = 1; j <= nb; j++ ) {
+			i = wt_idl_gallop( a, i, na, b[j] );
+			if ( i <= na && a[i] == b[j] ) {
+				i++;
+				continue;
+			}
+			if ( na + ++c - nb > WT_IDL_UM_MAX ) {
 				goto over;
 			}
-			b[cursorc] = ida;
-			ida = wt_idl_next( a, &cursora );
-
-		} else {
-			if ( ida == idb )
-				ida = wt_idl_next( a, &cursora );
-			idb = wt_idl_next( b, &cursorb );
+			b[c] = b[j];
 		}
+		a[0] = na + c - nb;
+		for ( i = na, j = c; j > nb; ) {
+			if ( i && a[i] > b[j] ) {
+				a[i + j - nb] = a[i];
+				i--;
+			} else {
+				a[i + j - nb] = b[j];
+				j--;
+			}
+		}
+		return 0;
 	}
 
-	/* b is copied back to a in sorted order */
-	a[0] = cursorc;
-	cursora = 1;
-	cursorb = 1;
-	cursorc = b[0]+1;
-	while (cursorb <= b[0] || cursorc <= a[0]) {
-		if (cursorc > a[0])
-			idb = NOID;
-		else
-			idb = b[cursorc];
-		if (cursorb <= b[0] && b[cursorb] < idb)
-			a[cursora++] = b[cursorb++];
-		else {
-			a[cursora++] = idb;
-			cursorc++;
+	/* The distinct elements of a are cat'd to b */
+	c = nb;
+	for ( i = 1, j = 1; i <= na; i++ ) {
+		j = wt_idl_gallop( b, j, nb, a[i] );
+		if ( j <= nb && b[j] == a[i] ) {
+			j++;
+			continue;
 		}
-	}
+		if ( ++c > WT_IDL_UM_MAX ) {
+			goto over;
+		}
+		b[c] = a[i];
+	}
+
+	/* b is merged back into a in sorted order */
+	a[0] = c;
+	i = 1;
+	j = nb + 1;
+	na = 0;
+	while ( i <= nb && j <= c ) {
+		ida = b[i];
+		idb = b[j];
+		a[++na] = ida < idb ? ida : idb;
+		i += ( ida < idb );
+		j += ( idb < ida );
+	}
+	if ( i <= nb )
+		AC_MEMCPY( a+na+1, b+i, ( nb - i + 1 ) * sizeof(ID) );
+	else if ( j <= c )
+		AC_MEMCPY( a+na+1, b+j, ( c - j + 1 ) * sizeof(ID) );
 
 	return 0;
 }
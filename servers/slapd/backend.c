@@ -482,6 +482,8 @@ void backend_destroy_one( BackendDB *bd, int dynamic )
 	}
 
 	ldap_pvt_thread_mutex_destroy( &bd->be_pcsn_st.be_pcsn_mutex );
+	ch_free( bd->be_latency );
+	bd->be_latency = NULL;
 
 	if ( dynamic ) {
 		free( bd );
@@ -620,6 +622,7 @@ backend_db_init(
 
 	ldap_pvt_thread_mutex_init( &be->be_pcsn_st.be_pcsn_mutex );
 	be->be_pcsn_p = &be->be_pcsn_st;
+	be->be_latency = ch_calloc( SLAP_LAT_LAST, sizeof(slap_latency_t) );
 
  	/* assign a default depth limit for alias deref */
 	be->be_max_deref_depth = SLAPD_DEFAULT_MAXDEREFDEPTH; 
@@ -634,6 +637,7 @@ backend_db_init(
 		if ( !b0 ) {
 			LDAP_STAILQ_REMOVE(&backendDB, be, BackendDB, be_next);
 			ldap_pvt_thread_mutex_destroy( &be->be_pcsn_st.be_pcsn_mutex );
+			ch_free( be->be_latency );
 			ch_free( be );
 			be = NULL;
 			nbackends--;
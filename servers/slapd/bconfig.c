@@ -197,6 +197,8 @@ enum {
 	CFG_IX_HASH64,
 	CFG_DISABLED,
 	CFG_THREADQS,
+	CFG_THREADSTEAL,
+	CFG_NUMA,
 	CFG_TLS_ECNAME,
 	CFG_TLS_CACERT,
 	CFG_TLS_CERT,
@@ -306,6 +308,10 @@ static ConfigTable config_back_cf_table[] = {
 			"DESC 'Access Control List' "
 			"EQUALITY caseIgnoreMatch "
 			"SYNTAX OMsDirectoryString X-ORDERED 'VALUES' )", NULL, NULL },
+	{ "acl-cache", "on|off", 2, 2, 0, ARG_ON_OFF,
+		&slap_acl_cache, "( OLcfgGlAt:108 NAME 'olcAclCache' "
+			"EQUALITY booleanMatch "
+			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
 	{ "add_content_acl",	NULL, 0, 0, 0, ARG_MAY_DB|ARG_ON_OFF|ARG_MAGIC|CFG_ACL_ADD,
 		&config_generic, "( OLcfgGlAt:86 NAME 'olcAddContentAcl' "
 			"DESC 'Check ACLs against content of Add ops' "
@@ -539,6 +545,10 @@ static ConfigTable config_back_cf_table[] = {
 		"( OLcfgDbAt:0.18 NAME 'olcMonitoring' "
 			"EQUALITY booleanMatch "
 			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "numa", "none|local", 2, 2, 0, ARG_MAGIC|CFG_NUMA,
+		&config_generic, "( OLcfgGlAt:107 NAME 'olcNuma' "
+			"EQUALITY caseIgnoreMatch "
+			"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
 	{ "objectclass", "objectclass", 2, 0, 0, ARG_PAREN|ARG_MAGIC|CFG_OC,
 		&config_generic, "( OLcfgGlAt:32 NAME 'olcObjectClasses' "
 		"DESC 'OpenLDAP object classes' "
@@ -777,6 +787,11 @@ static ConfigTable config_back_cf_table[] = {
 			"SYNTAX OMsInteger SINGLE-VALUE )", NULL,
 			{ .v_int = 1 }
 	},
+	{ "threadsteal", "on|off", 2, 2, 0,
+		ARG_ON_OFF|ARG_MAGIC|CFG_THREADSTEAL, &config_generic,
+		"( OLcfgGlAt:106 NAME 'olcThreadSteal' "
+			"EQUALITY booleanMatch "
+			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
 	{ "timelimit", "limit", 2, 0, 0, ARG_MAY_DB|ARG_MAGIC,
 		&config_timelimit, "( OLcfgGlAt:67 NAME 'olcTimeLimit' "
 			"EQUALITY caseExactMatch "
@@ -935,6 +950,10 @@ static ConfigTable config_back_cf_table[] = {
 		&config_updateref, "( OLcfgDbAt:0.13 NAME 'olcUpdateRef' "
 			"EQUALITY caseIgnoreMatch "
 			"SUP labeledURI )", NULL, NULL },
+	{ "writebatch", "size", 2, 2, 0, ARG_BER_LEN_T,
+		&global_writebatch, "( OLcfgGlAt:105 NAME 'olcWriteBatch' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "writetimeout", "timeout", 2, 2, 0, ARG_INT,
 		&global_writetimeout, "( OLcfgGlAt:88 NAME 'olcWriteTimeout' "
 			"EQUALITY integerMatch "
@@ -981,7 +1000,7 @@ static ConfigOCs cf_ocs[] = {
 		"NAME 'olcGlobal' "
 		"DESC 'OpenLDAP Global configuration options' "
 		"SUP olcConfig STRUCTURAL "
-		"MAY ( cn $ olcConfigFile $ olcConfigDir $ olcAllows $ olcArgsFile $ "
+		"MAY ( cn $ olcConfigFile $ olcConfigDir $ olcAclCache $ olcAllows $ olcArgsFile $ "
 		 "olcAttributeOptions $ olcAuthIDRewrite $ "
 		 "olcAuthzPolicy $ olcAuthzRegexp $ olcConcurrency $ "
 		 "olcConnMaxPending $ olcConnMaxPendingAuth $ "
@@ -990,7 +1009,7 @@ static ConfigOCs cf_ocs[] = {
 		 "olcIndexSubstrAnyLen $ olcIndexSubstrAnyStep $ olcIndexHash64 $ "
 		 "olcIndexIntLen $ "
 		 "olcListenerThreads $ olcLocalSSF $ olcLogFile $ olcLogFileFormat $ olcLogLevel $ "
-		 "olcLogFileOnly $ olcLogFileRotate $ olcMaxFilterDepth $ "
+		 "olcLogFileOnly $ olcLogFileRotate $ olcMaxFilterDepth $ olcNuma $ "
 		 "olcPasswordCryptSaltFormat $ olcPasswordHash $ olcPidFile $ "
 		 "olcPluginLogFile $ olcReadOnly $ olcReferral $ "
 		 "olcReplogFile $ olcRequires $ olcRestrict $ olcReverseLookup $ "
@@ -1000,13 +1019,13 @@ static ConfigOCs cf_ocs[] = {
 		 "olcSecurity $ olcServerID $ olcSizeLimit $ "
 		 "olcSockbufMaxIncoming $ olcSockbufMaxIncomingAuth $ "
 		 "olcTCPBuffer $ "
-		 "olcThreads $ olcThreadQueues $ "
+		 "olcThreads $ olcThreadQueues $ olcThreadSteal $ "
 		 "olcTimeLimit $ olcTLSCACertificateFile $ "
 		 "olcTLSCACertificatePath $ olcTLSCertificateFile $ "
 		 "olcTLSCertificateKeyFile $ olcTLSCipherSuite $ olcTLSCRLCheck $ "
 		 "olcTLSCACertificate $ olcTLSCertificate $ olcTLSCertificateKey $ "
 		 "olcTLSRandFile $ olcTLSVerifyClient $ olcTLSDHParamFile $ olcTLSECName $ "
-		 "olcTLSCRLFile $ olcTLSProtocolMin $ olcToolThreads $ olcWriteTimeout $ "
+		 "olcTLSCRLFile $ olcTLSProtocolMin $ olcToolThreads $ olcWriteBatch $ olcWriteTimeout $ "
 		 "olcObjectIdentifier $ olcAttributeTypes $ olcObjectClasses $ "
 		 "olcDitContentRules $ olcLdapSyntaxes ) )", Cft_Global },
 	{ "( OLcfgGlOc:2 "
@@ -1132,6 +1151,18 @@ config_generic(ConfigArgs *c) {
 		case CFG_THREADQS:
 			c->value_int = connection_pool_queues;
 			break;
+		case CFG_THREADSTEAL:
+			c->value_int = connection_pool_steal;
+			break;
+		case CFG_NUMA:
+			if ( slap_numa_policy != SLAP_NUMA_NONE ) {
+				struct berval bv;
+				enum_to_verb( slap_numa_policies, slap_numa_policy, &bv );
+				value_add_one( &c->rvalue_vals, &bv );
+			} else {
+				rc = 1;
+			}
+			break;
 		case CFG_TTHREADS:
 			c->value_int = slap_tool_thread_max;
 			break;
@@ -1490,6 +1521,16 @@ config_generic(ConfigArgs *c) {
 			connection_pool_queues = 1;	/* save for reference */
 			break;
 
+		case CFG_THREADSTEAL:
+			if ( slapMode & SLAP_SERVER_MODE )
+				ldap_pvt_thread_pool_steal(&connection_pool, 0);
+			connection_pool_steal = 0;	/* save for reference */
+			break;
+
+		case CFG_NUMA:
+			slap_numa_config( SLAP_NUMA_NONE, c->cr_msg, sizeof( c->cr_msg ));
+			break;
+
 		case CFG_TTHREADS:
 			slap_tool_thread_max = 1;
 			break;
@@ -1948,6 +1989,29 @@ config_generic(ConfigArgs *c) {
 			connection_pool_queues = c->value_int;	/* save for reference */
 			break;
 
+		case CFG_THREADSTEAL:
+			if ( slapMode & SLAP_SERVER_MODE )
+				ldap_pvt_thread_pool_steal(&connection_pool, c->value_int);
+			connection_pool_steal = c->value_int;	/* save for reference */
+			break;
+
+		case CFG_NUMA:
+			i = verb_to_mask( c->argv[1], slap_numa_policies );
+			if ( BER_BVISNULL( &slap_numa_policies[ i ].word ) ) {
+				snprintf( c->cr_msg, sizeof( c->cr_msg ),
+					"<%s> unknown policy", c->argv[0] );
+				Debug( LDAP_DEBUG_ANY, "%s: %s \"%s\"\n",
+					c->log, c->cr_msg, c->argv[1] );
+				return 1;
+			}
+			if ( slap_numa_config( slap_numa_policies[ i ].mask,
+				c->cr_msg, sizeof( c->cr_msg ))) {
+				Debug( LDAP_DEBUG_ANY, "%s: %s.\n",
+					c->log, c->cr_msg );
+				return 1;
+			}
+			break;
+
 		case CFG_TTHREADS:
 			if ( slapMode & SLAP_TOOL_MODE )
 				ldap_pvt_thread_pool_maxthreads(&connection_pool, c->value_int);
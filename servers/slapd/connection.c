@@ -49,6 +49,17 @@
 
 static Connection *connections = NULL;
 
+/*
+ * The connections[] array is allocated once and never moves, so a slot
+ * may be inspected without its c_mutex. Such reads are only hints used
+ * to skip slots; anything acted upon is checked again under c_mutex.
+ */
+#ifdef __GNUC__
+#define CONN_PEEK(p)	__atomic_load_n( &(p), __ATOMIC_RELAXED )
+#else
+#define CONN_PEEK(p)	(p)
+#endif
+
 static ldap_pvt_thread_mutex_t conn_nextid_mutex;
 static unsigned long conn_nextid = SLAPD_SYNC_SYNCCONN_OFFSET;
 
@@ -106,6 +117,7 @@ int connections_init(void)
 
 	/* should check return of every call */
 	ldap_pvt_thread_mutex_init( &conn_nextid_mutex );
+	slap_writebatch_init();
 
 	connections = (Connection *) ch_calloc( dtblsize, sizeof(Connection) );
 
@@ -147,6 +159,8 @@ int connections_destroy(void)
 		return -1;
 	}
 
+	slap_writebatch_destroy();
+
 	for ( i = 0; i < dtblsize; i++ ) {
 		ldap_pvt_thread_mutex_destroy( &connections[i].c_mutex );
 		ldap_pvt_thread_mutex_destroy( &connections[i].c_write1_mutex );
@@ -205,28 +219,52 @@ int connections_timeout_idle(time_t now)
 	ber_socket_t connindex;
 	Connection* c;
 
-	for( c = connection_first( &connindex );
-		c != NULL;
-		c = connection_next( c, &connindex ) )
-	{
+	if ( !global_idletimeout )
+		return 0;
+
+	/*
+	 * This runs on a listener thread, so it must not wait on a
+	 * connection that a worker is busy with. Slots are screened
+	 * without their c_mutex and only those that look idle are
+	 * locked, with a trylock: a held c_mutex means the connection
+	 * is in use right now. Such a connection is skipped, not waited
+	 * for; nothing is recorded about it, so if it is still idle it
+	 * is closed by the next sweep, a quarter of idletimeout later.
+	 */
+	for( connindex = 0; connindex < dtblsize; connindex++ ) {
+		c = &connections[connindex];
+
 		/* Don't timeout a slow-running request or a persistent
 		 * outbound connection.
 		 */
-		if( c->c_n_ops_executing || c->c_n_ops_async
-			|| c->c_conn_state == SLAP_C_CLIENT ) {
+		switch( CONN_PEEK( c->c_conn_state ) ) {
+		case SLAP_C_INVALID:
+		case SLAP_C_CLIENT:
+			continue;
+		default:
+			break;
+		}
+		if( CONN_PEEK( c->c_n_ops_executing ) ||
+			CONN_PEEK( c->c_n_ops_async ) ||
+			difftime( CONN_PEEK( c->c_activitytime ) + global_idletimeout,
+				now ) >= 0 ) {
 			continue;
 		}
 
-		if( global_idletimeout && 
+		if( ldap_pvt_thread_mutex_trylock( &c->c_mutex ) )
+			continue;
+
+		if( c->c_conn_state != SLAP_C_INVALID &&
+			c->c_conn_state != SLAP_C_CLIENT &&
+			!c->c_n_ops_executing && !c->c_n_ops_async &&
 			difftime( c->c_activitytime+global_idletimeout, now) < 0 ) {
 			/* close it */
 			connection_closing( c, "idletimeout" );
 			connection_close( c );
 			i++;
-			continue;
 		}
+		ldap_pvt_thread_mutex_unlock( &c->c_mutex );
 	}
-	connection_done( c );
 
 	return i;
 }
@@ -378,6 +416,7 @@ Connection * connection_init(
 		}
 
 		c->c_currentber = NULL;
+		c->c_wber = NULL;
 
 #ifdef LDAP_SLAPI
 		if ( slapi_plugins_used ) {
@@ -405,6 +444,7 @@ Connection * connection_init(
 	assert( c->c_sasl_bindop == NULL );
 	assert( c->c_sasl_cbind == NULL );
 	assert( c->c_currentber == NULL );
+	assert( c->c_wber == NULL );
 	assert( c->c_writewaiter == 0);
 	assert( c->c_writers == 0);
 
@@ -634,6 +674,10 @@ connection_destroy( Connection *c )
 		ber_free( c->c_currentber, 1 );
 		c->c_currentber = NULL;
 	}
+	if ( c->c_wber != NULL ) {
+		ber_free( c->c_wber, 1 );
+		c->c_wber = NULL;
+	}
 
 
 #ifdef LDAP_SLAPI
@@ -870,7 +914,9 @@ Connection* connection_next( Connection *c, ber_socket_t *index )
 	c = NULL;
 
 	for(; *index < dtblsize; (*index)++) {
-		if( connections[*index].c_sb ) {
+		/* Skip closed slots without touching their c_mutex */
+		if( connections[*index].c_sb &&
+			CONN_PEEK( connections[*index].c_conn_state ) != SLAP_C_INVALID ) {
 			c = &connections[*index];
 			ldap_pvt_thread_mutex_lock( &c->c_mutex );
 			if ( c->c_conn_state == SLAP_C_INVALID ) {
@@ -957,6 +1003,8 @@ conn_counter_destroy( void *key, void *data )
 				ldap_pvt_mp_add( slap_counters.sc_ops_initiated_[ i ], sc->sc_ops_initiated_[ i ] );
 				ldap_pvt_mp_add( slap_counters.sc_ops_initiated_[ i ], sc->sc_ops_completed_[ i ] );
 			}
+			slap_latency_merge( slap_counters.sc_latency[0], sc->sc_latency[0],
+				SLAP_OP_LAST * SLAP_LAT_LAST );
 			slap_counters_destroy( sc );
 			ber_memfree_x( data, NULL );
 			break;
@@ -1027,6 +1075,9 @@ connection_operation( void *ctx, void *arg_v )
 	void *memctx_null = NULL;
 	ber_len_t memsiz;
 
+	if ( slap_numa_active )
+		slap_numa_worker( ctx );
+
 	gettimeofday( &op->o_qtime, NULL );
 	op->o_qtime.tv_usec -= op->o_tusec;
 	if ( op->o_qtime.tv_usec < 0 ) {
@@ -1109,6 +1160,9 @@ connection_operation( void *ctx, void *arg_v )
 	}
 	}
 
+	if ( slap_acl_cache )
+		acl_cache_alloc( op );
+
 	opidx = slap_req2op( tag );
 	assert( opidx != SLAP_OP_LAST );
 	INCR_OP_INITIATED( opidx );
@@ -1252,6 +1306,9 @@ static void* connection_read_thread( void* ctx, void* argv )
 	conn_readinfo cri = { NULL, NULL, NULL, NULL, 0 };
 	ber_socket_t s = (long)argv;
 
+	if ( slap_numa_active )
+		slap_numa_worker( ctx );
+
 	/*
 	 * read incoming LDAP requests. If there is more than one,
 	 * the first one is returned with new_op
@@ -1285,8 +1342,7 @@ int connection_read_activate( ber_socket_t s )
 	if ( rc )
 		return rc;
 
-	rc = ldap_pvt_thread_pool_submit( &connection_pool,
-		connection_read_thread, (void *)(long)s );
+	rc = slap_numa_submit( s, connection_read_thread, (void *)(long)s );
 
 	if( rc != 0 ) {
 		Debug( LDAP_DEBUG_ANY,
@@ -1708,7 +1764,7 @@ connection_input( Connection *conn , conn_readinfo *cri )
 		} else {
 			if ( !cri->nullop ) {
 				cri->nullop = 1;
-				rc = ldap_pvt_thread_pool_submit( &connection_pool,
+				rc = slap_numa_submit( conn->c_sd,
 					connection_operation, (void *) cri->op );
 			}
 			connection_op_activate( op );
@@ -1891,7 +1947,7 @@ static int connection_op_activate( Operation *op )
 
 	connection_op_queue( op );
 
-	rc = ldap_pvt_thread_pool_submit( &connection_pool,
+	rc = slap_numa_submit( op->o_conn->c_sd,
 		connection_operation, (void *) op );
 
 	if ( rc != 0 ) {
@@ -1998,6 +2054,40 @@ void connection_write_resume( Connection *c )
 	connection_return( c );
 }
 
+/*
+ * Compress everything written to c from now on. This is only done
+ * when the caller's operation is the only one on the connection and
+ * nothing is being written, so that the client can tell exactly which
+ * PDU is the first compressed one. Returns 0 if compression is on.
+ */
+int connection_compress( Connection *c )
+{
+	int rc = -1;
+
+	/* internal operations have no socket to compress */
+	if ( c->c_conn_idx < 0 || c->c_sb == NULL )
+		return -1;
+
+	ldap_pvt_thread_mutex_lock( &c->c_mutex );
+	if ( c->c_conn_state == SLAP_C_ACTIVE && c->c_n_ops_executing == 1 &&
+		c->c_n_ops_pending == 0 && c->c_n_ops_async == 0 )
+	{
+		/* don't wait for writers here, we hold c_mutex */
+		ldap_pvt_thread_mutex_lock( &c->c_write1_mutex );
+		if ( !c->c_writing && c->c_writers == 0 && c->c_wber == NULL ) {
+			rc = ldap_pvt_compress_install( c->c_sb, LDAP_PVT_COMPRESS_WRITE );
+			if ( rc == LDAP_ALREADY_EXISTS )
+				rc = LDAP_SUCCESS;
+		}
+		ldap_pvt_thread_mutex_unlock( &c->c_write1_mutex );
+	}
+	ldap_pvt_thread_mutex_unlock( &c->c_mutex );
+
+	Debug( LDAP_DEBUG_TRACE, "connection_compress: conn=%lu %s\n",
+		c->c_connid, rc ? "declined" : "compressing" );
+	return rc ? -1 : 0;
+}
+
 #ifdef LDAP_SLAPI
 typedef struct conn_fake_extblock {
 	void *eb_conn;
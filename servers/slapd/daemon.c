@@ -91,6 +91,7 @@ struct runqueue_s slapd_rq = {
 
 int slapd_daemon_threads = 1;
 int slapd_daemon_mask;
+int slapd_listener_shards;
 
 #ifdef LDAP_TCP_BUFFER
 int slapd_tcp_rmem;
@@ -104,7 +105,11 @@ static volatile sig_atomic_t listening = 1; /* 0 when slap_listeners closed */
 #define SLAPD_LISTEN_BACKLOG 2048
 #endif /* ! SLAPD_LISTEN_BACKLOG */
 
-#define	DAEMON_ID(fd)	(fd & slapd_daemon_mask)
+/* With SO_REUSEPORT listener shards, sockets belong to the thread that
+ * accepted them instead of being hashed by descriptor.
+ */
+static int *sd_owner;
+#define	DAEMON_ID(fd)	(sd_owner ? sd_owner[(fd)] : ((fd) & slapd_daemon_mask))
 
 typedef ber_socket_t sdpair[2];
 
@@ -1506,6 +1511,83 @@ errexit:
 	return -1;
 }
 
+#ifdef SO_REUSEPORT
+/* Open the other SO_REUSEPORT shards of listener li, bound to the same
+ * address; the kernel balances incoming connections across them.
+ */
+static void
+slap_open_shards(
+	Listener *li,
+	int addrlen,
+	int *listeners,
+	int *cur )
+{
+	Listener *sh;
+	ber_socket_t s;
+	int i, rc, tmp;
+	char ebuf[128];
+
+	for ( i = 1; i < slapd_listener_shards; i++ ) {
+		s = socket( li->sl_sa.sa_addr.sa_family, SOCK_STREAM, 0 );
+		if ( s == AC_SOCKET_INVALID ) {
+			int err = sock_errno();
+			Debug( LDAP_DEBUG_ANY,
+				"daemon: shard socket() failed errno=%d (%s)\n",
+				err, sock_errstr(err, ebuf, sizeof(ebuf)) );
+			break;
+		}
+		if ( SLAP_SOCKNEW( s ) >= dtblsize ) {
+			Debug( LDAP_DEBUG_ANY,
+				"daemon: listener descriptor %ld is too great %ld\n",
+				(long) SLAP_SOCKNEW( s ), (long) dtblsize );
+			tcp_close( s );
+			break;
+		}
+
+		tmp = 1;
+#ifdef SO_REUSEADDR
+		(void) setsockopt( s, SOL_SOCKET, SO_REUSEADDR,
+			(char *) &tmp, sizeof(tmp) );
+#endif /* SO_REUSEADDR */
+#if defined(LDAP_PF_INET6) && defined(IPV6_V6ONLY)
+		if ( li->sl_sa.sa_addr.sa_family == AF_INET6 ) {
+			(void) setsockopt( s, IPPROTO_IPV6, IPV6_V6ONLY,
+				(char *) &tmp, sizeof(tmp) );
+		}
+#endif /* LDAP_PF_INET6 && IPV6_V6ONLY */
+		rc = setsockopt( s, SOL_SOCKET, SO_REUSEPORT,
+			(char *) &tmp, sizeof(tmp) );
+		if ( rc == 0 ) {
+			rc = bind( s, &li->sl_sa.sa_addr, addrlen );
+		}
+		if ( rc ) {
+			int err = sock_errno();
+			Debug( LDAP_DEBUG_ANY,
+				"daemon: shard %d of %s failed errno=%d (%s)\n",
+				i, li->sl_name.bv_val, err,
+				sock_errstr(err, ebuf, sizeof(ebuf)) );
+			tcp_close( s );
+			break;
+		}
+
+		(*listeners)++;
+		slap_listeners = ch_realloc( slap_listeners,
+			(*listeners + 1) * sizeof(Listener *) );
+		sh = ch_malloc( sizeof( Listener ) );
+		*sh = *li;
+		sh->sl_sd = SLAP_SOCKNEW( s );
+		sh->sl_shard = i;
+		ber_dupbv( &sh->sl_url, &li->sl_url );
+		ber_dupbv( &sh->sl_name, &li->sl_name );
+		slap_listeners[*cur] = sh;
+		(*cur)++;
+	}
+
+	Debug( LDAP_DEBUG_TRACE, "daemon: %s opened with %d shards\n",
+		li->sl_name.bv_val, i );
+}
+#endif /* SO_REUSEPORT */
+
 static int
 slap_open_listener(
 	const char* url,
@@ -1542,6 +1624,7 @@ slap_open_listener(
 	l.sl_url.bv_val = NULL;
 	l.sl_mute = 0;
 	l.sl_busy = 0;
+	l.sl_shard = -1;
 
 #ifndef HAVE_TLS
 	if( ldap_pvt_url_scheme2tls( lud->lud_scheme ) ) {
@@ -1651,6 +1734,7 @@ slap_open_listener(
 		if( l.sl_is_udp ) socktype = SOCK_DGRAM;
 #endif /* LDAP_CONNECTIONLESS */
 
+		l.sl_shard = -1;
 		s = socket( (*sal)->sa_family, socktype, 0);
 		if ( s == AC_SOCKET_INVALID ) {
 			int err = sock_errno();
@@ -1689,6 +1773,21 @@ slap_open_listener(
 					(long) l.sl_sd, err, sock_errstr(err, ebuf, sizeof(ebuf)) );
 			}
 #endif /* SO_REUSEADDR */
+#ifdef SO_REUSEPORT
+			if ( slapd_listener_shards > 1 && socktype == SOCK_STREAM ) {
+				tmp = 1;
+				rc = setsockopt( s, SOL_SOCKET, SO_REUSEPORT,
+					(char *) &tmp, sizeof(tmp) );
+				if ( rc == AC_SOCKET_ERROR ) {
+					int err = sock_errno();
+					Debug( LDAP_DEBUG_ANY, "slapd(%ld): "
+						"setsockopt(SO_REUSEPORT) failed errno=%d (%s)\n",
+						(long) l.sl_sd, err, sock_errstr(err, ebuf, sizeof(ebuf)) );
+				} else {
+					l.sl_shard = 0;
+				}
+			}
+#endif /* SO_REUSEPORT */
 		}
 
 		switch( (*sal)->sa_family ) {
@@ -1826,6 +1925,11 @@ slap_open_listener(
 		*li = l;
 		slap_listeners[*cur] = li;
 		(*cur)++;
+#ifdef SO_REUSEPORT
+		if ( li->sl_shard == 0 ) {
+			slap_open_shards( li, addrlen, listeners, cur );
+		}
+#endif /* SO_REUSEPORT */
 		sal++;
 	}
 
@@ -1847,6 +1951,30 @@ static int sockdestroy(void);
 
 static int daemon_inited = 0;
 
+/* "-o reuseport=<shards>" */
+int
+slapd_opt_reuseport( const char *val, void *arg )
+{
+	int shards;
+
+	if ( val == NULL || strcasecmp( val, "off" ) == 0 ) {
+		shards = 0;
+
+	} else if ( lutil_atoi( &shards, val ) != 0 || shards < 0 ) {
+		fprintf( stderr, "unrecognized value \"%s\" for reuseport option\n", val );
+		return -1;
+	}
+
+#ifndef SO_REUSEPORT
+	if ( shards > 1 ) {
+		fputs( "slapd: SO_REUSEPORT is not available\n", stderr );
+		shards = 0;
+	}
+#endif
+	slapd_listener_shards = shards;
+	return 0;
+}
+
 int
 slapd_daemon_init( const char *urls )
 {
@@ -1883,6 +2011,9 @@ slapd_daemon_init( const char *urls )
 
 	SETUP_CLOSE();
 
+	if ( slapd_listener_shards > 1 )
+		sd_owner = ch_calloc( dtblsize, sizeof(int) );
+
 	/* open a pipe (or something equivalent connected to itself).
 	 * we write a byte on this fd whenever we catch a signal. The main
 	 * loop will be select'ing on this socket, and will wake up when
@@ -1975,8 +2106,11 @@ slapd_socket_realloc( int newnum )
 
 		oldid = DAEMON_ID(i);
 		newid = i & newmask;
-		if ( oldid == newid ) continue;
-		if ( !SLAP_SOCK_IS_ACTIVE( oldid, i )) continue;
+		if ( !SLAP_SOCK_IS_ACTIVE( oldid, i )) {
+			if ( sd_owner ) sd_owner[i] = newid;
+			continue;
+		}
+		if ( sd_owner ) newid = oldid & newmask;
 		sl = NULL;
 		if ( num_listeners ) {
 			for ( j=0; slap_listeners[j] != NULL; j++ ) {
@@ -1987,6 +2121,9 @@ slapd_socket_realloc( int newnum )
 				}
 			}
 		}
+		if ( sl && sl->sl_shard >= 0 ) newid = sl->sl_shard & newmask;
+		if ( oldid == newid ) continue;
+		if ( sd_owner ) sd_owner[i] = newid;
 		SLAP_SOCK_ADD( newid, i, sl );
 		if ( SLAP_SOCK_IS_READ( oldid, i )) {
 			SLAP_SOCK_SET_READ( newid, i );
@@ -2026,6 +2163,10 @@ slapd_daemon_destroy( void )
 			SLAP_SOCK_DESTROY(i);
 		}
 		daemon_inited = 0;
+		if ( sd_owner ) {
+			ch_free( sd_owner );
+			sd_owner = NULL;
+		}
 		ldap_pvt_thread_mutex_destroy( &emfile_mutex );
 #ifdef HAVE_TCPD
 		ldap_pvt_thread_mutex_destroy( &sd_tcpd_mutex );
@@ -2189,6 +2330,11 @@ slap_listener(
 		ldap_pvt_thread_yield();
 		return 0;
 	}
+	if ( sd_owner ) {
+		/* connections accepted on a shard stay with its thread */
+		sd_owner[sfd] = sl->sl_shard >= 0 ?
+			DAEMON_ID( sl->sl_sd ) : ( sfd & slapd_daemon_mask );
+	}
 	tid = DAEMON_ID(sfd);
 
 #ifdef LDAP_DEBUG
@@ -2409,8 +2555,7 @@ slap_listener_activate(
 
 	sl->sl_busy = 1;
 
-	rc = ldap_pvt_thread_pool_submit( &connection_pool,
-		slap_listener_thread, (void *) sl );
+	rc = slap_numa_submit( sl->sl_sd, slap_listener_thread, (void *) sl );
 
 	if( rc != 0 ) {
 		Debug( LDAP_DEBUG_ANY,
@@ -2444,6 +2589,7 @@ slapd_daemon_task(
 
 #define SLAPD_IDLE_CHECK_LIMIT 4
 
+	slap_numa_listener( tid );
 	slapd_add( wake_sds[tid][0], 0, NULL, tid );
 	if ( tid )
 		goto loop;
@@ -3208,6 +3354,13 @@ slapd_daemon_tid_cleanup(
 	return NULL;
 }
 
+/* Listener thread that watches descriptor s */
+int
+slapd_daemon_owner( ber_socket_t s )
+{
+	return DAEMON_ID( s );
+}
+
 int
 slapd_daemon_resize( int newnum )
 {
@@ -3333,6 +3486,16 @@ slapd_daemon( void )
 
 	SLAP_SOCK_INIT2();
 
+	/* listener-threads is known now, spread the shards over them */
+	if ( sd_owner ) {
+		for ( i=0; slap_listeners[i] != NULL; i++ ) {
+			Listener *sl = slap_listeners[i];
+
+			if ( sl->sl_shard >= 0 && sl->sl_sd != AC_SOCKET_INVALID )
+				sd_owner[sl->sl_sd] = sl->sl_shard & slapd_daemon_mask;
+		}
+	}
+
 	/* daemon_init only inits element 0 */
 	for ( i=1; i<slapd_daemon_threads; i++ )
 	{
@@ -373,13 +373,13 @@ fail:
 #define GRABSIZE	BUFSIZ
 
 #define MAKE_SPACE( n )	{ \
-		while ( ecur + (n) > ebuf + emaxsize ) { \
+		while ( cur + (n) > buf->bv_val + buf->bv_len ) { \
 			ptrdiff_t	offset; \
-			offset = (int) (ecur - ebuf); \
-			ebuf = ch_realloc( ebuf, \
-				emaxsize + GRABSIZE ); \
-			emaxsize += GRABSIZE; \
-			ecur = ebuf + offset; \
+			offset = (int) (cur - buf->bv_val); \
+			buf->bv_val = ch_realloc( buf->bv_val, \
+				buf->bv_len + GRABSIZE ); \
+			buf->bv_len += GRABSIZE; \
+			cur = buf->bv_val + offset; \
 		} \
 	}
 
@@ -397,13 +397,41 @@ entry2str_wrap(
 	Entry		*e,
 	int			*len,
 	ber_len_t	wrap )
+{
+	struct berval	buf;
+	char		*s;
+
+	buf.bv_val = ebuf;
+	buf.bv_len = emaxsize;
+	s = entry2str_wrap_r( e, &buf, len, wrap );
+	ebuf = buf.bv_val;
+	emaxsize = buf.bv_len;
+	ecur = ebuf + *len;
+
+	return( s );
+}
+
+/*
+ * Like entry2str_wrap(), but formats into the caller's buffer instead
+ * of the shared static one, so that several threads can encode entries
+ * at once. buf->bv_val/bv_len are the buffer and its allocated size;
+ * the buffer is grown with ch_realloc() as needed and may start empty.
+ */
+char *
+entry2str_wrap_r(
+	Entry		*e,
+	struct berval	*buf,
+	int			*len,
+	ber_len_t	wrap )
 {
 	Attribute	*a;
 	struct berval	*bv;
 	int		i;
 	ber_len_t tmplen;
+	char		*cur;
 
 	assert( e != NULL );
+	assert( buf != NULL );
 
 	/*
 	 * In string format, an entry looks like this:
@@ -411,14 +439,14 @@ entry2str_wrap(
 	 *	[<attr>: <value>\n]*
 	 */
 
-	ecur = ebuf;
+	cur = buf->bv_val;
 
 	/* put the dn */
 	if ( e->e_dn != NULL ) {
 		/* put "dn: <dn>" */
 		tmplen = e->e_name.bv_len;
 		MAKE_SPACE( LDIF_SIZE_NEEDED( 2, tmplen ));
-		ldif_sput_wrap( &ecur, LDIF_PUT_VALUE, "dn", e->e_dn, tmplen, wrap );
+		ldif_sput_wrap( &cur, LDIF_PUT_VALUE, "dn", e->e_dn, tmplen, wrap );
 	}
 
 	/* put the attributes */
@@ -428,16 +456,16 @@ entry2str_wrap(
 			bv = &a->a_vals[i];
 			tmplen = a->a_desc->ad_cname.bv_len;
 			MAKE_SPACE( LDIF_SIZE_NEEDED( tmplen, bv->bv_len ));
-			ldif_sput_wrap( &ecur, LDIF_PUT_VALUE,
+			ldif_sput_wrap( &cur, LDIF_PUT_VALUE,
 				a->a_desc->ad_cname.bv_val,
 				bv->bv_val, bv->bv_len, wrap );
 		}
 	}
 	MAKE_SPACE( 1 );
-	*ecur = '\0';
-	*len = ecur - ebuf;
+	*cur = '\0';
+	*len = cur - buf->bv_val;
 
-	return( ebuf );
+	return( buf->bv_val );
 }
 
 void
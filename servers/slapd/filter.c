@@ -194,7 +194,7 @@ get_filter0(
 		}
 
 		f.f_desc = NULL;
-		err = slap_bv2ad( &type, &f.f_desc, text );
+		err = slap_bv2ad_cached( op->o_threadctx, &type, &f.f_desc, text );
 
 		if( err != LDAP_SUCCESS ) {
 			f.f_choice |= SLAPD_FILTER_UNDEFINED;
@@ -386,7 +386,7 @@ get_ssa(
 	ssa.sa_any = NULL;
 	ssa.sa_final.bv_val = NULL;
 
-	rc = slap_bv2ad( &desc, &ssa.sa_desc, text );
+	rc = slap_bv2ad_cached( op->o_threadctx, &desc, &ssa.sa_desc, text );
 
 	if( rc != LDAP_SUCCESS ) {
 		f->f_choice |= SLAPD_FILTER_UNDEFINED;
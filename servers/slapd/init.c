@@ -61,6 +61,7 @@ BerVarray default_referral = NULL;
 ldap_pvt_thread_pool_t	connection_pool;
 int		connection_pool_max = SLAP_MAX_WORKER_THREADS;
 int		connection_pool_queues = 1;
+int		connection_pool_steal = 0;
 int		slap_tool_thread_max = 1;
 
 slap_counters_t			slap_counters, *slap_counters_list;
@@ -251,6 +252,7 @@ int slap_destroy(void)
 	}
 
 	ldap_pvt_thread_pool_free( &connection_pool );
+	slap_numa_destroy();
 
 	/* clear out any thread-keys for the main thread */
 	ldap_pvt_thread_pool_context_reset( ldap_pvt_thread_pool_context());
@@ -307,6 +309,7 @@ void slap_counters_init( slap_counters_t *sc )
 		ldap_pvt_mp_init( sc->sc_ops_initiated_[ i ] );
 		ldap_pvt_mp_init( sc->sc_ops_completed_[ i ] );
 	}
+	memset( sc->sc_latency, 0, sizeof( sc->sc_latency ));
 }
 
 void slap_counters_destroy( slap_counters_t *sc )
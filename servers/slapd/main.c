@@ -159,6 +159,7 @@ struct option_helper {
 	const char	*oh_usage;
 } option_helpers[] = {
 	{ BER_BVC("slp"),	slapd_opt_slp,	NULL, "slp[={on|off|(attrs)}] enable/disable SLP using (attrs)" },
+	{ BER_BVC("reuseport"),	slapd_opt_reuseport,	NULL, "reuseport=<n> open <n> SO_REUSEPORT sockets per TCP listener" },
 	{ BER_BVNULL, 0, NULL, NULL }
 };
 
@@ -141,7 +141,7 @@ get_mra(
 	}
 
 	if( type.bv_val != NULL ) {
-		rc = slap_bv2ad( &type, &ma.ma_desc, text );
+		rc = slap_bv2ad_cached( op->o_threadctx, &type, &ma.ma_desc, text );
 		if( rc != LDAP_SUCCESS ) {
 			f->f_choice |= SLAPD_FILTER_UNDEFINED;
 			rc = slap_bv2undef_ad( &type, &ma.ma_desc, text,
@@ -0,0 +1,298 @@
+/* numa.c - NUMA node placement of slapd threads */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 2022 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1			/* Needed for glibc cpu_set_t */
+#endif
+
+#include "portable.h"
+
+#include <stdio.h>
+
+#include <ac/errno.h>
+#include <ac/string.h>
+
+#include "slap.h"
+
+#if defined(__linux__) && defined(HAVE_SCHED_H)
+#include <sched.h>
+#define SLAP_NUMA_AFFINITY 1
+#define NUMA_SYSFS	"/sys/devices/system/node"
+#endif
+
+#ifdef __GNUC__
+#define NUMA_INCR(p)	__atomic_fetch_add( (p), 1, __ATOMIC_RELAXED )
+#define NUMA_DECR(p)	__atomic_fetch_sub( (p), 1, __ATOMIC_RELAXED )
+#define NUMA_LOAD(p)	__atomic_load_n( (p), __ATOMIC_RELAXED )
+#else
+#define NUMA_INCR(p)	(++*(p))
+#define NUMA_DECR(p)	(--*(p))
+#define NUMA_LOAD(p)	(*(p))
+#endif
+
+slap_verbmasks slap_numa_policies[] = {
+	{ BER_BVC("none"),	SLAP_NUMA_NONE },
+	{ BER_BVC("local"),	SLAP_NUMA_LOCAL },
+	{ BER_BVNULL, 0 }
+};
+
+int slap_numa_policy = SLAP_NUMA_NONE;
+
+/* Number of nodes threads are spread over, 0 if not in effect */
+int slap_numa_active;
+
+typedef struct slap_numa_node {
+	int sn_id;			/* node number in sysfs */
+	char sn_cpulist[64];
+#ifdef SLAP_NUMA_AFFINITY
+	cpu_set_t sn_cpus;
+#endif
+	int sn_listeners;	/* listener threads bound here */
+	int sn_workers;		/* pool threads bound here */
+	unsigned long sn_tasks;	/* connection tasks submitted here */
+} slap_numa_node;
+
+static slap_numa_node *numa_nodes;
+static int numa_nnodes;
+
+#ifdef SLAP_NUMA_AFFINITY
+/* Parse a sysfs list such as "0-3,8-11" */
+static int
+numa_parse_list( const char *s, cpu_set_t *set )
+{
+	unsigned long lo, hi;
+	char *next;
+
+	CPU_ZERO( set );
+	while ( *s && *s != '\n' ) {
+		lo = strtoul( s, &next, 10 );
+		if ( next == s )
+			return -1;
+		hi = lo;
+		if ( *next == '-' ) {
+			s = next + 1;
+			hi = strtoul( s, &next, 10 );
+			if ( next == s || hi < lo )
+				return -1;
+		}
+		if ( hi >= CPU_SETSIZE )
+			return -1;
+		for ( ; lo <= hi; lo++ )
+			CPU_SET( lo, set );
+		s = next;
+		if ( *s == ',' )
+			s++;
+	}
+	return 0;
+}
+
+static int
+numa_read_list( const char *path, char *buf, int len, cpu_set_t *set )
+{
+	FILE *fp;
+	int rc = -1;
+
+	fp = fopen( path, "r" );
+	if ( fp == NULL )
+		return -1;
+	if ( fgets( buf, len, fp ) != NULL ) {
+		buf[ strcspn( buf, "\n" ) ] = '\0';
+		rc = numa_parse_list( buf, set );
+	}
+	fclose( fp );
+	return rc;
+}
+#endif /* SLAP_NUMA_AFFINITY */
+
+/* Find the nodes and their CPUs. Only nodes that have CPUs are used. */
+static int
+numa_init( void )
+{
+#ifdef SLAP_NUMA_AFFINITY
+	char path[ sizeof(NUMA_SYSFS "/node/cpulist") + 16 ];
+	char buf[ 1024 ];
+	cpu_set_t online;
+	int i, n = 0;
+
+	if ( numa_read_list( NUMA_SYSFS "/online", buf, sizeof(buf), &online ))
+		return -1;
+
+	numa_nodes = ch_calloc( CPU_COUNT( &online ), sizeof( slap_numa_node ));
+	for ( i = 0; i < CPU_SETSIZE; i++ ) {
+		slap_numa_node *sn = &numa_nodes[n];
+
+		if ( !CPU_ISSET( i, &online ))
+			continue;
+		snprintf( path, sizeof(path), NUMA_SYSFS "/node%d/cpulist", i );
+		if ( numa_read_list( path, buf, sizeof(buf), &sn->sn_cpus ) ||
+			!CPU_COUNT( &sn->sn_cpus ))
+			continue;
+		sn->sn_id = i;
+		if ( strlen( buf ) >= sizeof( sn->sn_cpulist ))
+			strcpy( buf + sizeof( sn->sn_cpulist ) - 4, "..." );
+		strcpy( sn->sn_cpulist, buf );
+		n++;
+	}
+	numa_nnodes = n;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int
+slap_numa_config( int policy, char *msg, int len )
+{
+	if ( policy != SLAP_NUMA_NONE && !numa_nodes && numa_init() ) {
+		snprintf( msg, len, "NUMA node information is not available" );
+		return 1;
+	}
+	slap_numa_policy = policy;
+	slap_numa_active = 0;
+	if ( policy == SLAP_NUMA_LOCAL ) {
+		if ( numa_nnodes > 1 ) {
+			slap_numa_active = numa_nnodes;
+		} else {
+			Debug( LDAP_DEBUG_CONFIG, "slap_numa_config: "
+				"only %d NUMA node, nothing to bind\n", numa_nnodes );
+		}
+	}
+	return 0;
+}
+
+void
+slap_numa_destroy( void )
+{
+	ch_free( numa_nodes );
+	numa_nodes = NULL;
+	numa_nnodes = 0;
+	slap_numa_active = 0;
+}
+
+static int
+numa_bind( int node )
+{
+#ifdef SLAP_NUMA_AFFINITY
+	slap_numa_node *sn = &numa_nodes[node];
+
+	if ( sched_setaffinity( 0, sizeof( sn->sn_cpus ), &sn->sn_cpus )) {
+		int err = errno;
+		Debug( LDAP_DEBUG_ANY, "numa_bind: "
+			"unable to bind thread to node %d (%d)\n", sn->sn_id, err );
+		return -1;
+	}
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/* Bind a listener thread to its node. Listener tid owns the
+ * connections it watches, so they are all served on that node.
+ */
+void
+slap_numa_listener( int tid )
+{
+	int node;
+
+	if ( !slap_numa_active )
+		return;
+
+	node = tid % slap_numa_active;
+	if ( numa_bind( node ) == 0 ) {
+		NUMA_INCR( &numa_nodes[node].sn_listeners );
+		Debug( LDAP_DEBUG_TRACE, "slap_numa_listener: "
+			"listener thread %d bound to node %d\n",
+			tid, numa_nodes[node].sn_id );
+	}
+}
+
+static void
+numa_worker_free( void *key, void *data )
+{
+	long node = (long)data - 1;
+
+	if ( node >= 0 )
+		NUMA_DECR( &numa_nodes[node].sn_workers );
+}
+
+/* Bind a pool thread to the node of its work queue, once. This is
+ * done before the thread creates its slab heap and Operation cache,
+ * so that those pages are first touched, and placed, on the node.
+ */
+void
+slap_numa_worker( void *ctx )
+{
+	void *data = NULL;
+	int node;
+
+	if ( ldap_pvt_thread_pool_getkey( ctx, (void *)slap_numa_worker,
+		&data, NULL ) == 0 )
+		return;
+
+	node = ldap_pvt_thread_pool_queueid( ctx );
+	if ( node < 0 || connection_pool_queues < slap_numa_active )
+		return;
+
+	node %= slap_numa_active;
+	if ( numa_bind( node ) == 0 ) {
+		NUMA_INCR( &numa_nodes[node].sn_workers );
+	} else {
+		node = -1;	/* don't try again */
+	}
+	ldap_pvt_thread_pool_setkey( ctx, (void *)slap_numa_worker,
+		(void *)(long)( node + 1 ), numa_worker_free, NULL, NULL );
+}
+
+/* Submit a task for connection s to the work queues of its node */
+int
+slap_numa_submit( ber_socket_t s, ldap_pvt_thread_start_t *start, void *arg )
+{
+	int node;
+
+	if ( !slap_numa_active )
+		return ldap_pvt_thread_pool_submit( &connection_pool, start, arg );
+
+	node = slapd_daemon_owner( s ) % slap_numa_active;
+	NUMA_INCR( &numa_nodes[node].sn_tasks );
+	return ldap_pvt_thread_pool_submitq( &connection_pool,
+		node, slap_numa_active, start, arg, NULL );
+}
+
+/* Describe each node for cn=Monitor */
+void
+slap_numa_monitor( BerVarray *vals )
+{
+	char buf[ 256 ];
+	struct berval bv;
+	int i;
+
+	if ( !slap_numa_active )
+		return;
+
+	bv.bv_val = buf;
+	for ( i = 0; i < slap_numa_active; i++ ) {
+		slap_numa_node *sn = &numa_nodes[i];
+
+		bv.bv_len = snprintf( buf, sizeof( buf ),
+			"{%d}node=%d cpus=%s listeners=%d workers=%d tasks=%lu",
+			i, sn->sn_id, sn->sn_cpulist,
+			NUMA_LOAD( &sn->sn_listeners ), NUMA_LOAD( &sn->sn_workers ),
+			NUMA_LOAD( &sn->sn_tasks ));
+		if ( bv.bv_len < sizeof( buf ))
+			value_add_one( vals, &bv );
+	}
+}
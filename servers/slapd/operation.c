@@ -112,6 +112,10 @@ slap_op_free( Operation *op, void *ctx )
 		slap_op_groups_free( op );
 	}
 
+	if ( op->o_aclcache ) {
+		acl_cache_free( op );
+	}
+
 #if defined( LDAP_SLAPI )
 	if ( slapi_plugins_used ) {
 		slapi_int_free_object_extensions( SLAPI_X_EXT_OPERATION, op );
@@ -250,3 +254,131 @@ slap_req2op( ber_tag_t tag )
 
 	return SLAP_OP_LAST;
 }
+
+/*
+ * Latency histograms. Each thread records into its own slap_counters_t
+ * and each database into its be_latency, without taking any locks;
+ * readers sum them up and may see an operation in some phases but not
+ * yet in others.
+ */
+#ifdef __GNUC__
+#define LAT_ADD(p,n)	__atomic_fetch_add( (p), (n), __ATOMIC_RELAXED )
+#define LAT_LOAD(p)	__atomic_load_n( (p), __ATOMIC_RELAXED )
+#else
+#define LAT_ADD(p,n)	(*(p) += (n))
+#define LAT_LOAD(p)	(*(p))
+#endif
+#define LAT_INCR(p)	LAT_ADD( (p), 1 )
+
+static int
+slap_latency_index( unsigned long usec )
+{
+	int e;
+
+	if ( usec < SLAP_LAT_SUB )
+		return usec;
+	if ( usec > 0xffffffffUL )
+		usec = 0xffffffffUL;
+	for ( e = SLAP_LAT_SUBBITS; usec >> ( e + 1 ); e++ )
+		;
+	return ( e - SLAP_LAT_SUBBITS + 1 ) * SLAP_LAT_SUB +
+		(( usec >> ( e - SLAP_LAT_SUBBITS )) & ( SLAP_LAT_SUB - 1 ));
+}
+
+/* Smallest and largest latency counted in bucket i */
+void
+slap_latency_bucket( int i, unsigned long *lo, unsigned long *hi )
+{
+	int shift;
+
+	if ( i < SLAP_LAT_SUB ) {
+		*lo = *hi = i;
+		return;
+	}
+	shift = i / SLAP_LAT_SUB - 1;
+	*lo = (unsigned long)( SLAP_LAT_SUB + i % SLAP_LAT_SUB ) << shift;
+	*hi = *lo + ( 1UL << shift ) - 1;
+}
+
+/*
+ * Add n histograms from src to those in dst. The global counters in
+ * dst may be recorded into at the same time, so add atomically.
+ */
+void
+slap_latency_merge( slap_latency_t *dst, slap_latency_t *src, int n )
+{
+	int i;
+
+	for ( ; n > 0; n--, dst++, src++ ) {
+		for ( i = 0; i < SLAP_LAT_BUCKETS; i++ )
+			LAT_ADD( &dst->sl_buckets[i], LAT_LOAD( &src->sl_buckets[i] ));
+	}
+}
+
+/* Estimated latency below which permille/1000 of the samples fall */
+unsigned long
+slap_latency_percentile( slap_latency_t *sl, int permille )
+{
+	unsigned long total = 0, rank, lo, hi;
+	int i;
+
+	for ( i = 0; i < SLAP_LAT_BUCKETS; i++ )
+		total += sl->sl_buckets[i];
+	if ( !total )
+		return 0;
+
+	rank = total - ( total * ( 1000 - permille )) / 1000;
+	for ( i = 0; i < SLAP_LAT_BUCKETS - 1; i++ ) {
+		if ( sl->sl_buckets[i] >= rank )
+			break;
+		rank -= sl->sl_buckets[i];
+	}
+	slap_latency_bucket( i, &lo, &hi );
+	return lo + ( hi - lo ) / 2;
+}
+
+static long
+tv_usec_diff( struct timeval *a, struct timeval *b )
+{
+	long d = ( a->tv_sec - b->tv_sec ) * 1000000L + a->tv_usec - b->tv_usec;
+
+	return d > 0 ? d : 0;
+}
+
+/*
+ * Record the latency of an operation whose result has just been
+ * written; ready is when the result was ready to be sent.
+ */
+void
+slap_op_latency( Operation *op, struct timeval *ready )
+{
+	struct timeval now, recv, start;
+	unsigned long lat[SLAP_LAT_LAST];
+	slap_latency_t *sl;
+	slap_op_t opidx;
+	int i;
+
+	opidx = slap_req2op( op->o_tag );
+	if ( opidx == SLAP_OP_LAST )
+		return;
+
+	gettimeofday( &now, NULL );
+	recv.tv_sec = op->o_time;
+	recv.tv_usec = op->o_tusec;
+	start.tv_sec = recv.tv_sec + op->o_qtime.tv_sec;
+	start.tv_usec = recv.tv_usec + op->o_qtime.tv_usec;
+
+	lat[SLAP_LAT_QUEUE] = tv_usec_diff( &start, &recv );
+	lat[SLAP_LAT_EXECUTE] = tv_usec_diff( ready, &start );
+	lat[SLAP_LAT_WRITE] = tv_usec_diff( &now, ready );
+	lat[SLAP_LAT_TOTAL] = tv_usec_diff( &now, &recv );
+
+	sl = op->o_counters->sc_latency[opidx];
+	for ( i = 0; i < SLAP_LAT_LAST; i++ )
+		LAT_INCR( &sl[i].sl_buckets[ slap_latency_index( lat[i] ) ] );
+
+	if ( op->o_bd && ( sl = op->o_bd->be_latency )) {
+		for ( i = 0; i < SLAP_LAT_LAST; i++ )
+			LAT_INCR( &sl[i].sl_buckets[ slap_latency_index( lat[i] ) ] );
+	}
+}
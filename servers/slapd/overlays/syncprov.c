@@ -22,7 +22,11 @@
 
 #ifdef SLAPD_OVER_SYNCPROV
 
+#include <stdio.h>
+
+#include <ac/errno.h>
 #include <ac/string.h>
+#include <ac/unistd.h>
 #include "lutil.h"
 #include "slap.h"
 #include "slap-config.h"
@@ -45,11 +49,19 @@ typedef struct modtarget {
 	ldap_pvt_thread_mutex_t mt_mutex;
 } modtarget;
 
+/* A search entry encoded once for a group of psearches */
+typedef struct syncenc {
+	struct syncenc *sx_next;
+	unsigned long sx_group;
+	struct berval sx_bv;
+} syncenc;
+
 /* All the info of a psearch result that's shared between
  * multiple queues
  */
 typedef struct resinfo {
 	struct syncres *ri_list;
+	syncenc *ri_enc;	/* entry encodings, by psearch group */
 	Entry *ri_e;
 	struct berval ri_dn;
 	struct berval ri_ndn;
@@ -77,6 +89,7 @@ typedef struct syncops {
 	Operation	*s_op;		/* search op */
 	int		s_rid;
 	int		s_sid;
+	unsigned long	s_group;	/* psearches with the same parameters */
 	struct berval s_filterstr;
 	int		s_flags;	/* search status */
 #define	PS_IS_REFRESHING	0x01
@@ -105,11 +118,24 @@ typedef struct sync_control {
 /* o_sync_mode uses data bits of o_sync */
 #define	o_sync_mode	o_ctrlflag[slap_cids.sc_LDAPsync]
 
+#ifdef HAVE_ZLIB
+/* Consumer asks for the rest of the connection to be compressed */
+static int sync_compress_cid;
+#define	o_sync_compress	o_ctrlflag[sync_compress_cid]
+#endif
+
 #define SLAP_SYNC_NONE					(LDAP_SYNC_NONE<<SLAP_CONTROL_SHIFT)
 #define SLAP_SYNC_REFRESH				(LDAP_SYNC_REFRESH_ONLY<<SLAP_CONTROL_SHIFT)
 #define SLAP_SYNC_PERSIST				(LDAP_SYNC_RESERVED<<SLAP_CONTROL_SHIFT)
 #define SLAP_SYNC_REFRESH_AND_PERSIST	(LDAP_SYNC_REFRESH_AND_PERSIST<<SLAP_CONTROL_SHIFT)
 
+/* Filter result already computed for a group of psearches */
+typedef struct syncgroupmatch {
+	struct syncgroupmatch *gm_next;
+	unsigned long gm_group;
+	int gm_rc;
+} syncgroupmatch;
+
 /* Record of which searches matched at premodify step */
 typedef struct syncmatches {
 	struct syncmatches *sm_next;
@@ -131,10 +157,22 @@ typedef struct sessionlog {
 	int		sl_num;
 	int		sl_size;
 	int		sl_playing;
+	long		sl_bytes;	/* memory used by the entries */
+	long		sl_maxbytes;	/* limit on sl_bytes, 0 for none */
 	TAvlnode *sl_entries;
 	ldap_pvt_thread_rdwr_t sl_mutex;
 } sessionlog;
 
+#define SLOG_BYTES(se)	( sizeof( slog_entry ) + (se)->se_uuid.bv_len + \
+	(se)->se_csn.bv_len + 1 )
+
+/* True if the log holds more than it is configured to. A log with
+ * only a byte limit has sl_size 0. */
+#define SLOG_OVERFULL(sl)	( (sl)->sl_maxbytes ? \
+	( (sl)->sl_bytes > (sl)->sl_maxbytes || \
+		( (sl)->sl_size && (sl)->sl_num > (sl)->sl_size )) : \
+	(sl)->sl_num > (sl)->sl_size )
+
 /* Accesslog callback data */
 typedef struct syncprov_accesslog_deletes {
 	Operation *op;
@@ -161,12 +199,16 @@ typedef struct syncprov_info_t {
 	int		si_numops;	/* number of ops since last checkpoint */
 	int		si_nopres;	/* Skip present phase */
 	int		si_usehint;	/* use reload hint */
+	int		si_fanout;	/* share work between identical psearches */
+	int		si_nocompress;	/* refuse to compress the stream */
+	unsigned long	si_groupid;	/* last psearch group assigned */
 	int		si_active;	/* True if there are active mods */
 	int		si_dirty;	/* True if the context is dirty, i.e changes
 						 * have been made without updating the csn. */
 	time_t	si_chklast;	/* time of last checkpoint */
 	Avlnode	*si_mods;	/* entries being modified */
 	sessionlog	*si_logs;
+	char		*si_logfile;	/* saved sessionlog */
 	ldap_pvt_thread_rdwr_t	si_csn_rwlock;
 	ldap_pvt_thread_mutex_t	si_ops_mutex;
 	ldap_pvt_thread_mutex_t	si_mods_mutex;
@@ -860,7 +902,14 @@ static void free_resinfo( syncres *sr )
 	}
 	ldap_pvt_thread_mutex_unlock( &ri->ri_mutex );
 	if ( freeit ) {
+		syncenc *sx;
+
 		ldap_pvt_thread_mutex_destroy( &ri->ri_mutex );
+		while (( sx = ri->ri_enc )) {
+			ri->ri_enc = sx->sx_next;
+			ch_free( sx->sx_bv.bv_val );
+			ch_free( sx );
+		}
 		if ( ri->ri_e )
 			entry_free( ri->ri_e );
 		if ( !BER_BVISNULL( &ri->ri_cookie ))
@@ -917,6 +966,52 @@ syncprov_free_syncop( syncops *so, int flags )
 	return 1;
 }
 
+/* Send an entry to a member of a psearch group. The entry is only
+ * encoded by the first member to get here, the others reuse it.
+ */
+static int
+syncprov_sendentry_group( Operation *op, SlapReply *rs, resinfo *ri,
+	unsigned long group )
+{
+	syncenc *sx;
+	struct berval bv = BER_BVNULL;
+	int rc;
+
+	ldap_pvt_thread_mutex_lock( &ri->ri_mutex );
+	for ( sx = ri->ri_enc; sx; sx = sx->sx_next ) {
+		if ( sx->sx_group == group ) {
+			bv = sx->sx_bv;
+			break;
+		}
+	}
+	ldap_pvt_thread_mutex_unlock( &ri->ri_mutex );
+	if ( sx )
+		return slap_send_search_entry_enc( op, rs, &bv );
+
+	rc = slap_send_search_entry_enc( op, rs, &bv );
+	if ( BER_BVISNULL( &bv ))
+		return rc;
+
+	ldap_pvt_thread_mutex_lock( &ri->ri_mutex );
+	/* another member may have encoded it meanwhile */
+	for ( sx = ri->ri_enc; sx; sx = sx->sx_next ) {
+		if ( sx->sx_group == group )
+			break;
+	}
+	if ( !sx ) {
+		sx = ch_malloc( sizeof( syncenc ));
+		sx->sx_group = group;
+		sx->sx_bv = bv;
+		sx->sx_next = ri->ri_enc;
+		ri->ri_enc = sx;
+		BER_BVZERO( &bv );
+	}
+	ldap_pvt_thread_mutex_unlock( &ri->ri_mutex );
+	if ( !BER_BVISNULL( &bv ))
+		ch_free( bv.bv_val );
+	return rc;
+}
+
 /* Send a persistent search response */
 static int
 syncprov_sendresp( Operation *op, resinfo *ri, syncops *so, int mode )
@@ -975,7 +1070,12 @@ syncprov_sendresp( Operation *op, resinfo *ri, syncops *so, int mode )
 			mode == LDAP_SYNC_ADD ? "LDAP_SYNC_ADD" : "LDAP_SYNC_MODIFY",
 			e_uuid.e_nname.bv_val );
 		rs.sr_attrs = op->ors_attrs;
-		rs.sr_err = send_search_entry( op, &rs );
+		if ( so->s_group && so->s_si && so->s_si->si_fanout &&
+			op->o_conn->c_send_search_entry == slap_send_search_entry ) {
+			rs.sr_err = syncprov_sendentry_group( op, &rs, ri, so->s_group );
+		} else {
+			rs.sr_err = send_search_entry( op, &rs );
+		}
 		break;
 	case LDAP_SYNC_DELETE:
 		Debug( LDAP_DEBUG_SYNC, "%s syncprov_sendresp: "
@@ -1171,6 +1271,7 @@ syncprov_qresp( opcookie *opc, syncops *so, int mode )
 			}
 		}
 		ri->ri_list = &opc->ssres;
+		ri->ri_enc = NULL;
 		ri->ri_e = opc->se;
 		ri->ri_csn.bv_len = csn.bv_len;
 		ri->ri_isref = opc->sreference;
@@ -1279,6 +1380,70 @@ syncprov_op_abandon( Operation *op, SlapReply *rs )
 	return SLAP_CB_CONTINUE;
 }
 
+/* Do two detached psearches always get the same results? */
+static int
+syncprov_same_search( syncops *s1, syncops *s2 )
+{
+	Operation *o1 = s1->s_op, *o2 = s2->s_op;
+	int i;
+
+	if ( o1->ors_scope != o2->ors_scope ||
+		o1->ors_attrsonly != o2->ors_attrsonly ||
+		o1->o_managedsait != o2->o_managedsait ||
+		!dn_match( &s1->s_base, &s2->s_base ) ||
+		!bvmatch( &o1->ors_filterstr, &o2->ors_filterstr ) ||
+		!dn_match( &o1->o_ndn, &o2->o_ndn ))
+		return 0;
+
+	if ( !o1->ors_attrs || !o2->ors_attrs )
+		return o1->ors_attrs == o2->ors_attrs;
+	for ( i=0; !BER_BVISNULL( &o1->ors_attrs[i].an_name ); i++ ) {
+		if ( BER_BVISNULL( &o2->ors_attrs[i].an_name ) ||
+			!bvmatch( &o1->ors_attrs[i].an_name, &o2->ors_attrs[i].an_name ))
+			return 0;
+	}
+	return BER_BVISNULL( &o2->ors_attrs[i].an_name );
+}
+
+/* Find the group of a psearch, joining the group of an identical
+ * psearch or starting a new one. Only detached psearches are grouped,
+ * their parameters don't change anymore. A psearch is kept alone when
+ * the ACLs depend on the connection, as identical psearches on other
+ * connections may then see different content. Must be called with
+ * si_ops_mutex held.
+ */
+static unsigned long
+syncprov_group( syncprov_info_t *si, syncops *so )
+{
+	syncops *ss;
+	int detached;
+
+	if ( so->s_group )
+		return so->s_group;
+
+	ldap_pvt_thread_mutex_lock( &so->s_mutex );
+	detached = so->s_flags & PS_IS_DETACHED;
+	ldap_pvt_thread_mutex_unlock( &so->s_mutex );
+	if ( !detached )
+		return 0;
+
+	if ( !acl_uses_connection( so->s_op->o_bd )) {
+		for ( ss = si->si_ops; ss; ss = ss->s_next ) {
+			if ( ss->s_group && syncprov_same_search( ss, so )) {
+				so->s_group = ss->s_group;
+				break;
+			}
+		}
+	}
+	if ( !so->s_group )
+		so->s_group = ++si->si_groupid;
+
+	Debug( LDAP_DEBUG_SYNC, "%s syncprov_group: "
+		"psearch is in group %lu\n",
+		so->s_op->o_log_prefix, so->s_group );
+	return so->s_group;
+}
+
 /* Find which persistent searches are affected by this operation */
 static void
 syncprov_matchops( Operation *op, opcookie *opc, int saveit )
@@ -1288,6 +1453,7 @@ syncprov_matchops( Operation *op, opcookie *opc, int saveit )
 
 	fbase_cookie fc;
 	syncops **pss;
+	syncgroupmatch *gm, *gmatches = NULL;
 	Entry *e = NULL;
 	Attribute *a;
 	int rc, gonext;
@@ -1358,6 +1524,7 @@ syncprov_matchops( Operation *op, opcookie *opc, int saveit )
 		syncmatches *sm;
 		int found = 0;
 		syncops *snext, *ss = *pss;
+		unsigned long group = 0;
 
 		gonext = 1;
 		if ( ss->s_op->o_abandon )
@@ -1420,7 +1587,18 @@ syncprov_matchops( Operation *op, opcookie *opc, int saveit )
 		}
 
 		rc = LDAP_COMPARE_FALSE;
-		if ( e && !is_entry_glue( e ) && fc.fscope ) {
+		gm = NULL;
+		if ( e && !is_entry_glue( e ) && fc.fscope && si->si_fanout ) {
+			/* test the filter once per group */
+			group = syncprov_group( si, ss );
+			for ( gm = group ? gmatches : NULL; gm; gm = gm->gm_next ) {
+				if ( gm->gm_group == group ) {
+					rc = gm->gm_rc;
+					break;
+				}
+			}
+		}
+		if ( e && !is_entry_glue( e ) && fc.fscope && !gm ) {
 			ldap_pvt_thread_mutex_lock( &ss->s_mutex );
 			op2 = *ss->s_op;
 			oh = *op->o_hdr;
@@ -1438,6 +1616,13 @@ syncprov_matchops( Operation *op, opcookie *opc, int saveit )
 			}
 			rc = test_filter( &op2, e, op2.ors_filter );
 			ldap_pvt_thread_mutex_unlock( &ss->s_mutex );
+			if ( group ) {
+				gm = op->o_tmpalloc( sizeof(syncgroupmatch), op->o_tmpmemctx );
+				gm->gm_group = group;
+				gm->gm_rc = rc;
+				gm->gm_next = gmatches;
+				gmatches = gm;
+			}
 		}
 
 		Debug( LDAP_DEBUG_TRACE, "%s syncprov_matchops: "
@@ -1478,6 +1663,11 @@ syncprov_matchops( Operation *op, opcookie *opc, int saveit )
 	}
 	ldap_pvt_thread_mutex_unlock( &si->si_ops_mutex );
 
+	while (( gm = gmatches )) {
+		gmatches = gm->gm_next;
+		op->o_tmpfree( gm, op->o_tmpmemctx );
+	}
+
 	if ( op->o_tag != LDAP_REQ_ADD && e ) {
 		if ( !SLAP_ISOVERLAY( op->o_bd )) {
 			op->o_bd = &db;
@@ -1661,6 +1851,7 @@ syncprov_add_slog( Operation *op )
 			if ( !sl->sl_playing ) {
 				ldap_tavl_free( sl->sl_entries, (AVL_FREE)ch_free );
 				sl->sl_num = 0;
+				sl->sl_bytes = 0;
 				sl->sl_entries = NULL;
 			}
 			ldap_pvt_thread_rdwr_wunlock( &sl->sl_mutex );
@@ -1712,9 +1903,10 @@ syncprov_add_slog( Operation *op )
 			goto leave;
 		}
 		sl->sl_num++;
-		if ( !sl->sl_playing && sl->sl_num > sl->sl_size ) {
+		sl->sl_bytes += SLOG_BYTES( se );
+		if ( !sl->sl_playing && SLOG_OVERFULL( sl ) ) {
 			TAvlnode *edge = ldap_tavl_end( sl->sl_entries, TAVL_DIR_LEFT );
-			while ( sl->sl_num > sl->sl_size ) {
+			while ( SLOG_OVERFULL( sl ) ) {
 				int i;
 				TAvlnode *next = ldap_tavl_next( edge, TAVL_DIR_RIGHT );
 				se = edge->avl_data;
@@ -1737,6 +1929,7 @@ syncprov_add_slog( Operation *op )
 					ber_bvreplace( &sl->sl_mincsn[i], &se->se_csn );
 				}
 				ldap_tavl_delete( &sl->sl_entries, se, syncprov_sessionlog_cmp );
+				sl->sl_bytes -= SLOG_BYTES( se );
 				ch_free( se );
 				edge = next;
 				sl->sl_num--;
@@ -3102,6 +3295,18 @@ syncprov_op_search( Operation *op, SlapReply *rs )
 		op->o_sync_mode & SLAP_SYNC_PERSIST ? "persistent ": "",
 		srs->sr_state.octet_str.bv_val );
 
+#ifdef HAVE_ZLIB
+	/* Must be done before anything is sent back. If we can't, the
+	 * consumer sees an uncompressed response and carries on as is.
+	 */
+	if ( op->o_sync_compress != SLAP_CONTROL_NONE && !si->si_nocompress ) {
+		if ( connection_compress( op->o_conn ) == 0 ) {
+			Debug( LDAP_DEBUG_SYNC, "%s syncprov_op_search: "
+				"compressing replication stream\n", op->o_log_prefix );
+		}
+	}
+#endif
+
 	/* If this is a persistent search, set it up right away */
 	if ( op->o_sync_mode & SLAP_SYNC_PERSIST ) {
 		syncops so = {0};
@@ -3635,7 +3840,11 @@ enum {
 	SP_SESSL,
 	SP_NOPRES,
 	SP_USEHINT,
-	SP_LOGDB
+	SP_LOGDB,
+	SP_SLFILE,
+	SP_SLBYTES,
+	SP_FANOUT,
+	SP_NOCOMPRESS
 };
 
 static ConfigDriver sp_cf_gen;
@@ -3665,6 +3874,26 @@ static ConfigTable spcfg[] = {
 		sp_cf_gen, "( OLcfgOvAt:1.5 NAME 'olcSpSessionlogSource' "
 			"DESC 'On startup, try loading sessionlog from this subtree' "
 			"SYNTAX OMsDN SINGLE-VALUE )", NULL, NULL },
+	{ "syncprov-sessionlog-file", "path", 2, 2, 0, ARG_STRING|ARG_MAGIC|SP_SLFILE,
+		sp_cf_gen, "( OLcfgOvAt:1.6 NAME 'olcSpSessionlogFile' "
+			"DESC 'File to keep the session log in across restarts' "
+			"EQUALITY caseExactMatch "
+			"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
+	{ "syncprov-sessionlog-bytes", "bytes", 2, 2, 0, ARG_LONG|ARG_MAGIC|SP_SLBYTES,
+		sp_cf_gen, "( OLcfgOvAt:1.7 NAME 'olcSpSessionlogBytes' "
+			"DESC 'Session log size in bytes' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "syncprov-fanout", NULL, 2, 2, 0, ARG_ON_OFF|ARG_MAGIC|SP_FANOUT,
+		sp_cf_gen, "( OLcfgOvAt:1.8 NAME 'olcSpFanout' "
+			"DESC 'Match and encode changes once for identical persistent searches' "
+			"EQUALITY booleanMatch "
+			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "syncprov-nocompress", NULL, 2, 2, 0, ARG_ON_OFF|ARG_MAGIC|SP_NOCOMPRESS,
+		sp_cf_gen, "( OLcfgOvAt:1.9 NAME 'olcSpNoCompress' "
+			"DESC 'Ignore requests to compress the replication stream' "
+			"EQUALITY booleanMatch "
+			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED }
 };
 
@@ -3678,11 +3907,28 @@ static ConfigOCs spocs[] = {
 			"$ olcSpNoPresent "
 			"$ olcSpReloadHint "
 			"$ olcSpSessionlogSource "
+			"$ olcSpSessionlogFile "
+			"$ olcSpSessionlogBytes "
+			"$ olcSpFanout "
+			"$ olcSpNoCompress "
 		") )",
 			Cft_Overlay, spcfg },
 	{ NULL, 0, NULL }
 };
 
+static sessionlog *
+syncprov_sessionlog_new( syncprov_info_t *si )
+{
+	sessionlog *sl = si->si_logs;
+
+	if ( !sl ) {
+		sl = ch_calloc( 1, sizeof( sessionlog ));
+		ldap_pvt_thread_rdwr_init( &sl->sl_mutex );
+		si->si_logs = sl;
+	}
+	return sl;
+}
+
 static int
 sp_cf_gen(ConfigArgs *c)
 {
@@ -3711,7 +3957,7 @@ sp_cf_gen(ConfigArgs *c)
 			}
 			break;
 		case SP_SESSL:
-			if ( si->si_logs ) {
+			if ( si->si_logs && si->si_logs->sl_size ) {
 				c->value_int = si->si_logs->sl_size;
 			} else {
 				rc = 1;
@@ -3731,6 +3977,20 @@ sp_cf_gen(ConfigArgs *c)
 				rc = 1;
 			}
 			break;
+		case SP_FANOUT:
+			if ( si->si_fanout ) {
+				c->value_int = 1;
+			} else {
+				rc = 1;
+			}
+			break;
+		case SP_NOCOMPRESS:
+			if ( si->si_nocompress ) {
+				c->value_int = 1;
+			} else {
+				rc = 1;
+			}
+			break;
 		case SP_LOGDB:
 			if ( BER_BVISEMPTY( &si->si_logbase ) ) {
 				rc = 1;
@@ -3739,6 +3999,20 @@ sp_cf_gen(ConfigArgs *c)
 				value_add_one( &c->rvalue_nvals, &si->si_logbase );
 			}
 			break;
+		case SP_SLFILE:
+			if ( si->si_logfile ) {
+				c->value_string = ch_strdup( si->si_logfile );
+			} else {
+				rc = 1;
+			}
+			break;
+		case SP_SLBYTES:
+			if ( si->si_logs && si->si_logs->sl_maxbytes ) {
+				c->value_long = si->si_logs->sl_maxbytes;
+			} else {
+				rc = 1;
+			}
+			break;
 		}
 		return rc;
 	} else if ( c->op == LDAP_MOD_DELETE ) {
@@ -3757,12 +4031,26 @@ sp_cf_gen(ConfigArgs *c)
 		case SP_USEHINT:
 			si->si_usehint = 0;
 			break;
+		case SP_FANOUT:
+			si->si_fanout = 0;
+			break;
+		case SP_NOCOMPRESS:
+			si->si_nocompress = 0;
+			break;
 		case SP_LOGDB:
 			if ( !BER_BVISNULL( &si->si_logbase ) ) {
 				ch_free( si->si_logbase.bv_val );
 				BER_BVZERO( &si->si_logbase );
 			}
 			break;
+		case SP_SLFILE:
+			ch_free( si->si_logfile );
+			si->si_logfile = NULL;
+			break;
+		case SP_SLBYTES:
+			if ( si->si_logs )
+				si->si_logs->sl_maxbytes = 0;
+			break;
 		}
 		return rc;
 	}
@@ -3814,16 +4102,26 @@ sp_cf_gen(ConfigArgs *c)
 					"internal sessionlog, accesslog source has already been "
 					"configured, this results in wasteful operation\n" );
 		}
-		sl = si->si_logs;
-		if ( !sl ) {
-			if ( !size ) break;
-			sl = ch_calloc( 1, sizeof( sessionlog ));
-			ldap_pvt_thread_rdwr_init( &sl->sl_mutex );
-			si->si_logs = sl;
-		}
+		if ( !size && !si->si_logs ) break;
+		sl = syncprov_sessionlog_new( si );
 		sl->sl_size = size;
 		}
 		break;
+	case SP_SLBYTES:
+		if ( c->value_long < 0 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ), "%s size %ld is negative",
+				c->argv[0], c->value_long );
+			Debug( LDAP_DEBUG_CONFIG|LDAP_DEBUG_NONE,
+				"%s: %s\n", c->log, c->cr_msg );
+			return ARG_BAD_CONF;
+		}
+		if ( !c->value_long && !si->si_logs ) break;
+		syncprov_sessionlog_new( si )->sl_maxbytes = c->value_long;
+		break;
+	case SP_SLFILE:
+		ch_free( si->si_logfile );
+		si->si_logfile = c->value_string;
+		break;
 	case SP_NOPRES:
 		si->si_nopres = c->value_int;
 		break;
@@ -3831,6 +4129,12 @@ sp_cf_gen(ConfigArgs *c)
 		si->si_usehint = c->value_int;
 		rc = syncprov_setup_accesslog();
 		break;
+	case SP_FANOUT:
+		si->si_fanout = c->value_int;
+		break;
+	case SP_NOCOMPRESS:
+		si->si_nocompress = c->value_int;
+		break;
 	case SP_LOGDB:
 		if ( si->si_logs ) {
 			Debug( LDAP_DEBUG_ANY, "syncprov_config: while configuring "
@@ -3913,6 +4217,231 @@ syncprov_db_otask2(
 	return NULL;
 }
 
+/* The sessionlog can be saved to a file at shutdown and reloaded at
+ * startup, so that consumers can still be served from the log after
+ * a restart. The file is only valid for the contextCSN it was written
+ * with; it is removed once read so a crash never leaves a stale log.
+ *
+ * Format, in host byte order:
+ *	magic, version
+ *	count, count * (len, csn)		the contextCSN
+ *	count, count * (sid, len, csn)	the log's mincsn
+ *	count, count * (tag, uuidlen, csnlen, uuid, csn)
+ */
+#define SLOG_MAGIC		0x4c535053	/* "SPSL" */
+#define SLOG_VERSION	1
+
+static int
+slog_write_int( FILE *fp, ber_uint_t i )
+{
+	return fwrite( &i, sizeof(i), 1, fp ) != 1;
+}
+
+static int
+slog_write_bv( FILE *fp, struct berval *bv )
+{
+	if ( slog_write_int( fp, bv->bv_len ))
+		return -1;
+	return bv->bv_len && fwrite( bv->bv_val, bv->bv_len, 1, fp ) != 1;
+}
+
+static int
+slog_read_int( FILE *fp, ber_uint_t *i )
+{
+	return fread( i, sizeof(*i), 1, fp ) != 1;
+}
+
+static int
+slog_read_bv( FILE *fp, struct berval *bv )
+{
+	ber_uint_t len;
+
+	if ( slog_read_int( fp, &len ) || len >= LDAP_PVT_CSNSTR_BUFSIZE )
+		return -1;
+	bv->bv_val = ch_malloc( len + 1 );
+	bv->bv_len = len;
+	bv->bv_val[len] = '\0';
+	if ( len && fread( bv->bv_val, len, 1, fp ) != 1 ) {
+		ch_free( bv->bv_val );
+		BER_BVZERO( bv );
+		return -1;
+	}
+	return 0;
+}
+
+static void
+syncprov_sessionlog_save( syncprov_info_t *si )
+{
+	sessionlog *sl = si->si_logs;
+	TAvlnode *edge;
+	slog_entry *se;
+	char *tmp, ebuf[128];
+	FILE *fp;
+	int i, rc;
+
+	tmp = ch_malloc( strlen( si->si_logfile ) + STRLENOF(".tmp") + 1 );
+	sprintf( tmp, "%s.tmp", si->si_logfile );
+	fp = fopen( tmp, "wb" );
+	if ( !fp ) {
+		rc = errno;
+		Debug( LDAP_DEBUG_ANY, "syncprov_sessionlog_save: "
+			"cannot create %s: %s (%d)\n", tmp, AC_STRERROR_R( rc, ebuf, sizeof(ebuf) ), rc );
+		ch_free( tmp );
+		return;
+	}
+
+	ldap_pvt_thread_rdwr_rlock( &si->si_csn_rwlock );
+	ldap_pvt_thread_rdwr_rlock( &sl->sl_mutex );
+	rc = slog_write_int( fp, SLOG_MAGIC ) ||
+		slog_write_int( fp, SLOG_VERSION ) ||
+		slog_write_int( fp, si->si_numcsns );
+	for ( i = 0; !rc && i < si->si_numcsns; i++ )
+		rc = slog_write_bv( fp, &si->si_ctxcsn[i] );
+	if ( !rc )
+		rc = slog_write_int( fp, sl->sl_numcsns );
+	for ( i = 0; !rc && i < sl->sl_numcsns; i++ )
+		rc = slog_write_int( fp, sl->sl_sids[i] ) ||
+			slog_write_bv( fp, &sl->sl_mincsn[i] );
+	if ( !rc )
+		rc = slog_write_int( fp, sl->sl_num );
+	for ( edge = ldap_tavl_end( sl->sl_entries, TAVL_DIR_LEFT );
+			!rc && edge; edge = ldap_tavl_next( edge, TAVL_DIR_RIGHT )) {
+		se = edge->avl_data;
+		rc = slog_write_int( fp, se->se_tag ) ||
+			slog_write_bv( fp, &se->se_uuid ) ||
+			slog_write_bv( fp, &se->se_csn );
+	}
+	i = sl->sl_num;
+	ldap_pvt_thread_rdwr_runlock( &sl->sl_mutex );
+	ldap_pvt_thread_rdwr_runlock( &si->si_csn_rwlock );
+
+	if ( fclose( fp ) )
+		rc = -1;
+	if ( !rc && rename( tmp, si->si_logfile ) )
+		rc = -1;
+	if ( rc ) {
+		rc = errno;
+		Debug( LDAP_DEBUG_ANY, "syncprov_sessionlog_save: "
+			"cannot write %s: %s (%d)\n", si->si_logfile,
+			AC_STRERROR_R( rc, ebuf, sizeof(ebuf) ), rc );
+		unlink( tmp );
+	} else {
+		Debug( LDAP_DEBUG_SYNC, "syncprov_sessionlog_save: "
+			"saved %d entries to %s\n", i, si->si_logfile );
+	}
+	ch_free( tmp );
+}
+
+/* Returns the number of entries loaded, or -1 if the file
+ * could not be used. */
+static int
+syncprov_sessionlog_load( syncprov_info_t *si )
+{
+	sessionlog *sl = si->si_logs;
+	BerVarray mincsn = NULL;
+	int *sids = NULL;
+	struct berval csn;
+	ber_uint_t magic, version, num, sid, tag;
+	slog_entry *se;
+	FILE *fp;
+	int i, rc = -1;
+
+	fp = fopen( si->si_logfile, "rb" );
+	if ( !fp )
+		return -1;
+
+	if ( slog_read_int( fp, &magic ) || magic != SLOG_MAGIC ||
+			slog_read_int( fp, &version ) || version != SLOG_VERSION ) {
+		Debug( LDAP_DEBUG_ANY, "syncprov_sessionlog_load: "
+			"%s is not a sessionlog file\n", si->si_logfile );
+		goto done;
+	}
+
+	/* The log only applies to the DB state it was saved with */
+	if ( slog_read_int( fp, &num ) || num != si->si_numcsns )
+		goto stale;
+	for ( i = 0; i < num; i++ ) {
+		if ( slog_read_bv( fp, &csn ))
+			goto stale;
+		rc = ber_bvcmp( &csn, &si->si_ctxcsn[i] );
+		ch_free( csn.bv_val );
+		if ( rc ) {
+			rc = -1;
+			goto stale;
+		}
+	}
+
+	if ( slog_read_int( fp, &num ) || !num || num > SLAP_SYNC_SID_MAX + 1 )
+		goto stale;
+	mincsn = ch_calloc( num + 1, sizeof( struct berval ));
+	sids = ch_malloc( num * sizeof( int ));
+	for ( i = 0; i < num; i++ ) {
+		if ( slog_read_int( fp, &sid ) || slog_read_bv( fp, &mincsn[i] ))
+			goto stale;
+		sids[i] = sid;
+	}
+
+	ldap_pvt_thread_rdwr_wlock( &sl->sl_mutex );
+	if ( sl->sl_mincsn )
+		ber_bvarray_free( sl->sl_mincsn );
+	ch_free( sl->sl_sids );
+	sl->sl_mincsn = mincsn;
+	sl->sl_sids = sids;
+	sl->sl_numcsns = num;
+	mincsn = NULL;
+	sids = NULL;
+
+	rc = 0;
+	if ( slog_read_int( fp, &num ))
+		num = 0;
+	for ( ; num; num-- ) {
+		struct berval uuid;
+
+		if ( slog_read_int( fp, &tag ) || slog_read_bv( fp, &uuid ))
+			break;
+		if ( slog_read_bv( fp, &csn )) {
+			ch_free( uuid.bv_val );
+			break;
+		}
+		se = ch_malloc( sizeof( slog_entry ) + uuid.bv_len + csn.bv_len + 1 );
+		se->se_tag = tag;
+		se->se_uuid.bv_val = (char *)(&se[1]);
+		AC_MEMCPY( se->se_uuid.bv_val, uuid.bv_val, uuid.bv_len );
+		se->se_uuid.bv_len = uuid.bv_len;
+		se->se_csn.bv_val = se->se_uuid.bv_val + uuid.bv_len;
+		AC_MEMCPY( se->se_csn.bv_val, csn.bv_val, csn.bv_len + 1 );
+		se->se_csn.bv_len = csn.bv_len;
+		se->se_sid = slap_parse_csn_sid( &se->se_csn );
+		ch_free( uuid.bv_val );
+		ch_free( csn.bv_val );
+
+		if ( ldap_tavl_insert( &sl->sl_entries, se, syncprov_sessionlog_cmp,
+				ldap_avl_dup_error )) {
+			ch_free( se );
+			continue;
+		}
+		sl->sl_num++;
+		sl->sl_bytes += SLOG_BYTES( se );
+		rc++;
+	}
+	ldap_pvt_thread_rdwr_wunlock( &sl->sl_mutex );
+	goto done;
+
+stale:
+	Debug( LDAP_DEBUG_ANY, "syncprov_sessionlog_load: "
+		"%s does not match the database contextCSN, ignored\n",
+		si->si_logfile );
+	rc = -1;
+done:
+	if ( mincsn )
+		ber_bvarray_free( mincsn );
+	ch_free( sids );
+	fclose( fp );
+	/* never reuse a log that updates may have gone past */
+	unlink( si->si_logfile );
+	return rc;
+}
+
 /* Read any existing contextCSN from the underlying db.
  * Then search for any entries newer than that. If no value exists,
  * just generate it. Cache whatever result.
@@ -4042,6 +4571,14 @@ syncprov_db_open(
 		sl->sl_sids = ch_malloc( si->si_numcsns * sizeof(int) );
 		for ( i=0; i < si->si_numcsns; i++ )
 			sl->sl_sids[i] = si->si_sids[i];
+
+		if ( si->si_logfile ) {
+			i = syncprov_sessionlog_load( si );
+			if ( i >= 0 )
+				Debug( LDAP_DEBUG_SYNC, "syncprov_db_open: "
+					"loaded %d sessionlog entries from %s\n",
+					i, si->si_logfile );
+		}
 	}
 
 	if ( !BER_BVISNULL( &si->si_logbase ) ) {
@@ -4090,6 +4627,9 @@ syncprov_db_close(
 		op->o_ndn = be->be_rootndn;
 		syncprov_checkpoint( op, on );
 	}
+	if ( si->si_logs && si->si_logfile && si->si_numcsns ) {
+		syncprov_sessionlog_save( si );
+	}
 
 #ifdef SLAP_CONFIG_DELETE
 	if ( !slapd_shutdown ) {
@@ -4176,6 +4716,8 @@ syncprov_db_destroy(
 			ch_free( si->si_sids );
 		if ( si->si_logbase.bv_val )
 			ch_free( si->si_logbase.bv_val );
+		if ( si->si_logfile )
+			ch_free( si->si_logfile );
 		ldap_pvt_thread_mutex_destroy( &si->si_resp_mutex );
 		ldap_pvt_thread_mutex_destroy( &si->si_mods_mutex );
 		ldap_pvt_thread_mutex_destroy( &si->si_ops_mutex );
@@ -4296,6 +4838,31 @@ static int syncprov_parseCtrl (
 	return LDAP_SUCCESS;
 }
 
+#ifdef HAVE_ZLIB
+static int
+syncprov_parseCompress (
+	Operation	*op,
+	SlapReply	*rs,
+	LDAPControl	*ctrl )
+{
+	if ( op->o_sync_compress != SLAP_CONTROL_NONE ) {
+		rs->sr_text = "Compress control specified multiple times";
+		return LDAP_PROTOCOL_ERROR;
+	}
+
+	if ( !BER_BVISNULL( &ctrl->ldctl_value ) ) {
+		rs->sr_text = "Compress control value not absent";
+		return LDAP_PROTOCOL_ERROR;
+	}
+
+	op->o_sync_compress = ctrl->ldctl_iscritical
+		? SLAP_CONTROL_CRITICAL
+		: SLAP_CONTROL_NONCRITICAL;
+
+	return LDAP_SUCCESS;
+}
+#endif
+
 /* This overlay is set up for dynamic loading via moduleload. For static
  * configuration, you'll need to arrange for the slap_overinst to be
  * initialized and registered by some other function inside slapd.
@@ -4317,6 +4884,17 @@ syncprov_initialize()
 		return rc;
 	}
 
+#ifdef HAVE_ZLIB
+	rc = register_supported_control( LDAP_CONTROL_X_COMPRESS,
+		SLAP_CTRL_SEARCH, NULL,
+		syncprov_parseCompress, &sync_compress_cid );
+	if ( rc != LDAP_SUCCESS ) {
+		Debug( LDAP_DEBUG_ANY,
+			"syncprov_init: Failed to register control %d\n", rc );
+		return rc;
+	}
+#endif
+
 	syncprov.on_bi.bi_type = "syncprov";
 	syncprov.on_bi.bi_flags = SLAPO_BFLAG_SINGLE;
 	syncprov.on_bi.bi_db_init = syncprov_db_init;
@@ -75,6 +75,14 @@ LDAP_SLAPD_F (int) acl_check_modlist LDAP_P((
 
 LDAP_SLAPD_F (void) acl_append( AccessControl **l, AccessControl *a, int pos );
 
+LDAP_SLAPD_V (int) slap_acl_cache;
+LDAP_SLAPD_F (void) acl_cache_invalidate LDAP_P(( void ));
+LDAP_SLAPD_F (void) acl_cache_alloc LDAP_P(( Operation *op ));
+LDAP_SLAPD_F (void) acl_cache_free LDAP_P(( Operation *op ));
+LDAP_SLAPD_F (void) acl_cache_stats LDAP_P((
+	unsigned long *hits, unsigned long *misses ));
+LDAP_SLAPD_F (int) acl_uses_connection LDAP_P(( BackendDB *be ));
+
 #ifdef SLAP_DYNACL
 LDAP_SLAPD_F (int) slap_dynacl_register LDAP_P(( slap_dynacl_t *da ));
 LDAP_SLAPD_F (slap_dynacl_t *) slap_dynacl_get LDAP_P(( const char *name ));
@@ -128,6 +136,13 @@ LDAP_SLAPD_F (int) slap_bv2ad LDAP_P((
 	AttributeDescription **ad,
 	const char **text ));
 
+LDAP_SLAPD_F (int) slap_bv2ad_cached LDAP_P((
+	void *ctx,
+	struct berval *bv,
+	AttributeDescription **ad,
+	const char **text ));
+LDAP_SLAPD_F (void) ad_cache_invalidate LDAP_P(( void ));
+
 LDAP_SLAPD_F (void) ad_destroy LDAP_P(( AttributeDescription * ));
 LDAP_SLAPD_F (int) ad_keystring LDAP_P(( struct berval *bv ));
 
@@ -786,6 +801,7 @@ LDAP_SLAPD_F (const char *) connection_state2str LDAP_P(( int state ))
 LDAP_SLAPD_F (int) connection_read_activate LDAP_P((ber_socket_t s));
 LDAP_SLAPD_F (int) connection_write LDAP_P((ber_socket_t s));
 LDAP_SLAPD_F (void) connection_write_resume LDAP_P((Connection *c));
+LDAP_SLAPD_F (int) connection_compress LDAP_P((Connection *c));
 
 LDAP_SLAPD_F (void) connection_op_finish LDAP_P((
 	Operation *op, int lock ));
@@ -854,7 +870,9 @@ LDAP_SLAPD_F (void) slap_queue_csn LDAP_P(( Operation *, struct berval * ));
  */
 LDAP_SLAPD_F (void) slapd_add_internal(ber_socket_t s, int isactive);
 LDAP_SLAPD_F (int) slapd_daemon_init( const char *urls );
+LDAP_SLAPD_F (int) slapd_opt_reuseport( const char *val, void *arg );
 LDAP_SLAPD_F (int) slapd_daemon_resize( int newnum );
+LDAP_SLAPD_F (int) slapd_daemon_owner( ber_socket_t s );
 LDAP_SLAPD_F (int) slapd_daemon_destroy(void);
 LDAP_SLAPD_F (int) slapd_daemon(void);
 LDAP_SLAPD_F (Listener **)	slapd_get_listeners LDAP_P((void));
@@ -886,6 +904,7 @@ LDAP_SLAPD_V (slap_ssf_t) local_ssf;
 LDAP_SLAPD_V (struct runqueue_s) slapd_rq;
 LDAP_SLAPD_V (int) slapd_daemon_threads;
 LDAP_SLAPD_V (int) slapd_daemon_mask;
+LDAP_SLAPD_V (int) slapd_listener_shards;
 #ifdef LDAP_TCP_BUFFER
 LDAP_SLAPD_V (int) slapd_tcp_rmem;
 LDAP_SLAPD_V (int) slapd_tcp_wmem;
@@ -1014,6 +1033,8 @@ LDAP_SLAPD_F (Entry *) str2entry LDAP_P(( char	*s ));
 LDAP_SLAPD_F (Entry *) str2entry2 LDAP_P(( char	*s, int checkvals ));
 LDAP_SLAPD_F (char *) entry2str LDAP_P(( Entry *e, int *len ));
 LDAP_SLAPD_F (char *) entry2str_wrap LDAP_P(( Entry *e, int *len, ber_len_t wrap ));
+LDAP_SLAPD_F (char *) entry2str_wrap_r LDAP_P(( Entry *e, struct berval *buf,
+	int *len, ber_len_t wrap ));
 
 LDAP_SLAPD_F (ber_len_t) entry_flatsize LDAP_P(( Entry *e, int norm ));
 LDAP_SLAPD_F (void) entry_partsize LDAP_P(( Entry *e, ber_len_t *len,
@@ -1412,6 +1433,20 @@ LDAP_SLAPD_F (void) mra_free LDAP_P((
 	MatchingRuleAssertion *mra,
 	int freeit ));
 
+/*
+ * numa.c
+ */
+LDAP_SLAPD_V (slap_verbmasks) slap_numa_policies[];
+LDAP_SLAPD_V (int) slap_numa_policy;
+LDAP_SLAPD_V (int) slap_numa_active;
+LDAP_SLAPD_F (int) slap_numa_config LDAP_P(( int policy, char *msg, int len ));
+LDAP_SLAPD_F (void) slap_numa_destroy LDAP_P(( void ));
+LDAP_SLAPD_F (void) slap_numa_listener LDAP_P(( int tid ));
+LDAP_SLAPD_F (void) slap_numa_worker LDAP_P(( void *ctx ));
+LDAP_SLAPD_F (int) slap_numa_submit LDAP_P(( ber_socket_t s,
+	ldap_pvt_thread_start_t *start, void *arg ));
+LDAP_SLAPD_F (void) slap_numa_monitor LDAP_P(( BerVarray *vals ));
+
 /* oc.c */
 LDAP_SLAPD_F (int) oc_add LDAP_P((
 	LDAPObjectClass *oc,
@@ -1505,6 +1540,14 @@ LDAP_SLAPD_F (Operation *) slap_op_alloc LDAP_P((
 	ber_tag_t tag, ber_int_t id, void *ctx ));
 
 LDAP_SLAPD_F (slap_op_t) slap_req2op LDAP_P(( ber_tag_t tag ));
+LDAP_SLAPD_F (void) slap_op_latency LDAP_P(( Operation *op,
+	struct timeval *ready ));
+LDAP_SLAPD_F (void) slap_latency_bucket LDAP_P(( int i,
+	unsigned long *lo, unsigned long *hi ));
+LDAP_SLAPD_F (void) slap_latency_merge LDAP_P(( slap_latency_t *dst,
+	slap_latency_t *src, int n ));
+LDAP_SLAPD_F (unsigned long) slap_latency_percentile LDAP_P((
+	slap_latency_t *sl, int permille ));
 
 /*
  * operational.c
@@ -1636,6 +1679,11 @@ LDAP_SLAPD_F (void) slap_send_ldap_intermediate LDAP_P(( Operation *op, SlapRepl
 LDAP_SLAPD_F (void) slap_send_search_result LDAP_P(( Operation *op, SlapReply *rs ));
 LDAP_SLAPD_F (int) slap_send_search_reference LDAP_P(( Operation *op, SlapReply *rs ));
 LDAP_SLAPD_F (int) slap_send_search_entry LDAP_P(( Operation *op, SlapReply *rs ));
+LDAP_SLAPD_F (int) slap_send_search_entry_enc LDAP_P(( Operation *op,
+	SlapReply *rs, struct berval *enc ));
+LDAP_SLAPD_F (void) slap_writebatch_flush LDAP_P(( Operation *op ));
+LDAP_SLAPD_F (void) slap_writebatch_init LDAP_P(( void ));
+LDAP_SLAPD_F (void) slap_writebatch_destroy LDAP_P(( void ));
 LDAP_SLAPD_F (int) slap_null_cb LDAP_P(( Operation *op, SlapReply *rs ));
 LDAP_SLAPD_F (int) slap_freeself_cb LDAP_P(( Operation *op, SlapReply *rs ));
 
@@ -2102,6 +2150,7 @@ LDAP_SLAPD_V (const char) 	Versionstr[];
 
 LDAP_SLAPD_V (int)		global_gentlehup;
 LDAP_SLAPD_V (int)		global_idletimeout;
+LDAP_SLAPD_V (ber_len_t)	global_writebatch;
 LDAP_SLAPD_V (int)		global_writetimeout;
 LDAP_SLAPD_V (char *)	global_host;
 LDAP_SLAPD_V (struct berval)	global_host_bv;
@@ -2131,6 +2180,7 @@ LDAP_SLAPD_V (time_t)		starttime;
 LDAP_SLAPD_V (ldap_pvt_thread_pool_t)	connection_pool;
 LDAP_SLAPD_V (int)			connection_pool_max;
 LDAP_SLAPD_V (int)			connection_pool_queues;
+LDAP_SLAPD_V (int)			connection_pool_steal;
 LDAP_SLAPD_V (int)			slap_tool_thread_max;
 
 LDAP_SLAPD_V (ldap_pvt_thread_mutex_t)	entry2str_mutex;
@@ -36,6 +36,7 @@
 #include <ac/unistd.h>
 
 #include "slap.h"
+#include "ldap_rq.h"
 
 #if SLAP_STATS_ETIME
 #define ETIME_SETUP \
@@ -331,26 +332,240 @@ slap_writewait_play(
 	}
 }
 
+/* Longest a coalesced PDU may wait in c_wber, in microseconds, when
+ * further PDUs are being sent on the connection
+ */
+#define SLAP_WRITEBATCH_DELAY	5000
+
+/* Connections with coalesced PDUs, checked once a second by the
+ * slap_writebatch_timer() runqueue task so that their PDUs go out even
+ * if no further PDU is sent
+ */
+static ldap_pvt_thread_mutex_t	slap_wb_mutex;
+static Connection	*slap_wb_list;
+static struct re_s	*slap_wb_rtask;
+
+static long send_ldap_ber( Operation *op, BerElement *ber, int batch );
+static void *slap_writebatch_timer( void *ctx, void *arg );
+
+/* Write out the PDUs coalesced on a connection */
+static void *
+slap_writebatch_task( void *ctx, void *arg )
+{
+	Operation op = {0};
+	Opheader ohdr = {0};
+
+	op.o_hdr = &ohdr;
+	op.o_conn = arg;
+	(void)send_ldap_ber( &op, NULL, 0 );
+	return NULL;
+}
+
+/* Put a connection on the timer's list, and schedule the timer if it
+ * is idle. c_write1_mutex and slap_wb_mutex must be held.
+ */
+static void
+slap_writebatch_watch( Connection *conn )
+{
+	if ( conn->c_wqueued )
+		return;
+	conn->c_wqueued = 1;
+	conn->c_wnext = slap_wb_list;
+	slap_wb_list = conn;
+
+	ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+	if ( !slap_wb_rtask ) {
+		slap_wb_rtask = ldap_pvt_runqueue_insert( &slapd_rq, 1,
+			slap_writebatch_timer, NULL, "slap_writebatch_timer", NULL );
+		ldap_pvt_runqueue_resched( &slapd_rq, slap_wb_rtask, 0 );
+	} else if ( !ldap_pvt_runqueue_isrunning( &slapd_rq, slap_wb_rtask ) &&
+		!slap_wb_rtask->next_sched.tv_sec ) {
+		ldap_pvt_runqueue_resched( &slapd_rq, slap_wb_rtask, 0 );
+	}
+	ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+}
+
+/*
+ * Hand the connections whose coalesced PDUs are due to the thread pool
+ * for writing, and keep watching the others. Runs from the runqueue
+ * while there are connections to watch.
+ */
+static void *
+slap_writebatch_timer( void *ctx, void *arg )
+{
+	struct re_s *rtask = arg;
+	Connection *conn, *list;
+	struct timeval now;
+	long usec;
+
+	ldap_pvt_thread_mutex_lock( &slap_wb_mutex );
+	list = slap_wb_list;
+	slap_wb_list = NULL;
+	ldap_pvt_thread_mutex_unlock( &slap_wb_mutex );
+
+	gettimeofday( &now, NULL );
+	while (( conn = list )) {
+		/* c_wnext stays ours until c_wqueued is cleared */
+		list = conn->c_wnext;
+		ldap_pvt_thread_mutex_lock( &conn->c_write1_mutex );
+		ldap_pvt_thread_mutex_lock( &slap_wb_mutex );
+		conn->c_wqueued = 0;
+		if ( conn->c_wber == NULL || !connection_valid( conn )) {
+			ldap_pvt_thread_mutex_unlock( &slap_wb_mutex );
+			ldap_pvt_thread_mutex_unlock( &conn->c_write1_mutex );
+			continue;
+		}
+		usec = ( now.tv_sec - conn->c_wtime.tv_sec ) * 1000000L +
+			now.tv_usec - conn->c_wtime.tv_usec;
+		if ( usec < SLAP_WRITEBATCH_DELAY ) {
+			slap_writebatch_watch( conn );
+			ldap_pvt_thread_mutex_unlock( &slap_wb_mutex );
+			ldap_pvt_thread_mutex_unlock( &conn->c_write1_mutex );
+			continue;
+		}
+		ldap_pvt_thread_mutex_unlock( &slap_wb_mutex );
+		ldap_pvt_thread_mutex_unlock( &conn->c_write1_mutex );
+		/* writing may block, don't hold up the other connections */
+		ldap_pvt_thread_pool_submit( &connection_pool,
+			slap_writebatch_task, conn );
+	}
+
+	/* run again in a second if there is more to watch, otherwise
+	 * wait until slap_writebatch_watch() schedules us
+	 */
+	ldap_pvt_thread_mutex_lock( &slap_wb_mutex );
+	ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+	ldap_pvt_runqueue_stoptask( &slapd_rq, rtask );
+	ldap_pvt_runqueue_resched( &slapd_rq, rtask, slap_wb_list == NULL );
+	ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+	ldap_pvt_thread_mutex_unlock( &slap_wb_mutex );
+	return NULL;
+}
+
+void
+slap_writebatch_init( void )
+{
+	ldap_pvt_thread_mutex_init( &slap_wb_mutex );
+}
+
+void
+slap_writebatch_destroy( void )
+{
+	ldap_pvt_thread_mutex_destroy( &slap_wb_mutex );
+}
+
+/*
+ * Append ber, if any, to the connection's pending output. Returns 1 if
+ * the pending output should be written now, 0 if it may wait for more,
+ * 2 if ber is too large to be worth copying and should be written on
+ * its own after the pending output, -1 on failure. c_write1_mutex must
+ * be held.
+ */
+static int
+slap_writebatch_add(
+	Connection *conn,
+	BerElement *ber,
+	int batch )
+{
+	struct berval bv;
+	struct timeval now;
+	ber_len_t len;
+	long usec;
+
+	if ( ber == NULL )
+		return 1;
+
+	ber_get_option( ber, LBER_OPT_BER_BYTES_TO_WRITE, &len );
+	if ( len >= global_writebatch )
+		return 2;
+
+	ber_flatten2( ber, &bv, 0 );
+	if ( conn->c_wber == NULL ) {
+		conn->c_wber = ber_alloc_t( LBER_USE_DER );
+		if ( conn->c_wber == NULL )
+			return -1;
+		gettimeofday( &conn->c_wtime, NULL );
+		if ( batch ) {
+			ldap_pvt_thread_mutex_lock( &slap_wb_mutex );
+			slap_writebatch_watch( conn );
+			ldap_pvt_thread_mutex_unlock( &slap_wb_mutex );
+		}
+	}
+	if ( ber_write( conn->c_wber, bv.bv_val, bv.bv_len, 0 ) < 0 )
+		return -1;
+	if ( !batch )
+		return 1;
+
+	ber_get_option( conn->c_wber, LBER_OPT_BER_BYTES_TO_WRITE, &len );
+	if ( len >= global_writebatch )
+		return 1;
+
+	gettimeofday( &now, NULL );
+	usec = ( now.tv_sec - conn->c_wtime.tv_sec ) * 1000000L +
+		now.tv_usec - conn->c_wtime.tv_usec;
+	return usec >= SLAP_WRITEBATCH_DELAY;
+}
+
+/*
+ * Write a PDU to the client. With batch set, the PDU may instead be
+ * queued on the connection and written later together with others;
+ * any PDU sent without batch writes out what was queued before it.
+ * A NULL ber just writes out the queue.
+ */
 static long send_ldap_ber(
 	Operation *op,
-	BerElement *ber )
+	BerElement *ber,
+	int batch )
 {
 	Connection *conn = op->o_conn;
 	ber_len_t bytes;
 	long ret = 0;
 	char *close_reason;
 	int do_resume = 0;
+	BerElement *wber = NULL, *next = NULL;
 
-	ber_get_option( ber, LBER_OPT_BER_BYTES_TO_WRITE, &bytes );
+	if ( ber ) {
+		ber_get_option( ber, LBER_OPT_BER_BYTES_TO_WRITE, &bytes );
+	} else {
+		bytes = 0;
+	}
 
 	/* write only one pdu at a time - wait til it's our turn */
 	ldap_pvt_thread_mutex_lock( &conn->c_write1_mutex );
-	if (( op->o_abandon && !op->o_cancel ) || !connection_valid( conn ) ||
-		conn->c_writers < 0 ) {
+	if (( ber && op->o_abandon && !op->o_cancel ) ||
+		!connection_valid( conn ) || conn->c_writers < 0 ||
+		( ber == NULL && conn->c_wber == NULL )) {
 		ldap_pvt_thread_mutex_unlock( &conn->c_write1_mutex );
 		return 0;
 	}
 
+	if ( batch || conn->c_wber ) {
+		switch ( slap_writebatch_add( conn, ber, batch )) {
+		case 0:
+			ldap_pvt_thread_mutex_unlock( &conn->c_write1_mutex );
+			return bytes;
+		case 1:
+			/* write everything queued so far, ours included */
+			ber = wber = conn->c_wber;
+			conn->c_wber = NULL;
+			break;
+		case 2:
+			/* write the queue, then ours without copying it */
+			if ( conn->c_wber ) {
+				next = ber;
+				ber = wber = conn->c_wber;
+				conn->c_wber = NULL;
+			}
+			break;
+		default:
+			ldap_pvt_thread_mutex_unlock( &conn->c_write1_mutex );
+			ldap_pvt_thread_mutex_lock( &conn->c_mutex );
+			connection_closing( conn, "out of memory on write" );
+			ldap_pvt_thread_mutex_unlock( &conn->c_mutex );
+			return -1;
+		}
+	}
+
 	conn->c_writers++;
 
 	while ( conn->c_writers > 0 && conn->c_writing ) {
@@ -378,6 +593,11 @@ static long send_ldap_ber(
 		char ebuf[128];
 
 		if ( ber_flush2( conn->c_sb, ber, LBER_FLUSH_FREE_NEVER ) == 0 ) {
+			if ( next ) {
+				ber = next;
+				next = NULL;
+				continue;
+			}
 			ret = bytes;
 			break;
 		}
@@ -399,6 +619,7 @@ fail:
 			conn->c_writers--;
 			conn->c_writing = 0;
 			ldap_pvt_thread_mutex_unlock( &conn->c_write1_mutex );
+			if ( wber ) ber_free( wber, 1 );
 			ldap_pvt_thread_mutex_lock( &conn->c_mutex );
 			connection_closing( conn, close_reason );
 			ldap_pvt_thread_mutex_unlock( &conn->c_mutex );
@@ -448,6 +669,8 @@ fail:
 	}
 	ldap_pvt_thread_mutex_unlock( &conn->c_write1_mutex );
 
+	if ( wber ) ber_free( wber, 1 );
+
 	/* If there are no more writers, release a pending op */
 	if ( do_resume )
 		connection_write_resume( conn );
@@ -455,6 +678,19 @@ fail:
 	return ret;
 }
 
+/*
+ * Write out any search responses still queued on the connection.
+ * Called when an operation stops batching its responses.
+ */
+void
+slap_writebatch_flush( Operation *op )
+{
+	if ( op->o_conn == NULL || op->o_conn->c_wber == NULL )
+		return;
+
+	(void)send_ldap_ber( op, NULL, 0 );
+}
+
 static int
 send_ldap_control( BerElement *ber, LDAPControl *c )
 {
@@ -631,6 +867,7 @@ send_ldap_response(
 	BerElement	*ber = (BerElement *) &berbuf;
 	int		rc = LDAP_SUCCESS;
 	long	bytes;
+	struct timeval ready;
 
 	/* op was actually aborted, bypass everything if client didn't Cancel */
 	if (( rs->sr_err == SLAPD_ABANDON ) && !op->o_cancel ) {
@@ -760,7 +997,8 @@ send_ldap_response(
 	}
 
 	/* send BER */
-	bytes = send_ldap_ber( op, ber );
+	gettimeofday( &ready, NULL );
+	bytes = send_ldap_ber( op, ber, 0 );
 #ifdef LDAP_CONNECTIONLESS
 	if (!op->o_conn || op->o_conn->c_is_udp == 0)
 #endif
@@ -780,6 +1018,9 @@ send_ldap_response(
 	ldap_pvt_mp_add_ulong( op->o_counters->sc_bytes, (unsigned long)bytes );
 	ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex );
 
+	if ( bytes > 0 && rs->sr_type != REP_INTERMEDIATE )
+		slap_op_latency( op, &ready );
+
 cleanup:;
 	/* Tell caller that we did this for real, as opposed to being
 	 * overridden by a callback
@@ -1099,7 +1340,8 @@ slap_send_search_entry( Operation *op, SlapReply *rs )
 		bv.bv_len = entry_flatsize( rs->sr_entry, 0 );
 		bv.bv_val = op->o_tmpalloc( bv.bv_len, op->o_tmpmemctx );
 
-		ber_init2( ber, &bv, LBER_USE_DER );
+		/* don't move large values again as each enclosing sequence closes */
+		ber_init2( ber, &bv, LBER_USE_DER | LBER_USE_LONGLEN );
 		ber_set_option( ber, LBER_OPT_BER_MEMCTX, &op->o_tmpmemctx );
 	}
 
@@ -1487,7 +1729,7 @@ slap_send_search_entry( Operation *op, SlapReply *rs )
 	rs_flush_entry( op, rs, NULL );
 
 	if ( op->o_res_ber == NULL ) {
-		bytes = send_ldap_ber( op, ber );
+		bytes = send_ldap_ber( op, ber, SLAP_SEND_BATCH( op ));
 		ber_free_buf( ber );
 
 		if ( bytes < 0 ) {
@@ -1545,6 +1787,111 @@ error_return:;
 	return( rc );
 }
 
+/*
+ * Send a SearchResultEntry whose protocolOp is shared with other
+ * searches, so that it only needs to be encoded once. If enc is empty,
+ * the entry in rs is encoded into it first, and the caller must
+ * ch_free() it when done. Only the message ID and the controls in rs
+ * are added for this operation.
+ */
+int
+slap_send_search_entry_enc( Operation *op, SlapReply *rs, struct berval *enc )
+{
+	BerElementBuffer berbuf;
+	BerElement	*ber = (BerElement *) &berbuf;
+	int		rc, bytes, encoded = 0;
+
+	if ( BER_BVISNULL( enc ) ) {
+		LDAPControl **ctrls = rs->sr_ctrls;
+		slap_mask_t ctrlflags = rs->sr_flags & REP_CTRLS_MUSTBEFREED;
+
+		op->o_res_ber = ber_alloc_t( LBER_USE_DER );
+		if ( op->o_res_ber == NULL ) {
+			rc = LDAP_NO_MEMORY;
+			goto done;
+		}
+
+		/* the controls are per operation, keep them out of the encoding */
+		rs->sr_ctrls = NULL;
+		rs->sr_flags ^= ctrlflags;
+		rc = slap_send_search_entry( op, rs );
+		rs->sr_ctrls = ctrls;
+		rs->sr_flags |= ctrlflags;
+
+		if ( rc == LDAP_SUCCESS && ber_flatten2( op->o_res_ber, enc, 1 ) == -1 ) {
+			BER_BVZERO( enc );
+			rc = LDAP_OTHER;
+		}
+		ber_free( op->o_res_ber, 1 );
+		op->o_res_ber = NULL;
+		if ( rc != LDAP_SUCCESS )
+			goto done;
+		encoded = 1;
+	}
+
+	rs->sr_type = REP_SEARCH;
+
+	ber_init_w_nullc( ber, LBER_USE_DER );
+	ber_set_option( ber, LBER_OPT_BER_MEMCTX, &op->o_tmpmemctx );
+
+	rc = ber_printf( ber, "{i" /*}*/, op->o_msgid );
+	if ( rc != -1 ) {
+		rc = ber_write( ber, enc->bv_val, enc->bv_len, 0 );
+	}
+	if ( rc != -1 ) {
+		rc = send_ldap_controls( op, ber, rs->sr_ctrls );
+	}
+	if ( rc != -1 ) {
+		rc = ber_printf( ber, /*{*/ "N}" );
+	}
+	if ( rc == -1 ) {
+		Debug( LDAP_DEBUG_ANY, "ber_printf failed\n" );
+
+		ber_free_buf( ber );
+		set_ldap_error( rs, LDAP_OTHER, "encode entry end error" );
+		rc = rs->sr_err;
+		goto done;
+	}
+
+	/* slap_send_search_entry() has already logged it */
+	if ( !encoded ) {
+		Debug( LDAP_DEBUG_STATS2, "%s ENTRY dn=\"%s\"\n",
+			op->o_log_prefix, rs->sr_entry->e_nname.bv_val );
+	}
+
+	bytes = send_ldap_ber( op, ber, SLAP_SEND_BATCH( op ));
+	ber_free_buf( ber );
+
+	if ( bytes < 0 ) {
+		Debug( LDAP_DEBUG_ANY,
+			"send_search_entry: conn %lu  ber write failed.\n",
+			op->o_connid );
+
+		rc = LDAP_UNAVAILABLE;
+		goto done;
+	}
+	rs->sr_nentries++;
+
+	ldap_pvt_thread_mutex_lock( &op->o_counters->sc_mutex );
+	ldap_pvt_mp_add_ulong( op->o_counters->sc_bytes, (unsigned long)bytes );
+	ldap_pvt_mp_add_ulong( op->o_counters->sc_entries, 1 );
+	ldap_pvt_mp_add_ulong( op->o_counters->sc_pdu, 1 );
+	ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex );
+
+	rc = LDAP_SUCCESS;
+
+done:;
+	if ( rs->sr_flags & REP_CTRLS_MUSTBEFREED ) {
+		rs->sr_flags ^= REP_CTRLS_MUSTBEFREED;
+		if ( rs->sr_ctrls ) {
+			slap_free_ctrls( op, rs->sr_ctrls );
+			rs->sr_ctrls = NULL;
+		}
+	}
+
+	return( rc );
+}
+
 int
 slap_send_search_reference( Operation *op, SlapReply *rs )
 {
@@ -1653,7 +2000,7 @@ slap_send_search_reference( Operation *op, SlapReply *rs )
 #ifdef LDAP_CONNECTIONLESS
 	if (!op->o_conn || op->o_conn->c_is_udp == 0) {
 #endif
-	bytes = send_ldap_ber( op, ber );
+	bytes = send_ldap_ber( op, ber, SLAP_SEND_BATCH( op ));
 	ber_free_buf( ber );
 
 	if ( bytes < 0 ) {
@@ -152,7 +152,7 @@ do_search(
 		op->ors_attrs[i].an_desc = NULL;
 		op->ors_attrs[i].an_oc = NULL;
 		op->ors_attrs[i].an_flags = 0;
-		if ( slap_bv2ad( &op->ors_attrs[i].an_name,
+		if ( slap_bv2ad_cached( op->o_threadctx, &op->ors_attrs[i].an_name,
 			&op->ors_attrs[i].an_desc, &dummy ) != LDAP_SUCCESS )
 		{
 			if ( slap_bv2undef_ad( &op->ors_attrs[i].an_name,
@@ -422,8 +422,23 @@ fail1:
 
 	} else if ( op->o_bd->be_search ) {
 		if ( limits_check( op, rs ) == 0 ) {
+			/* coalesce entries only while the backend is producing
+			 * them here; a persistent search sends later from a copy
+			 */
+			if ( global_writebatch && op->o_conn
+#ifdef LDAP_CONNECTIONLESS
+				&& !op->o_conn->c_is_udp
+#endif
+				)
+				op->o_send_batch = op;
+
 			/* actually do the search and send the result(s) */
 			(op->o_bd->be_search)( op, rs );
+
+			if ( op->o_send_batch ) {
+				op->o_send_batch = NULL;
+				slap_writebatch_flush( op );
+			}
 		}
 		/* else limits_check() sends error */
 
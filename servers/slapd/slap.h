@@ -138,6 +138,10 @@ LDAP_BEGIN_DECL
 
 #define SLAP_MAX_WORKER_THREADS		(16)
 
+/* numa policies */
+#define SLAP_NUMA_NONE	0
+#define SLAP_NUMA_LOCAL	1
+
 #define SLAP_SB_MAX_INCOMING_DEFAULT ((1<<18) - 1)
 #define SLAP_SB_MAX_INCOMING_AUTH ((1<<24) - 1)
 
@@ -1574,6 +1578,9 @@ typedef struct AccessControlState {
 } AccessControlState;
 #define ACL_STATE_INIT { NULL, ACL_NONE, NULL, 0, 0, ACL_PRIV_NONE, -1, 0 }
 
+/* Per-operation ACL decision cache, private to acl.c */
+typedef struct AclCache AclCache;
+
 typedef struct AclRegexMatches {        
 	int dn_count;
         regmatch_t dn_data[MAXREMATCHES];
@@ -2008,6 +2015,7 @@ struct BackendDB {
 	be_pcsn	be_pcsn_st;			/* be_pending_csn_list now inside this */
 	be_pcsn	*be_pcsn_p;
 	struct syncinfo_s						*be_syncinfo; /* For syncrepl */
+	struct slap_latency_t	*be_latency;	/* [SLAP_LAT_LAST], see operation.c */
 
 	void    *be_pb;         /* Netscape plugin */
 	struct ConfigOCs *be_cf_ocs;
@@ -2568,6 +2576,28 @@ typedef enum {
 	SLAP_OP_LAST
 } slap_op_t;
 
+/*
+ * Operation latency histograms, in microseconds. Values below
+ * SLAP_LAT_SUB have a bucket each, larger ones get SLAP_LAT_SUB
+ * buckets per power of two, like an HDR histogram with a relative
+ * error of at most 1/SLAP_LAT_SUB.
+ */
+#define SLAP_LAT_SUBBITS	3
+#define SLAP_LAT_SUB	(1 << SLAP_LAT_SUBBITS)
+#define SLAP_LAT_BUCKETS	((32 - SLAP_LAT_SUBBITS + 1) * SLAP_LAT_SUB)
+
+typedef enum {
+	SLAP_LAT_QUEUE = 0,	/* received -> started */
+	SLAP_LAT_EXECUTE,	/* started -> result ready */
+	SLAP_LAT_WRITE,		/* result ready -> result written */
+	SLAP_LAT_TOTAL,		/* received -> result written */
+	SLAP_LAT_LAST
+} slap_lat_t;
+
+typedef struct slap_latency_t {
+	unsigned long	sl_buckets[SLAP_LAT_BUCKETS];
+} slap_latency_t;
+
 typedef struct slap_counters_t {
 	struct slap_counters_t	*sc_next;
 	ldap_pvt_thread_mutex_t	sc_mutex;
@@ -2580,6 +2610,9 @@ typedef struct slap_counters_t {
 	ldap_pvt_mp_t		sc_ops_initiated;
 	ldap_pvt_mp_t		sc_ops_completed_[SLAP_OP_LAST];
 	ldap_pvt_mp_t		sc_ops_initiated_[SLAP_OP_LAST];
+
+	/* updated without sc_mutex, see slap_op_latency() */
+	slap_latency_t		sc_latency[SLAP_OP_LAST][SLAP_LAT_LAST];
 } slap_counters_t;
 
 /*
@@ -2729,6 +2762,7 @@ struct Operation {
 #define SLAP_CANCEL_DONE				0x03
 
 	GroupAssertion *o_groups;
+	AclCache *o_aclcache;
 	char o_do_not_cache;	/* don't cache groups from this op */
 	char o_is_auth_check;	/* authorization in progress */
 	char o_dont_replicate;
@@ -2740,6 +2774,9 @@ struct Operation {
 #define get_no_schema_check(op)			((op)->o_no_schema_check)
 	char o_no_subordinate_glue;
 #define get_no_subordinate_glue(op)		((op)->o_no_subordinate_glue)
+	void *o_send_batch;	/* == op while its search responses may be
+				 * coalesced; copies of op don't qualify */
+#define SLAP_SEND_BATCH(op)	((op)->o_send_batch == (void *)(op))
 
 #define SLAP_CONTROL_NONE	0
 #define SLAP_CONTROL_IGNORED	1
@@ -2944,8 +2981,12 @@ struct Connection {
 	ldap_pvt_thread_cond_t	c_write1_cv;	/* only one pdu written at a time */
 
 	BerElement	*c_currentber;	/* ber we're attempting to read */
+	BerElement	*c_wber;	/* coalesced PDUs not yet written */
+	struct timeval	c_wtime;	/* when the first of them was queued */
+	Connection	*c_wnext;	/* next on the write batch timer's list */
 	int			c_writers;		/* number of writers waiting */
 	char		c_writing;		/* someone is writing */
+	char		c_wqueued;		/* on the write batch timer's list */
 
 	char		c_sasl_bind_in_progress;	/* multi-op bind in progress */
 	char		c_writewaiter;	/* true if blocked on write */
@@ -3035,6 +3076,7 @@ struct Listener {
 	int	sl_is_proxied;
 	int	sl_mute;	/* Listener is temporarily disabled due to emfile */
 	int	sl_busy;	/* Listener is busy (accept thread activated) */
+	int	sl_shard;	/* SO_REUSEPORT shard index, -1 if not sharded */
 	ber_socket_t sl_sd;
 	Sockaddr sl_sa;
 #define sl_addr	sl_sa.sa_in_addr
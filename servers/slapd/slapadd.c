@@ -86,224 +86,373 @@ static ldap_pvt_thread_mutex_t add_mutex;
 static ldap_pvt_thread_cond_t add_cond;
 static int add_stop;
 
-/* returns:
- *	1: got a record
- *	0: EOF
- * -1: read failure
+/* Parse one LDIF record into an entry and check it.
+ * returns:
+ *	1: got an entry
  * -2: parse failure
  */
 static int
-getrec0(Erec *erec)
+parserec( Operation *op, char *rec, unsigned long lineno, Entry **ep )
 {
 	const char *text;
-	int ldifrc;
 	char textbuf[SLAP_TEXT_BUFLEN] = { '\0' };
 	size_t textlen = sizeof textbuf;
-	struct berval csn;
-	Operation *op = &opbuf.ob_op;
-	op->o_hdr = &opbuf.ob_hdr;
+	BackendDB *bd;
+	Entry *e;
+	int prev_DN_strict;
 
-again:
-	erec->lineno = erec->nextline+1;
-	/* nextline is the line number of the end of the current entry */
-	ldifrc = ldif_read_record( ldiffp, &erec->nextline, &buf, &lmax );
-	if (ldifrc < 1)
-		return ldifrc < 0 ? -1 : 0;
+	if ( !dbnum ) {
+		prev_DN_strict = slap_DN_strict;
+		slap_DN_strict = 0;
+	}
+	e = str2entry2( rec, checkvals );
+	if ( !dbnum ) {
+		slap_DN_strict = prev_DN_strict;
+	}
+
+	if( e == NULL ) {
+		fprintf( stderr, "%s: could not parse entry (line=%lu)\n",
+			progname, lineno );
+		return -2;
+	}
+
+	/* make sure the DN is not empty */
+	if( BER_BVISEMPTY( &e->e_nname ) &&
+		!BER_BVISEMPTY( be->be_nsuffix ))
 	{
-		BackendDB *bd;
-		Entry *e;
-		int prev_DN_strict;
+		fprintf( stderr, "%s: line %lu: "
+			"cannot add entry with empty dn=\"%s\"",
+			progname, lineno, e->e_dn );
+		bd = select_backend( &e->e_nname, nosubordinates );
+		if ( bd ) {
+			BackendDB *bdtmp;
+			int dbidx = 0;
+			LDAP_STAILQ_FOREACH( bdtmp, &backendDB, be_next ) {
+				if ( bdtmp == bd ) break;
+				dbidx++;
+			}
 
-		if ( erec->lineno < jumpline )
-			goto again;
+			assert( bdtmp != NULL );
+			
+			fprintf( stderr, "; did you mean to use database #%d (%s)?",
+				dbidx,
+				bd->be_suffix[0].bv_val );
 
-		if ( !dbnum ) {
-			prev_DN_strict = slap_DN_strict;
-			slap_DN_strict = 0;
 		}
-		e = str2entry2( buf, checkvals );
-		if ( !dbnum ) {
-			slap_DN_strict = prev_DN_strict;
+		fprintf( stderr, "\n" );
+		entry_free( e );
+		return -2;
+	}
+
+	/* check backend */
+	bd = select_backend( &e->e_nname, nosubordinates );
+	if ( bd != be ) {
+		fprintf( stderr, "%s: line %lu: "
+			"database #%d (%s) not configured to hold \"%s\"",
+			progname, lineno,
+			dbnum,
+			be->be_suffix[0].bv_val,
+			e->e_dn );
+		if ( bd ) {
+			BackendDB *bdtmp;
+			int dbidx = 0;
+			LDAP_STAILQ_FOREACH( bdtmp, &backendDB, be_next ) {
+				if ( bdtmp == bd ) break;
+				dbidx++;
+			}
+
+			assert( bdtmp != NULL );
+			
+			fprintf( stderr, "; did you mean to use database #%d (%s)?",
+				dbidx,
+				bd->be_suffix[0].bv_val );
+
+		} else {
+			fprintf( stderr, "; no database configured for that naming context" );
 		}
+		fprintf( stderr, "\n" );
+		entry_free( e );
+		return -2;
+	}
 
-		if ( enable_meter )
-			lutil_meter_update( &meter,
-					 ftello( ldiffp->fp ),
-					 0);
+	if ( slap_tool_entry_check( progname, op, e, lineno, &text, textbuf, textlen ) !=
+		LDAP_SUCCESS ) {
+		entry_free( e );
+		return -2;
+	}
 
-		if( e == NULL ) {
-			fprintf( stderr, "%s: could not parse entry (line=%lu)\n",
-				progname, erec->lineno );
-			return -2;
+	*ep = e;
+	return 1;
+}
+
+/* Add the operational attributes missing from an entry. Entries
+ * must come through here in input order.
+ */
+static void
+stamprec( Entry *e )
+{
+	struct berval csn;
+
+	if ( SLAP_LASTMOD(be) ) {
+		time_t now = slap_get_time();
+		char uuidbuf[ LDAP_LUTIL_UUIDSTR_BUFSIZE ];
+		struct berval vals[ 2 ];
+
+		struct berval name, timestamp;
+
+		struct berval nvals[ 2 ];
+		struct berval nname;
+		char timebuf[ LDAP_LUTIL_GENTIME_BUFSIZE ];
+
+		enum {
+			GOT_NONE = 0x0,
+			GOT_CSN = 0x1,
+			GOT_UUID = 0x2,
+			GOT_ALL = (GOT_CSN|GOT_UUID)
+		} got = GOT_ALL;
+
+		vals[1].bv_len = 0;
+		vals[1].bv_val = NULL;
+
+		nvals[1].bv_len = 0;
+		nvals[1].bv_val = NULL;
+
+		csn.bv_len = ldap_pvt_csnstr( csnbuf, sizeof( csnbuf ), csnsid, 0 );
+		csn.bv_val = csnbuf;
+
+		timestamp.bv_val = timebuf;
+		timestamp.bv_len = sizeof(timebuf);
+
+		slap_timestamp( &now, &timestamp );
+
+		if ( BER_BVISEMPTY( &be->be_rootndn ) ) {
+			BER_BVSTR( &name, SLAPD_ANONYMOUS );
+			nname = name;
+		} else {
+			name = be->be_rootdn;
+			nname = be->be_rootndn;
 		}
 
-		/* make sure the DN is not empty */
-		if( BER_BVISEMPTY( &e->e_nname ) &&
-			!BER_BVISEMPTY( be->be_nsuffix ))
+		if( attr_find( e->e_attrs, slap_schema.si_ad_entryUUID )
+			== NULL )
 		{
-			fprintf( stderr, "%s: line %lu: "
-				"cannot add entry with empty dn=\"%s\"",
-				progname, erec->lineno, e->e_dn );
-			bd = select_backend( &e->e_nname, nosubordinates );
-			if ( bd ) {
-				BackendDB *bdtmp;
-				int dbidx = 0;
-				LDAP_STAILQ_FOREACH( bdtmp, &backendDB, be_next ) {
-					if ( bdtmp == bd ) break;
-					dbidx++;
-				}
-
-				assert( bdtmp != NULL );
-				
-				fprintf( stderr, "; did you mean to use database #%d (%s)?",
-					dbidx,
-					bd->be_suffix[0].bv_val );
+			got &= ~GOT_UUID;
+			vals[0].bv_len = lutil_uuidstr( uuidbuf, sizeof( uuidbuf ) );
+			vals[0].bv_val = uuidbuf;
+			attr_merge_normalize_one( e, slap_schema.si_ad_entryUUID, vals, NULL );
+		}
 
-			}
-			fprintf( stderr, "\n" );
-			entry_free( e );
-			return -2;
+		if( attr_find( e->e_attrs, slap_schema.si_ad_creatorsName )
+			== NULL )
+		{
+			vals[0] = name;
+			nvals[0] = nname;
+			attr_merge( e, slap_schema.si_ad_creatorsName, vals, nvals );
 		}
 
-		/* check backend */
-		bd = select_backend( &e->e_nname, nosubordinates );
-		if ( bd != be ) {
-			fprintf( stderr, "%s: line %lu: "
-				"database #%d (%s) not configured to hold \"%s\"",
-				progname, erec->lineno,
-				dbnum,
-				be->be_suffix[0].bv_val,
-				e->e_dn );
-			if ( bd ) {
-				BackendDB *bdtmp;
-				int dbidx = 0;
-				LDAP_STAILQ_FOREACH( bdtmp, &backendDB, be_next ) {
-					if ( bdtmp == bd ) break;
-					dbidx++;
-				}
+		if( attr_find( e->e_attrs, slap_schema.si_ad_createTimestamp )
+			== NULL )
+		{
+			vals[0] = timestamp;
+			attr_merge( e, slap_schema.si_ad_createTimestamp, vals, NULL );
+		}
 
-				assert( bdtmp != NULL );
-				
-				fprintf( stderr, "; did you mean to use database #%d (%s)?",
-					dbidx,
-					bd->be_suffix[0].bv_val );
+		if( attr_find( e->e_attrs, slap_schema.si_ad_entryCSN )
+			== NULL )
+		{
+			got &= ~GOT_CSN;
+			vals[0] = csn;
+			attr_merge( e, slap_schema.si_ad_entryCSN, vals, NULL );
+		}
 
-			} else {
-				fprintf( stderr, "; no database configured for that naming context" );
-			}
-			fprintf( stderr, "\n" );
-			entry_free( e );
-			return -2;
+		if( attr_find( e->e_attrs, slap_schema.si_ad_modifiersName )
+			== NULL )
+		{
+			vals[0] = name;
+			nvals[0] = nname;
+			attr_merge( e, slap_schema.si_ad_modifiersName, vals, nvals );
 		}
 
-		if ( slap_tool_entry_check( progname, op, e, erec->lineno, &text, textbuf, textlen ) !=
-			LDAP_SUCCESS ) {
-			entry_free( e );
-			return -2;
+		if( attr_find( e->e_attrs, slap_schema.si_ad_modifyTimestamp )
+			== NULL )
+		{
+			vals[0] = timestamp;
+			attr_merge( e, slap_schema.si_ad_modifyTimestamp, vals, NULL );
 		}
 
-		if ( SLAP_LASTMOD(be) ) {
-			time_t now = slap_get_time();
-			char uuidbuf[ LDAP_LUTIL_UUIDSTR_BUFSIZE ];
-			struct berval vals[ 2 ];
+		if ( SLAP_SINGLE_SHADOW(be) && got != GOT_ALL ) {
+			Debug(LDAP_DEBUG_ANY,
+			      "%s: warning, missing attrs %s%s%s from entry dn=\"%s\"\n",
+			      progname,
+			      (!(got & GOT_UUID) ? slap_schema.si_ad_entryUUID->ad_cname.bv_val : ""),
+			      (!(got & GOT_CSN) ? "," : ""),
+			      (!(got & GOT_CSN) ? slap_schema.si_ad_entryCSN->ad_cname.bv_val : ""),
+			      e->e_name.bv_val );
+		}
 
-			struct berval name, timestamp;
+		sid = slap_tool_update_ctxcsn_check( progname, e );
+	}
+}
 
-			struct berval nvals[ 2 ];
-			struct berval nname;
-			char timebuf[ LDAP_LUTIL_GENTIME_BUFSIZE ];
+/* returns:
+ *	1: got a record
+ *	0: EOF
+ * -1: read failure
+ * -2: parse failure
+ */
+static int
+getrec0(Erec *erec)
+{
+	int ldifrc;
+	Operation *op = &opbuf.ob_op;
+	op->o_hdr = &opbuf.ob_hdr;
 
-			enum {
-				GOT_NONE = 0x0,
-				GOT_CSN = 0x1,
-				GOT_UUID = 0x2,
-				GOT_ALL = (GOT_CSN|GOT_UUID)
-			} got = GOT_ALL;
+again:
+	erec->lineno = erec->nextline+1;
+	/* nextline is the line number of the end of the current entry */
+	ldifrc = ldif_read_record( ldiffp, &erec->nextline, &buf, &lmax );
+	if (ldifrc < 1)
+		return ldifrc < 0 ? -1 : 0;
 
-			vals[1].bv_len = 0;
-			vals[1].bv_val = NULL;
+	if ( erec->lineno < jumpline )
+		goto again;
 
-			nvals[1].bv_len = 0;
-			nvals[1].bv_val = NULL;
+	if ( enable_meter )
+		lutil_meter_update( &meter,
+				 ftello( ldiffp->fp ),
+				 0);
 
-			csn.bv_len = ldap_pvt_csnstr( csnbuf, sizeof( csnbuf ), csnsid, 0 );
-			csn.bv_val = csnbuf;
+	if ( parserec( op, buf, erec->lineno, &erec->e ) < 1 )
+		return -2;
 
-			timestamp.bv_val = timebuf;
-			timestamp.bv_len = sizeof(timebuf);
+	stamprec( erec->e );
+	return 1;
+}
 
-			slap_timestamp( &now, &timestamp );
+/*
+ * With ldif-threads > 1 the main thread still reads the LDIF and
+ * writes to the database, but hands each record to a pool of parser
+ * threads that build the entry, normalize its values and check it
+ * against the schema. Records pass through a ring of slots in input
+ * order; the main thread takes the parsed entries from the tail of
+ * the ring and adds their operational attributes there, so the
+ * database ends up the same as with a single threaded load.
+ */
+#define	ADD_PER_THREAD	64	/* ring slots per parser thread */
+
+typedef struct add_slot {
+	char		*as_buf;
+	int		as_lmax;
+	Entry		*as_e;
+	unsigned long	as_lineno;
+	unsigned long	as_nextline;
+	int		as_rc;		/* as for getrec0() */
+	int		as_done;
+} add_slot;
+
+static ldap_pvt_thread_cond_t add_work;	/* parsers wait for new slots */
+static ldap_pvt_thread_cond_t add_done;	/* main waits for parsed slots */
+
+static add_slot *add_ring;
+static unsigned long add_nslots;
+static unsigned long add_head;	/* next slot to fill */
+static unsigned long add_next;	/* next slot for a parser */
+static unsigned long add_tail;	/* next slot to load */
+static unsigned long add_line;	/* last line read */
+static int add_eof;
 
-			if ( BER_BVISEMPTY( &be->be_rootndn ) ) {
-				BER_BVSTR( &name, SLAPD_ANONYMOUS );
-				nname = name;
-			} else {
-				name = be->be_rootdn;
-				nname = be->be_rootndn;
-			}
+static void *
+parserec_thr( void *ctx )
+{
+	OperationBuffer opb;
+	Operation *op = &opb.ob_op;
+	add_slot *as;
 
-			if( attr_find( e->e_attrs, slap_schema.si_ad_entryUUID )
-				== NULL )
-			{
-				got &= ~GOT_UUID;
-				vals[0].bv_len = lutil_uuidstr( uuidbuf, sizeof( uuidbuf ) );
-				vals[0].bv_val = uuidbuf;
-				attr_merge_normalize_one( e, slap_schema.si_ad_entryUUID, vals, NULL );
-			}
+	memset( &opb, 0, sizeof(opb) );
+	op->o_hdr = &opb.ob_hdr;
 
-			if( attr_find( e->e_attrs, slap_schema.si_ad_creatorsName )
-				== NULL )
-			{
-				vals[0] = name;
-				nvals[0] = nname;
-				attr_merge( e, slap_schema.si_ad_creatorsName, vals, nvals );
-			}
+	ldap_pvt_thread_mutex_lock( &add_mutex );
+	for (;;) {
+		while ( add_next == add_head && !add_stop )
+			ldap_pvt_thread_cond_wait( &add_work, &add_mutex );
+		if ( add_stop )
+			break;
+		as = &add_ring[ add_next++ % add_nslots ];
+		/* EOF and read failures need no parsing */
+		if ( as->as_done )
+			continue;
+		ldap_pvt_thread_mutex_unlock( &add_mutex );
 
-			if( attr_find( e->e_attrs, slap_schema.si_ad_createTimestamp )
-				== NULL )
-			{
-				vals[0] = timestamp;
-				attr_merge( e, slap_schema.si_ad_createTimestamp, vals, NULL );
-			}
+		as->as_rc = parserec( op, as->as_buf, as->as_lineno, &as->as_e );
 
-			if( attr_find( e->e_attrs, slap_schema.si_ad_entryCSN )
-				== NULL )
-			{
-				got &= ~GOT_CSN;
-				vals[0] = csn;
-				attr_merge( e, slap_schema.si_ad_entryCSN, vals, NULL );
-			}
+		ldap_pvt_thread_mutex_lock( &add_mutex );
+		as->as_done = 1;
+		ldap_pvt_thread_cond_signal( &add_done );
+	}
+	ldap_pvt_thread_mutex_unlock( &add_mutex );
 
-			if( attr_find( e->e_attrs, slap_schema.si_ad_modifiersName )
-				== NULL )
-			{
-				vals[0] = name;
-				nvals[0] = nname;
-				attr_merge( e, slap_schema.si_ad_modifiersName, vals, nvals );
-			}
+	return NULL;
+}
 
-			if( attr_find( e->e_attrs, slap_schema.si_ad_modifyTimestamp )
-				== NULL )
-			{
-				vals[0] = timestamp;
-				attr_merge( e, slap_schema.si_ad_modifyTimestamp, vals, NULL );
-			}
+/* Read records into the free slots of the ring */
+static void
+fillrec( void )
+{
+	add_slot *as;
+	int ldifrc;
 
-			if ( SLAP_SINGLE_SHADOW(be) && got != GOT_ALL ) {
-				Debug(LDAP_DEBUG_ANY,
-				      "%s: warning, missing attrs %s%s%s from entry dn=\"%s\"\n",
-				      progname,
-				      (!(got & GOT_UUID) ? slap_schema.si_ad_entryUUID->ad_cname.bv_val : ""),
-				      (!(got & GOT_CSN) ? "," : ""),
-				      (!(got & GOT_CSN) ? slap_schema.si_ad_entryCSN->ad_cname.bv_val : ""),
-				      e->e_name.bv_val );
-			}
+	while ( !add_eof && add_head - add_tail < add_nslots ) {
+		as = &add_ring[ add_head % add_nslots ];
+		as->as_e = NULL;
+		as->as_done = 0;
+		do {
+			as->as_lineno = add_line+1;
+			ldifrc = ldif_read_record( ldiffp, &add_line,
+				&as->as_buf, &as->as_lmax );
+		} while ( ldifrc > 0 && as->as_lineno < jumpline );
+		as->as_nextline = add_line;
 
-			sid = slap_tool_update_ctxcsn_check( progname, e );
+		if ( ldifrc < 1 ) {
+			as->as_rc = ldifrc < 0 ? -1 : 0;
+			as->as_done = 1;
+			add_eof = 1;
 		}
-		erec->e = e;
+
+		if ( enable_meter )
+			lutil_meter_update( &meter,
+					 ftello( ldiffp->fp ),
+					 0);
+
+		ldap_pvt_thread_mutex_lock( &add_mutex );
+		add_head++;
+		ldap_pvt_thread_cond_signal( &add_work );
+		ldap_pvt_thread_mutex_unlock( &add_mutex );
 	}
-	return 1;
+}
+
+/* Take the next record, in input order, from the ring */
+static int
+getrec_ring( Erec *erec )
+{
+	add_slot *as;
+
+	fillrec();
+
+	as = &add_ring[ add_tail % add_nslots ];
+	ldap_pvt_thread_mutex_lock( &add_mutex );
+	while ( !as->as_done )
+		ldap_pvt_thread_cond_wait( &add_done, &add_mutex );
+	ldap_pvt_thread_mutex_unlock( &add_mutex );
+	add_tail++;
+
+	erec->lineno = as->as_lineno;
+	erec->nextline = as->as_nextline;
+	if ( as->as_rc == 1 ) {
+		erec->e = as->as_e;
+		as->as_e = NULL;
+		stamprec( erec->e );
+	}
+	return as->as_rc;
 }
 
 static void *
@@ -329,6 +478,8 @@ static int
 getrec(Erec *erec)
 {
 	int rc;
+	if ( add_ring )
+		return getrec_ring(erec);
 	if ( !ldif_threaded )
 		return getrec0(erec);
 
@@ -352,8 +503,9 @@ slapadd( int argc, char **argv )
 	size_t textlen = sizeof textbuf;
 	Erec erec;
 	struct berval bvtext;
-	ldap_pvt_thread_t thr;
+	ldap_pvt_thread_t thr, *threads = NULL;
 	ID id;
+	int i;
 	Entry *prev = NULL;
 
 	int ldifrc;
@@ -424,7 +576,26 @@ slapadd( int argc, char **argv )
 		enable_meter = 0;
 	}
 
-	if ( slap_tool_thread_max > 1 ) {
+	/* cn=config entries are parsed with relaxed DN checks, which
+	 * the parser threads can't switch on their own
+	 */
+	if ( ldif_threads > 1 && dbnum ) {
+		add_nslots = ldif_threads * ADD_PER_THREAD;
+		add_ring = ch_calloc( add_nslots, sizeof( add_slot ) );
+		ldap_pvt_thread_mutex_init( &add_mutex );
+		ldap_pvt_thread_cond_init( &add_work );
+		ldap_pvt_thread_cond_init( &add_done );
+		threads = ch_calloc( ldif_threads, sizeof( ldap_pvt_thread_t ) );
+		for ( i = 0; i < ldif_threads; i++ ) {
+			if ( ldap_pvt_thread_create( &threads[i], 0,
+				parserec_thr, NULL ) ) {
+				fprintf( stderr, "%s: could not start parser threads.\n",
+					progname );
+				exit( EXIT_FAILURE );
+			}
+		}
+
+	} else if ( slap_tool_thread_max > 1 ) {
 		ldap_pvt_thread_mutex_init( &add_mutex );
 		ldap_pvt_thread_cond_init( &add_cond );
 		ldap_pvt_thread_create( &thr, 0, getrec_thr, NULL );
@@ -484,6 +655,22 @@ slapadd( int argc, char **argv )
 		ldap_pvt_thread_mutex_unlock( &add_mutex );
 		ldap_pvt_thread_join( thr, NULL );
 	}
+	if ( add_ring ) {
+		ldap_pvt_thread_mutex_lock( &add_mutex );
+		add_stop = 1;
+		ldap_pvt_thread_cond_broadcast( &add_work );
+		ldap_pvt_thread_mutex_unlock( &add_mutex );
+		for ( i = 0; i < ldif_threads; i++ )
+			ldap_pvt_thread_join( threads[i], NULL );
+		ch_free( threads );
+		for ( i = 0; i < add_nslots; i++ ) {
+			if ( add_ring[i].as_e )
+				entry_free( add_ring[i].as_e );
+			ch_free( add_ring[i].as_buf );
+		}
+		ch_free( add_ring );
+		add_ring = NULL;
+	}
 	if ( erec.e ) entry_free( erec.e );
 
 	if ( ldifrc < 0 )
@@ -40,6 +40,202 @@ slapcat_sig( int sig )
 	gotsig=1;
 }
 
+/*
+ * With ldif-threads > 1 the main thread still walks the database through
+ * the backend tool API, which is single threaded, but hands each entry to
+ * a pool of encoder threads that apply the search constraints and build
+ * its LDIF. Entries pass through a ring of slots in ID order; the main
+ * thread writes the finished slots from the tail of the ring, so the
+ * output is identical to the single threaded one. With ldif-shards each
+ * encoder thread writes its entries to its own file instead, in whatever
+ * order they complete.
+ */
+#define	CAT_PER_THREAD	64	/* ring slots per encoder thread */
+
+enum {
+	CAT_OK = 0,
+	CAT_NODATA,		/* be_entry_get() failed */
+	CAT_SKIP,		/* outside base/scope/filter */
+	CAT_BAD,		/* LDIF encoding failed */
+	CAT_EWRITE		/* shard write failed */
+};
+
+typedef struct cat_slot {
+	ID		cs_id;
+	Entry		*cs_e;
+	struct berval	cs_buf;
+	int		cs_len;
+	int		cs_rc;
+	int		cs_done;
+} cat_slot;
+
+typedef struct cat_thread {
+	ldap_pvt_thread_t	ct_thr;
+	int		ct_num;
+} cat_thread;
+
+static ldap_pvt_thread_mutex_t cat_mutex;
+static ldap_pvt_thread_cond_t cat_work;	/* workers wait for new slots */
+static ldap_pvt_thread_cond_t cat_done;	/* main waits for finished slots */
+
+static cat_slot *cat_ring;
+static unsigned long cat_nslots;
+static unsigned long cat_head;	/* next slot to fill */
+static unsigned long cat_next;	/* next slot for an encoder */
+static unsigned long cat_tail;	/* next slot to write */
+static int cat_stop;
+static int cat_doBSF;
+static int cat_writing = 1;
+static int cat_rc = EXIT_SUCCESS;
+static const char *cat_progname;
+
+static void *
+slapcat_thr( void *ctx )
+{
+	cat_thread *ct = ctx;
+	Operation op = {0};
+	cat_slot *cs;
+	Entry *e;
+	char *data;
+
+	op.o_bd = be;
+	ldap_pvt_thread_mutex_lock( &cat_mutex );
+	for (;;) {
+		while ( cat_next == cat_head && !cat_stop )
+			ldap_pvt_thread_cond_wait( &cat_work, &cat_mutex );
+		if ( cat_next == cat_head )
+			break;
+		cs = &cat_ring[ cat_next++ % cat_nslots ];
+		ldap_pvt_thread_mutex_unlock( &cat_mutex );
+
+		e = cs->cs_e;
+		cs->cs_e = NULL;
+		if ( e == NULL ) {
+			cs->cs_rc = CAT_NODATA;
+			goto done;
+		}
+
+		cs->cs_rc = CAT_OK;
+		if ( cat_doBSF ) {
+			if ( sub_ndn.bv_len && !dnIsSuffixScope( &e->e_nname, &sub_ndn, scope ) ) {
+				cs->cs_rc = CAT_SKIP;
+
+			} else if ( filter != NULL &&
+				test_filter( NULL, e, filter ) != LDAP_COMPARE_TRUE ) {
+				cs->cs_rc = CAT_SKIP;
+			}
+		}
+
+		if ( cs->cs_rc == CAT_OK ) {
+			data = entry2str_wrap_r( e, &cs->cs_buf, &cs->cs_len, ldif_wrap );
+			if ( data == NULL ) {
+				cs->cs_rc = CAT_BAD;
+
+			} else if ( ldifshards &&
+				( fputs( data, ldifshards[ct->ct_num]->fp ) == EOF ||
+				fputs( "\n", ldifshards[ct->ct_num]->fp ) == EOF ) ) {
+				cs->cs_rc = CAT_EWRITE;
+			}
+		}
+		be_entry_release_r( &op, e );
+
+done:
+		ldap_pvt_thread_mutex_lock( &cat_mutex );
+		cs->cs_done = 1;
+		ldap_pvt_thread_cond_signal( &cat_done );
+	}
+	ldap_pvt_thread_mutex_unlock( &cat_mutex );
+
+	return NULL;
+}
+
+/* Output one finished slot. Once an error has stopped the
+ * output, later slots are only discarded.
+ */
+static void
+slapcat_output( cat_slot *cs )
+{
+	if ( !cat_writing || cs->cs_rc == CAT_SKIP )
+		return;
+
+	switch ( cs->cs_rc ) {
+	case CAT_NODATA:
+		printf("# no data for entry id=%08lx\n\n", (long) cs->cs_id );
+		cat_rc = EXIT_FAILURE;
+		return;
+
+	case CAT_EWRITE:
+		fprintf(stderr, "%s: error writing output.\n",
+			cat_progname);
+		cat_rc = EXIT_FAILURE;
+		cat_writing = 0;
+		return;
+	}
+
+	if ( verbose ) {
+		printf( "# id=%08lx\n", (long) cs->cs_id );
+	}
+
+	if ( cs->cs_rc == CAT_BAD ) {
+		printf("# bad data for entry id=%08lx\n\n", (long) cs->cs_id );
+		cat_rc = EXIT_FAILURE;
+		if ( !continuemode )
+			cat_writing = 0;
+		return;
+	}
+
+	if ( !ldifshards &&
+		( fputs( cs->cs_buf.bv_val, ldiffp->fp ) == EOF ||
+		fputs( "\n", ldiffp->fp ) == EOF ) ) {
+		fprintf(stderr, "%s: error writing output.\n",
+			cat_progname);
+		cat_rc = EXIT_FAILURE;
+		cat_writing = 0;
+	}
+}
+
+/* Write out finished slots from the tail of the ring, waiting
+ * for the encoders until no more than limit slots are in use.
+ */
+static void
+slapcat_flush( unsigned long limit )
+{
+	cat_slot *cs;
+
+	while ( cat_tail != cat_head ) {
+		cs = &cat_ring[ cat_tail % cat_nslots ];
+		ldap_pvt_thread_mutex_lock( &cat_mutex );
+		while ( !cs->cs_done ) {
+			if ( cat_head - cat_tail <= limit ) {
+				ldap_pvt_thread_mutex_unlock( &cat_mutex );
+				return;
+			}
+			ldap_pvt_thread_cond_wait( &cat_done, &cat_mutex );
+		}
+		ldap_pvt_thread_mutex_unlock( &cat_mutex );
+		slapcat_output( cs );
+		cat_tail++;
+	}
+}
+
+/* Hand an entry, or its absence, to the encoder threads */
+static void
+slapcat_queue( ID id, Entry *e )
+{
+	cat_slot *cs;
+
+	slapcat_flush( cat_nslots - 1 );
+
+	cs = &cat_ring[ cat_head % cat_nslots ];
+	cs->cs_id = id;
+	cs->cs_e = e;
+	cs->cs_done = 0;
+	ldap_pvt_thread_mutex_lock( &cat_mutex );
+	cat_head++;
+	ldap_pvt_thread_cond_signal( &cat_work );
+	ldap_pvt_thread_mutex_unlock( &cat_mutex );
+}
+
 int
 slapcat( int argc, char **argv )
 {
@@ -49,6 +245,8 @@ slapcat( int argc, char **argv )
 	const char *progname = "slapcat";
 	int requestBSF;
 	int doBSF = 0;
+	cat_thread *threads = NULL;
+	int i;
 
 	slap_tool_init( progname, SLAPCAT, argc, argv );
 
@@ -96,6 +294,26 @@ slapcat( int argc, char **argv )
 		}
 	}
 
+	if ( ldif_threads > 1 || ldifshards ) {
+		cat_progname = progname;
+		cat_doBSF = doBSF;
+		cat_nslots = ldif_threads * CAT_PER_THREAD;
+		cat_ring = ch_calloc( cat_nslots, sizeof( cat_slot ) );
+		ldap_pvt_thread_mutex_init( &cat_mutex );
+		ldap_pvt_thread_cond_init( &cat_work );
+		ldap_pvt_thread_cond_init( &cat_done );
+		threads = ch_calloc( ldif_threads, sizeof( cat_thread ) );
+		for ( i = 0; i < ldif_threads; i++ ) {
+			threads[i].ct_num = i;
+			if ( ldap_pvt_thread_create( &threads[i].ct_thr, 0,
+				slapcat_thr, &threads[i] ) ) {
+				fprintf( stderr, "%s: could not start encoder threads.\n",
+					progname );
+				exit( EXIT_FAILURE );
+			}
+		}
+	}
+
 	for ( ; id != NOID; id = be->be_entry_next( be ) )
 	{
 		char *data;
@@ -105,8 +323,28 @@ slapcat( int argc, char **argv )
 		if ( gotsig )
 			break;
 
+		if ( threads && !cat_writing )
+			break;
+
 		e = be->be_entry_get( be, id );
-		if ( e == NULL ) {
+		if ( e == NULL && threads ) {
+			slapcat_queue( id, NULL );
+			if ( continuemode == 0 ) {
+				break;
+
+			} else if ( continuemode == 1 ) {
+				continue;
+			}
+
+			while ( ++id != NOID ) {
+				e = be->be_entry_get( be, id );
+				if ( e != NULL ) break;
+				slapcat_queue( id, NULL );
+			}
+
+			if ( e == NULL ) break;
+
+		} else if ( e == NULL ) {
 			printf("# no data for entry id=%08lx\n\n", (long) id );
 			rc = EXIT_FAILURE;
 			if ( continuemode == 0 ) {
@@ -127,6 +365,11 @@ slapcat( int argc, char **argv )
 			if ( e == NULL ) break;
 		}
 
+		if ( threads ) {
+			slapcat_queue( id, e );
+			continue;
+		}
+
 		if ( doBSF ) {
 			if ( sub_ndn.bv_len && !dnIsSuffixScope( &e->e_nname, &sub_ndn, scope ) )
 			{
@@ -167,6 +410,27 @@ slapcat( int argc, char **argv )
 		}
 	}
 
+	if ( threads ) {
+		slapcat_flush( 0 );
+		ldap_pvt_thread_mutex_lock( &cat_mutex );
+		cat_stop = 1;
+		ldap_pvt_thread_cond_broadcast( &cat_work );
+		ldap_pvt_thread_mutex_unlock( &cat_mutex );
+		for ( i = 0; i < ldif_threads; i++ ) {
+			ldap_pvt_thread_join( threads[i].ct_thr, NULL );
+		}
+		for ( cat_head = 0; cat_head < cat_nslots; cat_head++ ) {
+			ch_free( cat_ring[cat_head].cs_buf.bv_val );
+		}
+		ch_free( cat_ring );
+		ch_free( threads );
+		ldap_pvt_thread_cond_destroy( &cat_done );
+		ldap_pvt_thread_cond_destroy( &cat_work );
+		ldap_pvt_thread_mutex_destroy( &cat_mutex );
+		if ( cat_rc != EXIT_SUCCESS )
+			rc = cat_rc;
+	}
+
 	be->be_entry_close( be );
 
 	if ( slap_tool_destroy())
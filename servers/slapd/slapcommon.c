@@ -255,6 +255,41 @@ parse_slapopt( int tool, int *mode )
 			break;
 		}
 
+	} else if ( ( strncasecmp( optarg, "ldif_threads", len ) == 0 ) ||
+			( strncasecmp( optarg, "ldif-threads", len ) == 0 ) ) {
+		switch ( tool ) {
+		case SLAPADD:
+		case SLAPCAT: {
+			unsigned int u;
+			if ( lutil_atou( &u, p ) || u == 0 ) {
+				Debug( LDAP_DEBUG_ANY, "unable to parse ldif_threads=\"%s\".\n", p );
+				return -1;
+			}
+			ldif_threads = u;
+			} break;
+
+		default:
+			Debug( LDAP_DEBUG_ANY, "ldif-threads meaningless for tool.\n" );
+			break;
+		}
+
+	} else if ( ( strncasecmp( optarg, "ldif_shards", len ) == 0 ) ||
+			( strncasecmp( optarg, "ldif-shards", len ) == 0 ) ) {
+		switch ( tool ) {
+		case SLAPCAT: {
+			unsigned int u;
+			if ( lutil_atou( &u, p ) || u == 0 ) {
+				Debug( LDAP_DEBUG_ANY, "unable to parse ldif_shards=\"%s\".\n", p );
+				return -1;
+			}
+			ldif_shards = u;
+			} break;
+
+		default:
+			Debug( LDAP_DEBUG_ANY, "ldif-shards meaningless for tool.\n" );
+			break;
+		}
+
 	} else {
 		return -1;
 	}
@@ -312,6 +347,7 @@ slap_tool_init(
 #endif
 
 	ldif_wrap = LDIF_LINE_WIDTH;
+	ldif_threads = 1;
 
 	scope = LDAP_SCOPE_DEFAULT;
 
@@ -536,7 +572,7 @@ slap_tool_init(
 			case SLAPSCHEMA:
 				/* dump subtree */
 				ch_free( subtree );
-				subtree = optarg;
+				subtree = ch_strdup( optarg );
 				break;
 			}
 			break;
@@ -657,7 +693,30 @@ slap_tool_init(
 		break;
 	}
 
-	if ( ldiffile == NULL ) {
+	if ( ldif_shards ) {
+		/* unordered output, one file per encoder thread */
+		char *fname;
+
+		if ( ldiffile == NULL ) {
+			fprintf( stderr, "%s: ldif-shards requires -l ldiffile\n",
+				progname );
+			exit( EXIT_FAILURE );
+		}
+		fname = ch_malloc( strlen( ldiffile ) + STRLENOF( ".4294967295" ) + 1 );
+		ldifshards = ch_calloc( ldif_shards, sizeof( LDIFFP * ) );
+		for ( i = 0; i < ldif_shards; i++ ) {
+			sprintf( fname, "%s.%d", ldiffile, i );
+			if ( ( ldifshards[i] = ldif_open( fname, "w" ) ) == NULL ) {
+				perror( fname );
+				exit( EXIT_FAILURE );
+			}
+		}
+		ch_free( fname );
+		ldif_threads = ldif_shards;
+		dummy.fp = stdout;
+		ldiffp = &dummy;
+
+	} else if ( ldiffile == NULL ) {
 		dummy.fp = writer ? stdout : stdin;
 		ldiffp = &dummy;
 
@@ -945,6 +1004,15 @@ int slap_tool_destroy( void )
 	if ( ldiffp && ldiffp != &dummy ) {
 		ldif_close( ldiffp );
 	}
+	if ( ldifshards ) {
+		int i;
+
+		for ( i = 0; i < ldif_shards; i++ ) {
+			ldif_close( ldifshards[i] );
+		}
+		ch_free( ldifshards );
+		ldifshards = NULL;
+	}
 	return rc;
 }
 
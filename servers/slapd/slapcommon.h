@@ -52,6 +52,9 @@ typedef struct tool_vars {
 	unsigned tv_dn_mode;
 	unsigned int tv_csnsid;
 	ber_len_t tv_ldif_wrap;
+	int tv_ldif_threads;
+	int tv_ldif_shards;
+	struct LDIFFP	**tv_ldifshards;
 	char tv_maxcsnbuf[ LDAP_PVT_CSNSTR_BUFSIZE * ( SLAP_SYNC_SID_MAX + 1 ) ];
 	struct berval tv_maxcsn[ SLAP_SYNC_SID_MAX + 1 ];
 } tool_vars;
@@ -89,6 +92,9 @@ extern tool_vars tool_globals;
 #define dn_mode tool_globals.tv_dn_mode
 #define csnsid tool_globals.tv_csnsid
 #define ldif_wrap tool_globals.tv_ldif_wrap
+#define ldif_threads tool_globals.tv_ldif_threads
+#define ldif_shards tool_globals.tv_ldif_shards
+#define ldifshards tool_globals.tv_ldifshards
 #define maxcsn tool_globals.tv_maxcsn
 #define maxcsnbuf tool_globals.tv_maxcsnbuf
 
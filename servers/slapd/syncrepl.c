@@ -160,6 +160,9 @@ typedef struct syncinfo_s {
 	int			si_strict_refresh;	/* stop listening during fallback refresh */
 	int			si_too_old;
 	int			si_is_configdb;
+	int			si_bulkrefresh;	/* refresh entries per backend txn */
+	int			si_bulk_ok;	/* bulkrefresh usable on this session */
+	int			si_compress;	/* ask provider to compress the stream */
 	ber_int_t	si_msgid;
 	Avlnode			*si_presentlist;
 	LDAP			*si_ld;
@@ -182,6 +185,12 @@ typedef struct syncinfo_s {
 	struct berval	si_lastCookieSent;
 	struct berval	si_monitor_ndn;
 	char	si_connaddrbuf[LDAP_IPADDRLEN];
+	ber_len_t	si_zraw;	/* decompressed bytes on this connection */
+	ber_len_t	si_zwire;	/* compressed bytes on this connection */
+
+	/* bulk refresh txn, only used on the syncrepl thread */
+	OpExtra		*si_bulk_txn;
+	int			si_bulk_num;	/* entries written in it */
 
 	ldap_pvt_thread_mutex_t	si_monitor_mutex;
 	ldap_pvt_thread_mutex_t	si_mutex;
@@ -205,6 +214,9 @@ static int syncrepl_entry(
 static int syncrepl_updateCookie(
 					syncinfo_t *, Operation *,
 					struct sync_cookie *, int save );
+static int syncrepl_bulk_begin( syncinfo_t *, Operation * );
+static int syncrepl_bulk_end( syncinfo_t *, Operation *, int commit );
+static int syncrepl_bulk_usable( syncinfo_t * );
 static struct berval * slap_uuidstr_from_normalized(
 					struct berval *, struct berval *, void * );
 static int syncrepl_add_glue_ancestors(
@@ -569,8 +581,8 @@ ldap_sync_search(
 {
 	BerElementBuffer berbuf;
 	BerElement *ber = (BerElement *)&berbuf;
-	LDAPControl c[3], *ctrls[4];
-	int rc;
+	LDAPControl c[4], *ctrls[5];
+	int rc, nc;
 	int rhint;
 	char *base;
 	char **attrs, *lattrs[9];
@@ -751,16 +763,36 @@ ldap_sync_search(
 		BER_BVZERO( &c[1].ldctl_value );
 		c[1].ldctl_iscritical = 1;
 		ctrls[1] = &c[1];
+		nc = 2;
 
 		if ( !BER_BVISNULL( &si->si_bindconf.sb_authzId ) ) {
-			c[2].ldctl_oid = LDAP_CONTROL_PROXY_AUTHZ;
-			c[2].ldctl_value = si->si_bindconf.sb_authzId;
-			c[2].ldctl_iscritical = 1;
-			ctrls[2] = &c[2];
-			ctrls[3] = NULL;
-		} else {
-			ctrls[2] = NULL;
+			c[nc].ldctl_oid = LDAP_CONTROL_PROXY_AUTHZ;
+			c[nc].ldctl_value = si->si_bindconf.sb_authzId;
+			c[nc].ldctl_iscritical = 1;
+			ctrls[nc] = &c[nc];
+			nc++;
 		}
+
+		/* Only ask on a fresh connection. The layer decides from the
+		 * first response whether the provider agreed, and can't be
+		 * asked again once it has decided.
+		 */
+		if ( si->si_compress ) {
+			Sockbuf *sb;
+
+			ldap_get_option( si->si_ld, LDAP_OPT_SOCKBUF, &sb );
+			if ( ldap_pvt_compress_install( sb,
+				LDAP_PVT_COMPRESS_READ ) == LDAP_SUCCESS )
+			{
+				c[nc].ldctl_oid = LDAP_CONTROL_X_COMPRESS;
+				BER_BVZERO( &c[nc].ldctl_value );
+				c[nc].ldctl_iscritical = 0;
+				ctrls[nc] = &c[nc];
+				nc++;
+				si->si_zraw = si->si_zwire = 0;
+			}
+		}
+		ctrls[nc] = NULL;
 	}
 
 	si->si_refreshDone = 0;
@@ -1045,6 +1077,8 @@ do_syncrep1(
 
 	ldap_set_option( si->si_ld, LDAP_OPT_TIMELIMIT, &si->si_tlimit );
 
+	si->si_bulk_ok = si->si_bulkrefresh && syncrepl_bulk_usable( si );
+
 	rc = LDAP_DEREF_NEVER;	/* actually could allow DEREF_FINDING */
 	ldap_set_option( si->si_ld, LDAP_OPT_DEREF, &rc );
 
@@ -1347,7 +1381,7 @@ do_syncrep2(
 	while ( ( rc = ldap_result( si->si_ld, si->si_msgid, LDAP_MSG_ONE,
 		&tout, &msg ) ) > 0 )
 	{
-		int				match, punlock, syncstate;
+		int				match, punlock, syncstate, locked;
 		struct berval	*retdata, syncUUID[2], cookie = BER_BVNULL;
 		char			*retoid;
 		LDAPControl		**rctrls = NULL, *rctrlp = NULL;
@@ -1356,12 +1390,24 @@ do_syncrep2(
 		ber_tag_t		si_tag;
 		Entry			*entry;
 		struct berval	bdn;
+		int				bulk;
 
 		if ( slapd_shutdown ) {
 			rc = SYNC_SHUTDOWN;
 			goto done;
 		}
 		si->si_lastcontact = slap_get_time();
+		if ( si->si_compress ) {
+			Sockbuf *sb;
+
+			ldap_get_option( si->si_ld, LDAP_OPT_SOCKBUF, &sb );
+			ldap_pvt_compress_stats( sb, &si->si_zraw, &si->si_zwire );
+		}
+		if ( si->si_bulk_txn && ldap_msgtype( msg ) != LDAP_RES_SEARCH_ENTRY ) {
+			/* Commit what came before */
+			if (( rc = syncrepl_bulk_end( si, op, 1 )))
+				goto done;
+		}
 		switch( ldap_msgtype( msg ) ) {
 		case LDAP_RES_SEARCH_ENTRY:
 #ifdef LDAP_CONTROL_X_DIRSYNC
@@ -1498,6 +1544,10 @@ do_syncrep2(
 						}
 						si->si_too_old = 0;
 
+						/* commit the entries before it, and drop cs_pmutex */
+						if ( si->si_bulk_txn && ( rc = syncrepl_bulk_end( si, op, 1 )))
+							goto done;
+
 						/* check pending CSNs too */
 						if (( rc = get_pmutex( si )))
 							goto done;
@@ -1532,7 +1582,19 @@ do_syncrep2(
 				}
 			}
 			rc = 0;
-			if ( si->si_syncdata && si->si_logstate == SYNCLOG_LOGGING ) {
+			bulk = 0;
+			if ( si->si_bulk_ok && !si->si_refreshDone && !si->si_is_configdb &&
+				syncstate == LDAP_SYNC_ADD && punlock < 0 &&
+				!syncCookie.ctxcsn &&
+				!( si->si_syncdata && si->si_logstate == SYNCLOG_LOGGING ))
+			{
+				bulk = 1;
+			}
+			if ( !bulk && si->si_bulk_txn && ( syncstate != LDAP_SYNC_PRESENT ||
+				syncCookie.ctxcsn ) && ( rc = syncrepl_bulk_end( si, op, 1 ) ) )
+			{
+				/* failed, rc is set */
+			} else if ( si->si_syncdata && si->si_logstate == SYNCLOG_LOGGING ) {
 				modlist = NULL;
 				if ( ( rc = syncrepl_message_to_op( si, op, msg, punlock < 0 ) ) == LDAP_SUCCESS &&
 					syncCookie.ctxcsn )
@@ -1563,17 +1625,29 @@ logerr:
 			} else if ( ( rc = syncrepl_message_to_entry( si, op, msg,
 				&modlist, &entry, syncstate, syncUUID ) ) == LDAP_SUCCESS )
 			{
-				if ( punlock < 0 ) {
+				/* an open bulk txn already holds cs_pmutex */
+				locked = 0;
+				if ( punlock < 0 && !si->si_bulk_txn ) {
 					if (( rc = get_pmutex( si )))
 						goto done;
+					locked = 1;
 				}
-				if ( ( rc = syncrepl_entry( si, op, entry, &modlist,
+				if ( bulk && !si->si_bulk_txn &&
+					( rc = syncrepl_bulk_begin( si, op )) == LDAP_SUCCESS )
+					locked = 0;
+				if ( rc == LDAP_SUCCESS && ( rc = syncrepl_entry( si, op, entry, &modlist,
 					syncstate, syncUUID, syncCookie.ctxcsn ) ) == LDAP_SUCCESS &&
 					syncCookie.ctxcsn )
 				{
 					rc = syncrepl_updateCookie( si, op, &syncCookie, 0 );
 				}
-				if ( punlock < 0 )
+				if ( bulk && si->si_bulk_txn ) {
+					if ( rc != LDAP_SUCCESS )
+						syncrepl_bulk_end( si, op, 0 );
+					else if ( ++si->si_bulk_num >= si->si_bulkrefresh )
+						rc = syncrepl_bulk_end( si, op, 1 );
+				}
+				if ( locked )
 					ldap_pvt_thread_mutex_unlock( &si->si_cookieState->cs_pmutex );
 			}
 			if ( punlock >= 0 ) {
@@ -1978,6 +2052,8 @@ logerr:
 		ldap_msgfree( msg );
 		msg = NULL;
 		if ( ldap_pvt_thread_pool_pausing( &connection_pool )) {
+			if ( si->si_bulk_txn && ( rc = syncrepl_bulk_end( si, op, 1 )))
+				goto done;
 			slap_sync_cookie_free( &syncCookie, 0 );
 			slap_sync_cookie_free( &syncCookie_req, 0 );
 			return SYNC_PAUSED;
@@ -1991,6 +2067,12 @@ logerr:
 	}
 
 done:
+	if ( si->si_bulk_txn ) {
+		/* Everything in the batch was applied, keep it */
+		int rc2 = syncrepl_bulk_end( si, op, 1 );
+		if ( !rc )
+			rc = rc2;
+	}
 	if ( err != LDAP_SUCCESS ) {
 		Debug( LDAP_DEBUG_ANY,
 			"do_syncrep2: %s (%d) %s\n",
@@ -4699,6 +4781,105 @@ done:
 	return rc;
 }
 
+/* Bulk refresh.
+ *
+ * Refresh entries are written in backend transactions of up to
+ * si_bulkrefresh entries instead of one transaction per entry. The
+ * txn is kept on op->o_extra, so the searches and writes made by
+ * syncrepl_entry() all join it. It is committed before any other
+ * message is handled, so a cookie is only saved once every entry
+ * received before it has been committed. If any
+ * entry fails the whole batch is rolled back and the refresh fails;
+ * it then restarts from the last saved cookie, and entries that were
+ * committed by earlier batches are found unchanged and skipped.
+ *
+ * The txn holds the backend's write lock, so cs_pmutex is taken before
+ * it is started and held until it ends, as for a single entry. Another
+ * consumer sharing the cookie state then can't wait for the write lock
+ * while holding cs_pmutex.
+ *
+ * The writes still go through the overlays of the database, and some
+ * act on them outside of the txn: syncprov sends them to its own
+ * consumers and advances its contextCSN, and accesslog logs them in
+ * another database. None of that could be taken back if the txn is
+ * discarded, so bulk refresh is not used with them.
+ */
+static int
+syncrepl_bulk_usable( syncinfo_t *si )
+{
+	static const char *const unsafe[] = { "syncprov", "accesslog", NULL };
+	int i;
+
+	if ( si->si_wbe != si->si_be || !si->si_wbe->bd_info->bi_op_txn ) {
+		Debug( LDAP_DEBUG_SYNC, "syncrepl_bulk_usable: %s "
+			"bulkrefresh not supported by this database\n",
+			si->si_ridtxt );
+		return 0;
+	}
+	for ( i = 0; unsafe[i]; i++ ) {
+		if ( overlay_is_inst( si->si_be, unsafe[i] )) {
+			Debug( LDAP_DEBUG_SYNC, "syncrepl_bulk_usable: %s "
+				"bulkrefresh not used with the %s overlay\n",
+				si->si_ridtxt, unsafe[i] );
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Called with cs_pmutex held, which the txn keeps until it ends */
+static int
+syncrepl_bulk_begin( syncinfo_t *si, Operation *op )
+{
+	BackendDB *be = op->o_bd;
+	int rc;
+
+	op->o_bd = si->si_wbe;
+	rc = op->o_bd->bd_info->bi_op_txn( op, SLAP_TXN_BEGIN, &si->si_bulk_txn );
+	op->o_bd = be;
+	if ( rc ) {
+		Debug( LDAP_DEBUG_ANY, "syncrepl_bulk_begin: %s "
+			"couldn't start DB transaction (%d)\n", si->si_ridtxt, rc );
+		si->si_bulk_txn = NULL;
+		return LDAP_OTHER;
+	}
+	si->si_bulk_num = 0;
+	return LDAP_SUCCESS;
+}
+
+static int
+syncrepl_bulk_end( syncinfo_t *si, Operation *op, int commit )
+{
+	BackendDB *be = op->o_bd;
+	int rc = LDAP_SUCCESS;
+
+	if ( !si->si_bulk_txn )
+		return rc;
+
+	Debug( LDAP_DEBUG_SYNC, "syncrepl_bulk_end: %s %s %d entries\n",
+		si->si_ridtxt, commit ? "committing" : "discarding",
+		si->si_bulk_num );
+
+	LDAP_SLIST_REMOVE( &op->o_extra, si->si_bulk_txn, OpExtra, oe_next );
+	op->o_bd = si->si_wbe;
+	if ( commit ) {
+		rc = op->o_bd->bd_info->bi_op_txn( op, SLAP_TXN_COMMIT,
+			&si->si_bulk_txn );
+		if ( rc ) {
+			Debug( LDAP_DEBUG_ANY, "syncrepl_bulk_end: %s "
+				"transaction commit failed (%d)\n", si->si_ridtxt, rc );
+			rc = LDAP_OTHER;
+		}
+	} else {
+		op->o_bd->bd_info->bi_op_txn( op, SLAP_TXN_ABORT, &si->si_bulk_txn );
+	}
+	op->o_bd = be;
+	si->si_bulk_txn = NULL;
+	si->si_bulk_num = 0;
+	ldap_pvt_thread_mutex_unlock( &si->si_cookieState->cs_pmutex );
+	return rc;
+}
+
 static struct berval gcbva[] = {
 	BER_BVC("top"),
 	BER_BVC("glue"),
@@ -6242,6 +6423,8 @@ config_suffixm( ConfigArgs *c, syncinfo_t *si )
 #define SUFFIXMSTR		"suffixmassage"
 #define	STRICT_REFRESH	"strictrefresh"
 #define LAZY_COMMIT		"lazycommit"
+#define BULKREFRESHSTR	"bulkrefresh"
+#define COMPRESSSTR		"compress"
 
 /* FIXME: undocumented */
 #define EXATTRSSTR		"exattrs"
@@ -6769,6 +6952,28 @@ parse_syncrepl_line(
 					STRLENOF( LAZY_COMMIT ) ) )
 		{
 			si->si_lazyCommit = 1;
+		} else if ( !strncasecmp( c->argv[ i ], BULKREFRESHSTR "=",
+					STRLENOF( BULKREFRESHSTR "=" ) ) )
+		{
+			val = c->argv[ i ] + STRLENOF( BULKREFRESHSTR "=" );
+			if ( lutil_atoi( &si->si_bulkrefresh, val ) != 0
+				|| si->si_bulkrefresh < 0 )
+			{
+				snprintf( c->cr_msg, sizeof( c->cr_msg ),
+					"invalid bulk refresh value \"%s\".\n",
+					val );
+				Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
+				return 1;
+			}
+		} else if ( !strcasecmp( c->argv[ i ], COMPRESSSTR ) ) {
+#ifdef HAVE_ZLIB
+			si->si_compress = 1;
+#else
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"\"" COMPRESSSTR "\" requires zlib support" );
+			Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
+			return 1;
+#endif
 		} else if ( !bindconf_parse( c->argv[i], &si->si_bindconf ) ) {
 			si->si_got |= GOT_BINDCONF;
 		} else {
@@ -6850,7 +7055,8 @@ static ObjectClass	*oc_olmSyncRepl;
 static AttributeDescription	*ad_olmProviderURIList,
 	*ad_olmConnection, *ad_olmSyncPhase,
 	*ad_olmNextConnect, *ad_olmLastConnect, *ad_olmLastContact,
-	*ad_olmLastCookieRcvd, *ad_olmLastCookieSent;
+	*ad_olmLastCookieRcvd, *ad_olmLastCookieSent,
+	*ad_olmCompressedBytes, *ad_olmUncompressedBytes, *ad_olmCompressionRatio;
 
 static struct {
 	char *name;
@@ -6926,6 +7132,28 @@ static struct {
 		"NO-USER-MODIFICATION "
 		"USAGE dSAOperation )",
 		&ad_olmLastCookieSent },
+	{ "( olmSyncReplAttributes:9 "
+		"NAME ( 'olmSRCompressedBytes' ) "
+		"DESC 'Compressed bytes received on the current connection' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmCompressedBytes },
+	{ "( olmSyncReplAttributes:10 "
+		"NAME ( 'olmSRUncompressedBytes' ) "
+		"DESC 'Bytes they decompressed to' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmUncompressedBytes },
+	{ "( olmSyncReplAttributes:11 "
+		"NAME ( 'olmSRCompressionRatio' ) "
+		"DESC 'Uncompressed to compressed bytes' "
+		"SUP monitoredInfo "
+		"SINGLE-VALUE "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmCompressionRatio },
 	{ NULL }
 };
 
@@ -6945,6 +7173,9 @@ static struct {
 			"$ olmSRLastContact "
 			"$ olmSRLastCookieRcvd "
 			"$ olmSRLastCookieSent "
+			"$ olmSRCompressedBytes "
+			"$ olmSRUncompressedBytes "
+			"$ olmSRCompressionRatio "
 			") )",
 		&oc_olmSyncRepl },
 	{ NULL }
@@ -7122,6 +7353,37 @@ syncrepl_monitor_update(
 		ber_bvreplace( &a->a_vals[0], &si->si_lastCookieSent );
 	ldap_pvt_thread_mutex_unlock( &si->si_monitor_mutex );
 
+	a = a->a_next;
+	if ( !a || a->a_desc != ad_olmCompressedBytes )
+		return SLAP_CB_CONTINUE;
+
+	{
+		ber_len_t raw = si->si_zraw, wire = si->si_zwire;
+		char buf[ 64 ];
+		struct berval bv;
+
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", (unsigned long)wire );
+		ber_bvreplace( &a->a_vals[0], &bv );
+
+		a = a->a_next;
+		if ( a->a_desc != ad_olmUncompressedBytes )
+			return SLAP_CB_CONTINUE;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", (unsigned long)raw );
+		ber_bvreplace( &a->a_vals[0], &bv );
+
+		a = a->a_next;
+		if ( a->a_desc != ad_olmCompressionRatio )
+			return SLAP_CB_CONTINUE;
+		if ( wire ) {
+			bv.bv_len = snprintf( buf, sizeof( buf ), "%.2f",
+				(double)raw / wire );
+		} else {
+			BER_BVSTR( &bv, "0" );
+		}
+		ber_bvreplace( &a->a_vals[0], &bv );
+	}
+
 	return SLAP_CB_CONTINUE;
 }
 
@@ -7199,6 +7461,12 @@ syncrepl_monitor_add(
 		attr_merge_normalize_one( e, ad_olmLastCookieRcvd, &bv, NULL );
 		attr_merge_normalize_one( e, ad_olmLastCookieSent, &bv, NULL );
 	}
+	if ( si->si_compress ) {
+		struct berval bv = BER_BVC("0");
+		attr_merge_one( e, ad_olmCompressedBytes, &bv, NULL );
+		attr_merge_one( e, ad_olmUncompressedBytes, &bv, NULL );
+		attr_merge_normalize_one( e, ad_olmCompressionRatio, &bv, NULL );
+	}
 	{
 		monitor_callback_t *cb = ch_calloc( sizeof( monitor_callback_t ), 1 );
 		cb->mc_update = syncrepl_monitor_update;
@@ -7589,6 +7857,17 @@ syncrepl_unparse( syncinfo_t *si, struct berval *bv )
 		ptr = lutil_strcopy( ptr, " " LAZY_COMMIT );
 	}
 
+	if ( si->si_bulkrefresh ) {
+		len = snprintf( ptr, WHATSLEFT, " " BULKREFRESHSTR "=%d", si->si_bulkrefresh );
+		if ( WHATSLEFT <= len ) return;
+		ptr += len;
+	}
+
+	if ( si->si_compress ) {
+		if ( WHATSLEFT <= STRLENOF( " " COMPRESSSTR ) ) return;
+		ptr = lutil_strcopy( ptr, " " COMPRESSSTR );
+	}
+
 	bc.bv_len = ptr - buf;
 	bc.bv_val = buf;
 	ber_dupbv( bv, &bc );
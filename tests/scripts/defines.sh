@@ -118,6 +118,7 @@ ACLCONF=$DATADIR/slapd-acl.conf
 RCONF=$DATADIR/slapd-referrals.conf
 SRPROVIDERCONF=$DATADIR/slapd-syncrepl-provider.conf
 DSRPROVIDERCONF=$DATADIR/slapd-deltasync-provider.conf
+BULKMPRCONF=$DATADIR/slapd-bulkrefresh-mpr.conf
 DSRCONSUMERCONF=$DATADIR/slapd-deltasync-consumer.conf
 PPOLICYCONF=$DATADIR/slapd-ppolicy.conf
 PROXYCACHECONF=$DATADIR/slapd-proxycache.conf